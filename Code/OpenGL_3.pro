@@ -7,26 +7,92 @@ TEMPLATE = app
 
 CONFIG += c++14
 
+# Release builds compile out trace and debug logging (Log::INFO is 2).
+CONFIG(release, debug|release): DEFINES += LOG_MIN_LEVEL=2
+
 SOURCES += \
     main.cpp \
+    assetcache.cpp \
+    assetpack.cpp \
+    bvh.cpp \
+    ephemeris.cpp \
+    fleet.cpp \
+    framecapture.cpp \
+    framescheduler.cpp \
+    lightclusters.cpp \
+    log.cpp \
     mainwindow.cpp \
     mainview.cpp \
+    memoryreport.cpp \
+    navigation.cpp \
+    nbody.cpp \
     object.cpp \
+    occlusionculler.cpp \
+    orbitbuffer.cpp \
+    picker.cpp \
+    renderview.cpp \
+    replay.cpp \
+    resolutionscaler.cpp \
+    scenefile.cpp \
     solarsystem.cpp \
+    spatialgrid.cpp \
+    starfield.cpp \
+    threadpool.cpp \
+    transformhierarchy.cpp \
     user_input.cpp \
+    virtualtexture.cpp \
+    virtualtexturecache.cpp \
     model.cpp \
+    shadercache.cpp \
+    shadinggovernor.cpp \
+    shadowmap.cpp \
     utility.cpp
 
 HEADERS += \
+    assetcache.h \
+    assetpack.h \
+    bvh.h \
     camera.h \
+    ephemeris.h \
+    fleet.h \
+    framecapture.h \
+    framescheduler.h \
+    lightclusters.h \
+    log.h \
     mainwindow.h \
     mainview.h \
+    memoryreport.h \
     model.h \
+    navigation.h \
+    nbody.h \
     object.h \
-    solarsystem.h
+    occlusionculler.h \
+    orbitbuffer.h \
+    picker.h \
+    renderview.h \
+    replay.h \
+    resolutionscaler.h \
+    scenefile.h \
+    shadercache.h \
+    shadinggovernor.h \
+    shadowmap.h \
+    solarsystem.h \
+    spatialgrid.h \
+    starfield.h \
+    threadpool.h \
+    transformhierarchy.h \
+    virtualtexture.h \
+    virtualtexturecache.h
 
 FORMS += \
     mainwindow.ui
 
-RESOURCES += \
-    resources.qrc
+# With CONFIG+=asset_pack the assets are not compiled in: the linked program
+# packs them into assets.pack next to itself, which it mounts on start.
+asset_pack {
+    QMAKE_POST_LINK += $$shell_quote($$OUT_PWD/$$TARGET) -platform offscreen \
+        --compile-pack $$shell_quote($$PWD/resources.qrc),$$shell_quote($$OUT_PWD/assets.pack)
+} else {
+    RESOURCES += \
+        resources.qrc
+}
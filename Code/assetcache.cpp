@@ -0,0 +1,95 @@
+#include "assetcache.h"
+
+#include <QMutexLocker>
+
+AssetCache *AssetCache::instance() {
+    static AssetCache cache;
+    return &cache;
+}
+
+/**
+ * @brief AssetCache::model
+ *
+ * Parses outside the lock, two threads asking for the same new file at once
+ * may both parse it but share the first result that is still alive.
+ */
+QSharedPointer<Model> AssetCache::model(QString file) {
+    {
+        QMutexLocker lock(&mutex);
+        QSharedPointer<Model> cached = models.value(file).toStrongRef();
+        if (cached) return cached;
+    }
+
+    QSharedPointer<Model> parsed(new Model(file));
+
+    QMutexLocker lock(&mutex);
+    QSharedPointer<Model> cached = models.value(file).toStrongRef();
+    if (cached) return cached;
+    models.insert(file, parsed);
+    return parsed;
+}
+
+int AssetCache::getModelCount() {
+    QMutexLocker lock(&mutex);
+    int alive = 0;
+    for (const QWeakPointer<Model> &m : models) {
+        if (!m.isNull()) alive++;
+    }
+    return alive;
+}
+
+bool AssetCache::findMesh(QString key, Mesh &mesh) {
+    auto it = meshes.constFind(key);
+    if (it == meshes.constEnd()) return false;
+    mesh = it.value();
+    return true;
+}
+
+void AssetCache::addMesh(QString key, Mesh mesh) {
+    meshes.insert(key, mesh);
+}
+
+bool AssetCache::findTexture(QString file, GLuint &texture) {
+    auto it = textures.constFind(file);
+    if (it == textures.constEnd()) return false;
+    texture = it.value().name;
+    return true;
+}
+
+void AssetCache::addTexture(QString file, GLuint texture, qint64 bytes) {
+    Texture t = {texture, bytes};
+    textures.insert(file, t);
+}
+
+void AssetCache::reportMemory(MemoryReport &report) {
+    {
+        QMutexLocker lock(&mutex);
+        for (auto it = models.constBegin(); it != models.constEnd(); ++it) {
+            QSharedPointer<Model> m = it.value().toStrongRef();
+            if (m) report.add(MemoryReport::CPU, "assets", "model " + it.key(), m->getMemoryUsage());
+        }
+    }
+    for (auto it = meshes.constBegin(); it != meshes.constEnd(); ++it) {
+        report.add(MemoryReport::GPU_BUFFER, "assets", "vertices " + it.key(), it.value().vertexBytes);
+        report.add(MemoryReport::GPU_BUFFER, "assets", "indices " + it.key(), it.value().indexBytes);
+    }
+    for (auto it = textures.constBegin(); it != textures.constEnd(); ++it) {
+        report.add(MemoryReport::GPU_TEXTURE, "assets", it.key(), it.value().bytes);
+    }
+}
+
+void AssetCache::releaseGpu() {
+    if (meshes.isEmpty() && textures.isEmpty()) return;
+    initializeOpenGLFunctions();
+
+    for (Mesh &mesh : meshes) {
+        glDeleteBuffers(1, &mesh.vbo);
+        glDeleteBuffers(1, &mesh.vio);
+        glDeleteVertexArrays(1, &mesh.vao);
+    }
+    for (Texture &texture : textures) {
+        glDeleteTextures(1, &texture.name);
+    }
+    meshes.clear();
+    textures.clear();
+}
@@ -0,0 +1,71 @@
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QSharedPointer>
+#include <QString>
+#include <QWeakPointer>
+
+#include "memoryreport.h"
+#include "model.h"
+
+/**
+ * @brief The AssetCache class
+ *
+ * Models, meshes and textures shared by all objects that use the same file.
+ * Nothing is read when an object is created: the model is parsed the first
+ * time something asks for it, and mesh and texture are uploaded by the first
+ * object that is loaded with them. A scene with thousands of bodies on the
+ * same sphere therefore parses and uploads that sphere once.
+ *
+ * The cache only holds models weakly: once the meshes are uploaded and no
+ * object keeps its model (for picking or physics), the CPU copy is freed.
+ * Asking for it again parses the file again.
+ *
+ * Models can be requested from any thread. The GPU entries are only touched
+ * with the context current and are owned by the cache.
+ */
+class AssetCache : protected QOpenGLFunctions_3_3_Core {
+public:
+    struct Mesh {
+        GLuint vao = 0, vbo = 0, vio = 0;
+        GLsizei size = 0;
+        qint64 vertexBytes = 0, indexBytes = 0;
+    };
+
+    static AssetCache *instance();
+
+    QSharedPointer<Model> model(QString file);
+
+    bool findMesh(QString key, Mesh &mesh);
+    void addMesh(QString key, Mesh mesh);
+    bool findTexture(QString file, GLuint &texture);
+    void addTexture(QString file, GLuint texture, qint64 bytes);
+
+    // Deletes all meshes and textures, requires the context they were made in.
+    void releaseGpu();
+
+    // Models that are still alive.
+    int getModelCount();
+    int getMeshCount() {return meshes.size();}
+    int getTextureCount() {return textures.size();}
+
+    void reportMemory(MemoryReport &report);
+
+private:
+    struct Texture {
+        GLuint name;
+        qint64 bytes;
+    };
+
+    AssetCache() {}
+
+    QMutex mutex;
+    QHash<QString, QWeakPointer<Model>> models;
+    QHash<QString, Mesh> meshes;
+    QHash<QString, Texture> textures;
+};
+
+#endif // ASSETCACHE_H
@@ -0,0 +1,268 @@
+#include "assetpack.h"
+#include "log.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QXmlStreamReader>
+#include <QtEndian>
+
+static const quint32 packMagic = 0x4B415041;  // "APAK"
+static const quint32 packVersion = 1;
+static const int headerSize = 32;
+static const int entrySize = 32;
+// Entries start on cache lines.
+static const int alignment = 64;
+
+enum EntryFlags : quint32 {
+    COMPRESSED = 1
+};
+
+std::vector<std::unique_ptr<AssetPack>> AssetPack::mounted;
+
+AssetPack::~AssetPack() {
+    close();
+}
+
+void AssetPack::close() {
+    if (data && copy.isEmpty()) file.unmap(const_cast<uchar*>(data));
+    if (file.isOpen()) file.close();
+    data = nullptr;
+    copy.clear();
+    fileSize = 0;
+    entries.clear();
+    index.clear();
+}
+
+bool AssetPack::open(QString fileName) {
+    close();
+    name = fileName;
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("Cannot open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+    fileSize = file.size();
+    data = file.map(0, fileSize);
+    if (!data) {
+        // A pack inside the resources cannot be mapped.
+        copy = file.readAll();
+        data = reinterpret_cast<const uchar*>(copy.constData());
+    }
+
+    if (fileSize < headerSize || qFromLittleEndian<quint32>(data) != packMagic ||
+            qFromLittleEndian<quint32>(data + 4) != packVersion) {
+        error = QString("%1 is not a version %2 asset pack").arg(fileName).arg(packVersion);
+        close();
+        return false;
+    }
+    qint32 count = qFromLittleEndian<qint32>(data + 8);
+    if (count < 0 || headerSize + qint64(count) * entrySize > fileSize) {
+        error = QString("%1 is truncated").arg(fileName);
+        close();
+        return false;
+    }
+
+    entries.resize(count);
+    index.reserve(count);
+    for (int i = 0; i != count; ++i) {
+        const uchar *e = data + headerSize + i * entrySize;
+        Entry &entry = entries[i];
+        entry.offset = qFromLittleEndian<quint64>(e);
+        entry.stored = qFromLittleEndian<quint32>(e + 8);
+        entry.size = qFromLittleEndian<quint32>(e + 12);
+        quint32 nameOffset = qFromLittleEndian<quint32>(e + 16);
+        quint32 nameLength = qFromLittleEndian<quint32>(e + 20);
+        entry.flags = qFromLittleEndian<quint32>(e + 24);
+        if (entry.offset + entry.stored > quint64(fileSize) || quint64(nameOffset) + nameLength > quint64(fileSize)) {
+            error = QString("%1 is truncated").arg(fileName);
+            close();
+            return false;
+        }
+        index.insert(QString::fromUtf8(reinterpret_cast<const char*>(data + nameOffset), nameLength), i);
+    }
+    return true;
+}
+
+bool AssetPack::read(QString entryName, QByteArray &out) {
+    auto it = index.constFind(entryName);
+    if (it == index.constEnd()) return false;
+    const Entry &entry = entries[it.value()];
+    const uchar *stored = data + entry.offset;
+    if (!(entry.flags & COMPRESSED)) {
+        out = QByteArray::fromRawData(reinterpret_cast<const char*>(stored), static_cast<int>(entry.size));
+        return true;
+    }
+    out = qUncompress(stored, static_cast<int>(entry.stored));
+    if (out.size() != static_cast<int>(entry.size)) {
+        LOG(Log::ASSETS, Log::WARNING) << "Corrupt entry" << entryName << "in" << name;
+        out.clear();
+        return false;
+    }
+    inflated += entry.size;
+    return true;
+}
+
+qint64 AssetPack::getMemoryUsage() {
+    qint64 names = 0;
+    for (auto it = index.constBegin(); it != index.constEnd(); ++it) {
+        names += MemoryReport::bytes(it.key());
+    }
+    // The mapping is paged in on demand, the copy only exists when the file
+    // could not be mapped.
+    return MemoryReport::bytes(entries) + names + copy.capacity();
+}
+
+/**
+ * @brief AssetPack::build
+ *
+ * Reads the whole collection first, so the table can be written before the
+ * entries. The assets are small next to the memory it takes to use them.
+ */
+bool AssetPack::build(QString qrc, QString out, QString *error) {
+    QFile list(qrc);
+    if (!list.open(QIODevice::ReadOnly)) {
+        if (error) *error = QString("Cannot open %1: %2").arg(qrc, list.errorString());
+        return false;
+    }
+    QDir base = QFileInfo(qrc).absoluteDir();
+
+    // Name in the pack and path on disk, as the resource compiler resolves them.
+    QVector<QPair<QString, QString>> files;
+    QXmlStreamReader xml(&list);
+    QString prefix;
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement) continue;
+        if (xml.name() == "qresource") {
+            prefix = xml.attributes().value("prefix").toString();
+            if (!prefix.endsWith('/')) prefix += '/';
+            while (prefix.startsWith('/')) prefix.remove(0, 1);
+        } else if (xml.name() == "file") {
+            QString alias = xml.attributes().value("alias").toString();
+            QString path = xml.readElementText().trimmed();
+            files.push_back(qMakePair(prefix + (alias.isEmpty() ? path : alias), base.filePath(path)));
+        }
+    }
+    if (xml.hasError()) {
+        if (error) *error = QString("%1: %2").arg(qrc, xml.errorString());
+        return false;
+    }
+
+    QVector<QByteArray> contents, names;
+    QVector<quint32> sizes, flags;
+    for (const QPair<QString, QString> &f : files) {
+        QFile in(f.second);
+        if (!in.open(QIODevice::ReadOnly)) {
+            if (error) *error = QString("Cannot open %1: %2").arg(f.second, in.errorString());
+            return false;
+        }
+        QByteArray bytes = in.readAll();
+        QByteArray compressed = qCompress(bytes, 9);
+        bool compress = compressed.size() < bytes.size() - bytes.size() / 8;
+        sizes.push_back(static_cast<quint32>(bytes.size()));
+        flags.push_back(compress ? COMPRESSED : 0);
+        contents.push_back(compress ? compressed : bytes);
+        names.push_back(f.first.toUtf8());
+    }
+
+    int count = contents.size();
+    QByteArray table(headerSize + count * entrySize, '\0');
+    uchar *t = reinterpret_cast<uchar*>(table.data());
+    qToLittleEndian<quint32>(packMagic, t);
+    qToLittleEndian<quint32>(packVersion, t + 4);
+    qToLittleEndian<qint32>(count, t + 8);
+    qToLittleEndian<qint32>(alignment, t + 12);
+
+    QByteArray nameData;
+    for (const QByteArray &n : names) {
+        nameData += n;
+    }
+    qint64 offset = table.size() + nameData.size();
+    quint32 nameOffset = static_cast<quint32>(table.size());
+    for (int i = 0; i != count; ++i) {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        uchar *e = t + headerSize + i * entrySize;
+        qToLittleEndian<quint64>(static_cast<quint64>(offset), e);
+        qToLittleEndian<quint32>(static_cast<quint32>(contents[i].size()), e + 8);
+        qToLittleEndian<quint32>(sizes[i], e + 12);
+        qToLittleEndian<quint32>(nameOffset, e + 16);
+        qToLittleEndian<quint32>(static_cast<quint32>(names[i].size()), e + 20);
+        qToLittleEndian<quint32>(flags[i], e + 24);
+        nameOffset += names[i].size();
+        offset += contents[i].size();
+    }
+
+    QSaveFile pack(out);
+    if (!pack.open(QIODevice::WriteOnly)) {
+        if (error) *error = pack.errorString();
+        return false;
+    }
+    pack.write(table);
+    pack.write(nameData);
+    for (const QByteArray &c : contents) {
+        qint64 padding = (alignment - pack.pos() % alignment) % alignment;
+        pack.write(QByteArray(static_cast<int>(padding), '\0'));
+        pack.write(c);
+    }
+    if (!pack.commit()) {
+        if (error) *error = pack.errorString();
+        return false;
+    }
+    return true;
+}
+
+// --- Mounted packs
+
+bool AssetPack::mount(QString file) {
+    std::unique_ptr<AssetPack> pack(new AssetPack);
+    if (!pack->open(file)) {
+        LOG(Log::ASSETS, Log::WARNING) << pack->errorString();
+        return false;
+    }
+    LOG(Log::ASSETS, Log::INFO) << "Mounted" << pack->size() << "assets from" << file;
+    mounted.push_back(std::move(pack));
+    return true;
+}
+
+bool AssetPack::findMounted(QString path, QByteArray &out) {
+    if (!path.startsWith(":/")) return false;
+    QString entry = path.mid(2);
+    for (std::unique_ptr<AssetPack> &pack : mounted) {
+        if (pack->read(entry, out)) return true;
+    }
+    return false;
+}
+
+std::unique_ptr<QIODevice> AssetPack::openAsset(QString path, QString *error) {
+    QByteArray bytes;
+    if (findMounted(path, bytes)) {
+        std::unique_ptr<QBuffer> buffer(new QBuffer);
+        buffer->setData(bytes);
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
+    }
+    std::unique_ptr<QFile> in(new QFile(path));
+    if (!in->open(QIODevice::ReadOnly)) {
+        if (error) *error = QString("Cannot open %1: %2").arg(path, in->errorString());
+        return nullptr;
+    }
+    return in;
+}
+
+bool AssetPack::readAsset(QString path, QByteArray &out, QString *error) {
+    if (findMounted(path, out)) return true;
+    QFile in(path);
+    if (!in.open(QIODevice::ReadOnly)) {
+        if (error) *error = QString("Cannot open %1: %2").arg(path, in.errorString());
+        return false;
+    }
+    out = in.readAll();
+    return true;
+}
+
+void AssetPack::reportMounted(MemoryReport &report) {
+    for (std::unique_ptr<AssetPack> &pack : mounted) {
+        report.add(MemoryReport::CPU, "assets", "pack " + pack->getName(), pack->getMemoryUsage());
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QIODevice>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "memoryreport.h"
+
+/**
+ * @brief The AssetPack class
+ *
+ * The files of a resource collection in one memory mapped file, read through
+ * the same ":/" paths as the compiled-in resources. Opening a pack maps it and
+ * reads its table; an entry's pages are only read from disk when the entry is,
+ * and compressed entries are only inflated then. Entries that are stored are
+ * handed out without a copy.
+ *
+ * The file is a 32 byte header (magic "APAK", version, entry count, data
+ * alignment, reserved), a table of 32 byte entries (offset, stored size,
+ * size, name offset, name length, flags, reserved) and the UTF-8 names,
+ * followed by the entries, each starting at a multiple of the alignment.
+ * Values are little endian. A compressed entry is stored as by qCompress.
+ */
+class AssetPack {
+public:
+    AssetPack() {}
+    ~AssetPack();
+
+    bool open(QString file);
+    QString errorString() {return error;}
+    QString getName() {return name;}
+    int size() {return entries.size();}
+    bool contains(QString name) {return index.contains(name);}
+
+    // An entry by its name without ":/". Stored entries point into the
+    // mapping and are valid while the pack is open.
+    bool read(QString name, QByteArray &data);
+    // Bytes of the file, and of the entries inflated so far; the inflated
+    // copies belong to the readers.
+    qint64 getFileBytes() {return fileSize;}
+    qint64 getInflatedBytes() {return inflated;}
+    qint64 getMemoryUsage();
+
+    // Packs the files listed in a .qrc file, relative to its directory.
+    // Entries that shrink by at least an eighth are compressed.
+    static bool build(QString qrc, QString file, QString *error = nullptr);
+
+    // Packs searched before the compiled-in resources, for the whole run.
+    // Mount them before anything is read.
+    static bool mount(QString file);
+    static int getMountedCount() {return static_cast<int>(mounted.size());}
+    // A ":/" path from the first mounted pack that has it, anything else,
+    // and paths no pack has, through QFile.
+    static std::unique_ptr<QIODevice> openAsset(QString path, QString *error = nullptr);
+    static bool readAsset(QString path, QByteArray &data, QString *error = nullptr);
+    static void reportMounted(MemoryReport &report);
+
+private:
+    struct Entry {
+        quint64 offset;
+        quint32 stored;
+        quint32 size;
+        quint32 flags;
+    };
+
+    QFile file;
+    QString name;
+    QString error;
+    const uchar *data = nullptr;
+    QByteArray copy;        // Holds the data when the file cannot be mapped.
+    qint64 fileSize = 0;
+    QVector<Entry> entries;
+    QHash<QString, int> index;
+    std::atomic<qint64> inflated{0};
+
+    static std::vector<std::unique_ptr<AssetPack>> mounted;
+
+    void close();
+    static bool findMounted(QString path, QByteArray &data);
+};
+
+#endif // ASSETPACK_H
@@ -0,0 +1,65 @@
+#include "assetpack.h"
+#include "benchmark.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+/**
+ * Packing one 1 KB asset per 100 of size, half of them model text that gets
+ * compressed and half noise that is stored as is, then opening the pack and
+ * reading every entry of each kind.
+ */
+void benchAssetPack(QVector<int> sizes) {
+    for (int n : sizes) {
+        QTemporaryDir dir;
+        if (!dir.isValid()) return;
+        int files = qMax(2, n / 100);
+        QDir(dir.path()).mkpath("models");
+        QDir(dir.path()).mkpath("textures");
+
+        QFile qrc(dir.filePath("assets.qrc"));
+        if (!qrc.open(QIODevice::WriteOnly)) return;
+        QTextStream list(&qrc);
+        list << "<RCC>\n    <qresource prefix=\"/\">\n";
+        quint32 noise = 1;
+        for (int i = 0; i != files; ++i) {
+            QString name = QString(i % 2 ? "textures/%1.bin" : "models/%1.obj").arg(i);
+            QFile asset(dir.filePath(name));
+            if (!asset.open(QIODevice::WriteOnly)) return;
+            QByteArray bytes;
+            for (int k = 0; k != 1024; ++k) {
+                if (i % 2) {
+                    noise = noise * 1664525u + 1013904223u;
+                    bytes.append(static_cast<char>(noise >> 24));
+                } else {
+                    bytes.append("v 0.5 0.25 1.0\n"[k % 15]);
+                }
+            }
+            asset.write(bytes);
+            list << "        <file>" << name << "</file>\n";
+        }
+        list << "    </qresource>\n</RCC>\n";
+        list.flush();
+        qrc.close();
+
+        QString pack = dir.filePath("assets.pack");
+        report("assetpack.build", n, timeBest(1, [&] {AssetPack::build(qrc.fileName(), pack);}), files);
+        report("assetpack.open", n, timeBest(3, [&] {
+            AssetPack opened;
+            opened.open(pack);
+        }), files);
+
+        AssetPack opened;
+        if (!opened.open(pack)) return;
+        QByteArray data;
+        for (int kind = 0; kind != 2; ++kind) {
+            report(kind ? "assetpack.read.stored" : "assetpack.read.compressed", n, timeBest(3, [&] {
+                for (int i = kind; i < files; i += 2) {
+                    opened.read(QString(kind ? "textures/%1.bin" : "models/%1.obj").arg(i), data);
+                }
+            }), files / 2);
+        }
+    }
+}
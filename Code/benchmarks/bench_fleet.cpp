@@ -0,0 +1,86 @@
+#include "benchmark.h"
+#include "ephemeris.h"
+#include "fleet.h"
+
+#include <cmath>
+
+// Update throughput for each thread count from one up to all cores.
+void benchFleet(QVector<int> sizes) {
+    const int steps = 20;
+
+    // Nine planets on circles, like SolarSystem.
+    QVector<QVector3D> targets;
+    QVector<float> radii;
+    for (int p = 0; p != 9; ++p) {
+        float r = 1000.0f + 5000.0f * p;
+        targets.push_back(QVector3D(r * std::sin(float(p)), 0.0f, r * std::cos(float(p))));
+        radii.push_back(10.0f + p);
+    }
+
+    QVector<int> threadCounts;
+    int cores = ThreadPool::instance()->size();
+    for (int t = 1; t < cores; t *= 2) {
+        threadCounts.push_back(t);
+    }
+    threadCounts.push_back(cores);
+
+    for (int n : sizes) {
+        for (int threads : threadCounts) {
+            ThreadPool pool(threads);
+            Fleet fleet;
+            fleet.setSeed(1);
+            fleet.addShips(n, targets[2], radii[2], targets.size(), 4.0f, 12.0f);
+
+            double ms = timeBest(3, [&] {
+                for (int s = 0; s != steps; ++s) {
+                    fleet.update(1.0f, targets, radii, &pool);
+                }
+            });
+            report(QString("fleet.update threads=%1").arg(threads), n, ms / steps, n);
+        }
+    }
+
+    // The same planets on orbits, with the time step of MainView.
+    const float timeStep = 0.0016f;
+    QVector<Orbit> orbits;
+    QVector<Navigator::Ephemeris> ephemerides;
+    for (int p = 0; p != targets.size(); ++p) {
+        OrbitalElements elements;
+        elements.semiMajorAxis = targets[p].length();
+        elements.meanAnomaly = p * 40.0;
+        elements.period = 30.0 * (p + 1);
+        orbits.push_back(Orbit(elements));
+    }
+    for (const Orbit &orbit : orbits) {
+        ephemerides.push_back([&orbit](double t) {return orbit.position(t);});
+    }
+
+    for (int n : sizes) {
+        for (int threads : threadCounts) {
+            ThreadPool pool(threads);
+            Fleet fleet;
+            fleet.setSeed(1);
+            fleet.addShips(n, orbits[2].position(0.0), radii[2], targets.size(), 4.0f, 12.0f);
+
+            // Every ship solves an intercept, as after a jump in time.
+            double t = 0;
+            double ms = timeBest(3, [&] {
+                for (int s = 0; s != steps; ++s) {
+                    fleet.clearCourses();
+                    fleet.navigate(t, ephemerides, radii, timeStep, &pool);
+                    t += timeStep;
+                }
+            });
+            report(QString("fleet.navigate.solve threads=%1").arg(threads), n, ms / steps, n);
+
+            // Ships follow the courses they have, only arrivals solve again.
+            ms = timeBest(3, [&] {
+                for (int s = 0; s != steps; ++s) {
+                    fleet.navigate(t, ephemerides, radii, timeStep, &pool);
+                    t += timeStep;
+                }
+            });
+            report(QString("fleet.navigate.cached threads=%1").arg(threads), n, ms / steps, n);
+        }
+    }
+}
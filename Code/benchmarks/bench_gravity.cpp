@@ -0,0 +1,72 @@
+#include "benchmark.h"
+#include "ephemeris.h"
+#include "nbody.h"
+
+#include <QtMath>
+#include <cmath>
+#include <random>
+
+/**
+ * Analytic orbits against a Barnes-Hut step for the same bodies: a central
+ * mass with everything else on circular orbits in a thin disc. The Kepler
+ * ephemeris evaluates the same bodies on eccentric, inclined orbits, at a
+ * time far enough out that float time would have lost the phase.
+ */
+void benchGravity(QVector<int> sizes) {
+    for (int n : sizes) {
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> radius(1000.0f, 75000.0f);
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        std::uniform_real_distribution<float> height(-100.0f, 100.0f);
+
+        const float muSun = 6.3e9f;
+        QVector<float> radii(n), periods(n), phases(n);
+        NBody gravity;
+        gravity.addBody(QVector3D(), QVector3D(), muSun);
+        for (int i = 1; i != n; ++i) {
+            radii[i] = radius(rng);
+            phases[i] = angle(rng);
+            periods[i] = std::sqrt(radii[i] * radii[i] * radii[i] / muSun);
+            QVector3D p(radii[i] * std::sin(phases[i]), height(rng), radii[i] * std::cos(phases[i]));
+            QVector3D v = QVector3D(p.z(), 0.0f, -p.x()) / periods[i];
+            gravity.addBody(p, v, 1.0e3f);
+        }
+
+        // Same work as Planet::moveAround for every body.
+        QVector<QVector3D> positions(n);
+        float t = 0;
+        report("orbits.analytic", n, timeBest(5, [&] {
+            t += 0.0016f;
+            for (int i = 1; i != n; ++i) {
+                float a = phases[i] + t / periods[i];
+                positions[i] = QVector3D(radii[i] * std::sin(a), 0.0f, radii[i] * std::cos(a));
+            }
+        }), n);
+
+        std::uniform_real_distribution<double> eccentricity(0.0, 0.6);
+        QVector<Orbit> orbits(n);
+        for (int i = 1; i != n; ++i) {
+            OrbitalElements elements;
+            elements.semiMajorAxis = radii[i];
+            elements.eccentricity = eccentricity(rng);
+            elements.inclination = height(rng) * 0.1;
+            elements.ascendingNode = qRadiansToDegrees(angle(rng));
+            elements.meanAnomaly = qRadiansToDegrees(phases[i]);
+            elements.period = 2.0 * M_PI * periods[i];
+            orbits[i] = Orbit(elements);
+        }
+        double far = 1.0e9;
+        report("orbits.ephemeris", n, timeBest(5, [&] {
+            far += 0.0016;
+            for (int i = 1; i != n; ++i) {
+                positions[i] = orbits[i].position(far);
+            }
+        }), n);
+
+        // A force pass takes seconds at a million bodies, so these run once.
+        ThreadPool *pool = ThreadPool::instance();
+        gravity.computeForces(pool);
+        report("orbits.gravity.tree", n, timeBest(1, [&] {gravity.computeForces(pool);}), n);
+        report("orbits.gravity.step", n, timeBest(1, [&] {gravity.step(0.0016f, pool);}), n);
+    }
+}
@@ -0,0 +1,27 @@
+#include "benchmark.h"
+#include "lightclusters.h"
+
+#include <QtGlobal>
+
+// Binning time for lights spread through the view volume of the default camera.
+void benchLightClusters(QVector<int> sizes) {
+    QMatrix4x4 view;
+    view.lookAt(QVector3D(0, 2000, 6000), QVector3D(), QVector3D(0, 1, 0));
+
+    for (int n : sizes) {
+        qsrand(1);
+        QVector<PointLight> lights(n);
+        for (PointLight &light : lights) {
+            float x = (qrand() % 20001 - 10000) * 1.0f;
+            float y = (qrand() % 2001 - 1000) * 1.0f;
+            float z = (qrand() % 20001 - 10000) * 1.0f;
+            light = {QVector3D(x, y, z), 150.0f, QVector3D(1.0f, 0.55f, 0.2f)};
+        }
+
+        LightClusters clusters;
+        double ms = timeBest(5, [&] {
+            clusters.build(lights, view, 60.0f, 16.0f / 9.0f, 0.2f, 100000.0f, ThreadPool::instance());
+        });
+        report("lightclusters.build", n, ms, n);
+    }
+}
@@ -0,0 +1,100 @@
+#include "benchmark.h"
+#include "model.h"
+
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <cmath>
+
+struct ModelBenchmark {
+    static void parse(Model &m, QString text) {
+        QTextStream in(&text);
+        m.parse(in);
+    }
+    static void unpackIndexes(Model &m) {m.unpackIndexes();}
+    static void alignData(Model &m) {m.alignData();}
+};
+
+// A w x h grid bent into a sphere, as OBJ text with positions, normals and
+// texture coordinates sharing their indices, like the sphere model.
+static QString generateObj(int triangles) {
+    int w = std::max(1, static_cast<int>(std::sqrt(triangles / 2.0)));
+    int h = std::max(1, triangles / (2 * w));
+
+    QString text;
+    QTextStream out(&text);
+    out << "# " << 2 * w * h << " triangles\n";
+    for (int y = 0; y <= h; ++y) {
+        float theta = 3.1415927f * y / h;
+        for (int x = 0; x <= w; ++x) {
+            float phi = 6.2831853f * x / w;
+            float nx = std::sin(theta) * std::cos(phi), ny = std::cos(theta), nz = std::sin(theta) * std::sin(phi);
+            out << "v " << nx << " " << ny << " " << nz << "\n";
+            out << "vn " << nx << " " << ny << " " << nz << "\n";
+            out << "vt " << float(x) / w << " " << float(y) / h << "\n";
+        }
+    }
+    for (int y = 0; y != h; ++y) {
+        for (int x = 0; x != w; ++x) {
+            int a = y * (w + 1) + x + 1, b = a + 1, c = a + w + 1, d = c + 1;
+            out << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c
+                << " " << b << "/" << b << "/" << b << "\n";
+            out << "f " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c
+                << " " << d << "/" << d << "/" << d << "\n";
+        }
+    }
+    out.flush();
+    return text;
+}
+
+/**
+ * The loading stages of Model on generated meshes. Sizes are divided by 100
+ * and used as triangle counts, alignData is quadratic in the vertex count.
+ */
+void benchModel(QVector<int> sizes) {
+    for (int size : sizes) {
+        int triangles = std::max(2, size / 100);
+        QString text = generateObj(triangles);
+
+        QTemporaryFile file;
+        file.open();
+        file.write(text.toUtf8());
+        file.close();
+
+        report("model.load", triangles, timeBest(3, [&] {Model m(file.fileName());}), triangles);
+
+        report("model.parse", triangles, timeBest(3, [&] {
+            Model m("");
+            ModelBenchmark::parse(m, text);
+        }), triangles);
+
+        Model parsed("");
+        ModelBenchmark::parse(parsed, text);
+        report("model.unpackIndexes", triangles, timeBest(3, [&] {
+            Model m = parsed;
+            ModelBenchmark::unpackIndexes(m);
+        }), triangles);
+
+        ModelBenchmark::unpackIndexes(parsed);
+        report("model.alignData", triangles, timeBest(3, [&] {
+            Model m = parsed;
+            ModelBenchmark::alignData(m);
+        }), triangles);
+
+        Model model(file.fileName());
+        report("model.unitize", triangles, timeBest(3, [&] {
+            Model m = model;
+            m.unitize();
+        }), triangles);
+
+        report("model.getVNInterleaved", triangles, timeBest(5, [&] {model.getVNInterleaved();}), triangles);
+        report("model.getVNTInterleaved", triangles, timeBest(5, [&] {model.getVNTInterleaved();}), triangles);
+        report("model.getVNInterleaved_indexed", triangles,
+               timeBest(5, [&] {model.getVNInterleaved_indexed();}), triangles);
+        report("model.getVNTInterleaved_indexed", triangles,
+               timeBest(5, [&] {model.getVNTInterleaved_indexed();}), triangles);
+        report("model.getVTInterleaved_indexed", triangles,
+               timeBest(5, [&] {model.getVTInterleaved_indexed();}), triangles);
+        report("model.getVNinvTInterleaved_indexed", triangles,
+               timeBest(5, [&] {model.getVNinvTInterleaved_indexed();}), triangles);
+    }
+}
@@ -0,0 +1,29 @@
+#include "benchmark.h"
+#include "object.h"
+
+#include <QImage>
+#include <cmath>
+
+struct ObjectBenchmark {
+    static QVector<quint8> imageToBytes(Object &o, QImage image) {return o.imageToBytes(image);}
+};
+
+// Texture conversion of square images with about size pixels.
+void benchObject(QVector<int> sizes) {
+    Object object("benchmark", "", "");
+
+    for (int size : sizes) {
+        int side = std::max(1, static_cast<int>(std::sqrt(double(size))));
+        QImage image(side, side, QImage::Format_ARGB32);
+        for (int y = 0; y != side; ++y) {
+            QRgb *line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x != side; ++x) {
+                line[x] = qRgba(x & 0xff, y & 0xff, (x ^ y) & 0xff, 0xff);
+            }
+        }
+
+        int pixels = side * side;
+        report("object.imageToBytes", pixels,
+               timeBest(5, [&] {ObjectBenchmark::imageToBytes(object, image);}), pixels);
+    }
+}
@@ -0,0 +1,99 @@
+#include "benchmark.h"
+#include "bvh.h"
+#include "model.h"
+
+#include <random>
+
+// Bodies spread over a thin disc like the planets, mostly small with a few giants.
+static void generate(int n, QVector<QVector3D> &centers, QVector<float> &radii) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> disc(-75000.0f, 75000.0f);
+    std::uniform_real_distribution<float> height(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(1.0f, 20.0f);
+
+    centers.resize(n);
+    radii.resize(n);
+    for (int i = 0; i != n; ++i) {
+        centers[i] = QVector3D(disc(rng), height(rng), disc(rng));
+        radii[i] = i % 1000 == 0 ? 1000.0f : size(rng);
+    }
+}
+
+/**
+ * Rays from a camera above the disc towards random bodies, as clicks on the
+ * screen would be, against the sphere hierarchy and against every sphere.
+ * The spaceship mesh is picked in its unitized model space.
+ */
+void benchPicking(QVector<int> sizes) {
+    const int rays = 1000;
+
+    for (int n : sizes) {
+        QVector<QVector3D> centers;
+        QVector<float> radii;
+        generate(n, centers, radii);
+
+        SphereBVH bodies;
+        report("picking.build", n, timeBest(3, [&] {bodies.build(centers, radii);}));
+
+        // One simulation step worth of motion.
+        QVector<QVector3D> moved = centers;
+        for (QVector3D &c : moved) {
+            c += QVector3D(2.0f, 0.0f, -2.0f);
+        }
+        report("picking.refit", n, timeBest(3, [&] {bodies.refit(moved, radii);}));
+
+        QVector3D eye(0.0f, 20000.0f, 90000.0f);
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> target(0, n - 1);
+        QVector<QVector3D> directions;
+        for (int r = 0; r != rays; ++r) {
+            directions.push_back((moved[target(rng)] - eye).normalized());
+        }
+
+        volatile int hits = 0;
+        report("picking.ray x1000", n, timeBest(3, [&] {
+            float distance;
+            for (QVector3D d : directions) hits += bodies.intersect(eye, d, distance) >= 0;
+        }), rays);
+
+        // The batch without a hierarchy, for comparison; only a few rays at large sizes.
+        int bruteRays = std::max(1, std::min(rays, 10000000 / n));
+        double ms = timeBest(1, [&] {
+            for (int r = 0; r != bruteRays; ++r) {
+                QVector3D d = directions[r];
+                float nearest = std::numeric_limits<float>::infinity();
+                for (int i = 0; i != n; ++i) {
+                    QVector3D m = eye - moved[i];
+                    float b = QVector3D::dotProduct(m, d);
+                    float c = m.lengthSquared() - radii[i] * radii[i];
+                    float discriminant = b * b - c;
+                    if (c > 0.0f && b <= 0.0f && discriminant >= 0.0f) {
+                        nearest = std::min(nearest, -b - std::sqrt(discriminant));
+                    }
+                }
+                hits += nearest < std::numeric_limits<float>::infinity();
+            }
+        });
+        report(QString("picking.brute x%1").arg(bruteRays), n, ms, bruteRays);
+    }
+
+    Model model(":/models/cat.obj");
+    model.unitize();
+    TriangleBVH triangles;
+    int count = model.getNumTriangles();
+    report("picking.mesh.build", count, timeBest(5, [&] {
+        triangles.build(model.getVertices_indexed(), model.getIndices());
+    }), count);
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    QVector<QVector3D> origins;
+    for (int r = 0; r != rays; ++r) {
+        origins.push_back(QVector3D(offset(rng), offset(rng), 5.0f));
+    }
+    volatile int hits = 0;
+    report("picking.mesh.ray x1000", count, timeBest(3, [&] {
+        float distance;
+        for (QVector3D o : origins) hits += triangles.intersect(o, QVector3D(0.0f, 0.0f, -1.0f), distance) >= 0;
+    }), rays);
+}
@@ -0,0 +1,65 @@
+#include "benchmark.h"
+#include "scenefile.h"
+#include "solarsystem.h"
+
+#include <QTemporaryFile>
+#include <QTextStream>
+
+// A sun with size planets, every tenth a moon of the planet before it.
+static QVector<SceneBody> generateScene(int size) {
+    QVector<SceneBody> bodies(size + 1);
+    bodies[0].kind = SceneBody::SUN;
+    bodies[0].name = "Sun";
+    bodies[0].radius = 2000.0f;
+    for (int i = 1; i <= size; ++i) {
+        SceneBody &b = bodies[i];
+        b.listed = false;
+        b.parent = i % 10 == 0 ? i - 1 : 0;
+        b.name = QString("Body %1").arg(i);
+        b.texture = ":/textures/moon.jpg";
+        b.radius = 1.0f + i % 7;
+        b.rotation = 10.0f;
+        b.distance = b.parent == 0 ? 3000.0f + i * 0.1f : 20.0f;
+        b.period = 1.0f + i % 100;
+    }
+    return bodies;
+}
+
+static void writeText(QIODevice *file, const QVector<SceneBody> &bodies) {
+    QTextStream out(file);
+    out << "sun \"" << bodies[0].name << "\" radius " << bodies[0].radius << "\n";
+    for (int i = 1; i != bodies.size(); ++i) {
+        const SceneBody &b = bodies[i];
+        out << "planet \"" << b.name << "\" orbits \"" << bodies[b.parent].name << "\" unlisted radius " << b.radius
+            << " rotation " << b.rotation << " distance " << b.distance << " period " << b.period
+            << " texture " << b.texture << "\n";
+    }
+}
+
+// Reading size bodies from the text and binary form, and creating them in a SolarSystem.
+void benchScene(QVector<int> sizes) {
+    for (int n : sizes) {
+        QVector<SceneBody> bodies = generateScene(n);
+
+        QTemporaryFile text, binary;
+        if (!text.open() || !binary.open()) return;
+        writeText(&text, bodies);
+        text.close();
+        binary.close();
+        SceneWriter::writeBinary(binary.fileName(), bodies);
+
+        auto readAll = [](QString file) {
+            SceneReader reader;
+            QVector<SceneBody> out;
+            reader.open(file);
+            while (reader.read(4096, out) > 0) {
+                out.clear();
+            }
+        };
+        report("scene.read.text", n, timeBest(3, [&] {readAll(text.fileName());}), n);
+        report("scene.read.binary", n, timeBest(3, [&] {readAll(binary.fileName());}), n);
+
+        SolarSystem ss;
+        report("scene.load.binary", n, timeBest(1, [&] {ss.loadScene(binary.fileName());}), n);
+    }
+}
@@ -0,0 +1,117 @@
+#include "benchmark.h"
+#include "orbitbuffer.h"
+#include "solarsystem.h"
+#include "transformhierarchy.h"
+
+#include <QMatrix4x4>
+#include <cmath>
+
+// Whole simulation steps with size fleet ships on top of the planets.
+void benchSolarSystem(QVector<int> sizes) {
+    const int steps = 10;
+
+    for (int n : sizes) {
+        SolarSystem::setDefaultFleetSize(n);
+        SolarSystem ss;
+        int bodies = ss.objects.size() + ss.fleet.size();
+
+        float t = 0;
+        report("solarsystem.simulate", bodies, timeBest(3, [&] {
+            for (int s = 0; s != steps; ++s) {
+                t += 0.0016f;
+                ss.simulate(t, 1.0f);
+            }
+        }) / steps, bodies);
+
+        ss.setSimulationMode(SolarSystem::GRAVITY);
+        ss.simulate(t, 1.0f);
+        report("solarsystem.simulate.gravity", bodies, timeBest(3, [&] {
+            for (int s = 0; s != steps; ++s) {
+                t += 0.0016f;
+                ss.simulate(t, 1.0f);
+            }
+        }) / steps, bodies);
+    }
+    SolarSystem::setDefaultFleetSize(0);
+}
+
+/**
+ * Model matrices for size objects: composing them like the old
+ * MainView::updateModelTransform, against TransformHierarchy when every node
+ * moved and every matrix is read, when only the positions are needed and when
+ * nothing moved. Packing planets for OrbitBuffer is what the GPU orbits cost
+ * instead, once per epoch.
+ */
+void benchTransforms(QVector<int> sizes) {
+    for (int n : sizes) {
+        QVector<QVector3D> locations(n);
+        QVector<float> scales(n), angles(n);
+        for (int i = 0; i != n; ++i) {
+            locations[i] = QVector3D(std::sin(float(i)) * i, 0.0f, std::cos(float(i)) * i);
+            scales[i] = 1.0f + i % 10;
+            angles[i] = float(i % 360);
+        }
+
+        QVector<QMatrix4x4> models(n);
+        QVector<QMatrix3x3> normals(n);
+        report("transforms.compose", n, timeBest(5, [&] {
+            for (int i = 0; i != n; ++i) {
+                QMatrix4x4 &m = models[i];
+                m.setToIdentity();
+                m.translate(locations[i]);
+                m.rotate(0.0f, {1.0F, 0.0F, 0.0F});
+                m.rotate(0.0f, {0.0F, 1.0F, 0.0F});
+                m.rotate(0.0f, {0.0F, 0.0F, 1.0F});
+                m.scale(scales[i]);
+                m.rotate(angles[i], {0, 1, 0});
+                normals[i] = m.normalMatrix();
+            }
+        }), n);
+
+        // Every tenth node is a child of the node before it, like moons.
+        TransformHierarchy hierarchy;
+        for (int i = 0; i != n; ++i) {
+            hierarchy.addNode(i % 10 == 9 ? i - 1 : -1);
+        }
+        float spin = 0;
+        report("transforms.hierarchy.moving", n, timeBest(5, [&] {
+            spin += 1.0f;
+            for (int i = 0; i != n; ++i) {
+                hierarchy.setLocal(i, locations[i], scales[i], angles[i] + spin);
+            }
+            hierarchy.update();
+            for (int i = 0; i != n; ++i) {
+                models[i] = hierarchy.getWorld(i);
+                normals[i] = hierarchy.getNormal(i);
+            }
+        }), n);
+
+        report("transforms.hierarchy.positions", n, timeBest(5, [&] {
+            spin += 1.0f;
+            for (int i = 0; i != n; ++i) {
+                hierarchy.setLocal(i, locations[i], scales[i], angles[i] + spin);
+            }
+            hierarchy.update();
+        }), n);
+
+        report("transforms.hierarchy.static", n, timeBest(5, [&] {
+            for (int i = 0; i != n; ++i) {
+                hierarchy.setLocal(i, locations[i], scales[i], angles[i] + spin);
+            }
+            hierarchy.update();
+        }), n);
+
+        // Every tenth planet is a moon of the one before it.
+        Sun sun("Sun", 10.0f, 0.0f);
+        QVector<Object*> bodies;
+        bodies.push_back(&sun);
+        for (int i = 0; i != n; ++i) {
+            Sphere *around = i % 10 == 9 ? static_cast<Sphere*>(bodies.back()) : &sun;
+            bodies.push_back(new Planet(QString::number(i), ":/textures/earth.png", 1.0f, 0.0f,
+                                        10.0f + i % 1000, 10.0f + i % 97, around));
+        }
+        QVector<float> data;
+        report("transforms.orbits.pack", n, timeBest(5, [&] {OrbitBuffer::pack(bodies, 12345.678, data);}), n);
+        qDeleteAll(bodies.begin() + 1, bodies.end());
+    }
+}
@@ -0,0 +1,54 @@
+#include "benchmark.h"
+#include "spatialgrid.h"
+
+#include <random>
+
+// Objects spread over a thin disc like the planets, mostly small with a few giants.
+static void generate(int n, QVector<QVector3D> &centers, QVector<float> &radii) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> disc(-75000.0f, 75000.0f);
+    std::uniform_real_distribution<float> height(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(1.0f, 20.0f);
+
+    centers.resize(n);
+    radii.resize(n);
+    for (int i = 0; i != n; ++i) {
+        centers[i] = QVector3D(disc(rng), height(rng), disc(rng));
+        radii[i] = i % 1000 == 0 ? 1000.0f : size(rng);
+    }
+}
+
+void benchSpatialGrid(QVector<int> sizes) {
+    for (int n : sizes) {
+        QVector<QVector3D> centers;
+        QVector<float> radii;
+        generate(n, centers, radii);
+
+        SpatialGrid grid(500.0f);
+        report("spatialgrid.build", n, timeBest(5, [&] {grid.build(centers, radii);}));
+
+        // One simulation step worth of motion.
+        QVector<QVector3D> moved = centers;
+        for (QVector3D &c : moved) {
+            c += QVector3D(2.0f, 0.0f, -2.0f);
+        }
+        report("spatialgrid.refit", n, timeBest(5, [&] {grid.refit(moved, radii);}));
+
+        const int queries = 1000;
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> pick(0, n - 1);
+        QVector<QVector3D> points;
+        for (int q = 0; q != queries; ++q) {
+            points.push_back(moved[pick(rng)]);
+        }
+
+        volatile int found = 0;
+        report("spatialgrid.radius x1000", n, timeBest(3, [&] {
+            for (QVector3D p : points) found += grid.queryRadius(p, 250.0f).size();
+        }));
+        report("spatialgrid.nearest8 x1000", n, timeBest(3, [&] {
+            for (QVector3D p : points) found += grid.queryNearest(p, 8).size();
+        }));
+        report("spatialgrid.pairs", n, timeBest(3, [&] {found += grid.overlappingPairs().size();}));
+    }
+}
@@ -0,0 +1,38 @@
+#include "benchmark.h"
+#include "starfield.h"
+
+#include <QTemporaryFile>
+#include <QTextStream>
+
+// Generating, writing and opening catalogs of size stars. Opening a binary
+// catalog only maps it, the copy happens in the upload.
+void benchStars(QVector<int> sizes) {
+    for (int n : sizes) {
+        StarCatalog catalog;
+        report("stars.generate", n, timeBest(3, [&] {catalog.generate(n, 1);}), n);
+
+        QTemporaryFile binary, csv;
+        if (!binary.open() || !csv.open()) return;
+        binary.close();
+        report("stars.writeBinary", n, timeBest(3, [&] {
+            StarCatalog::writeBinary(binary.fileName(), catalog.stars(), catalog.size());
+        }), n);
+
+        QTextStream out(&csv);
+        out << "ra,dec,vmag,b-v\n";
+        for (int i = 0; i != n; ++i) {
+            out << (i * 0.37f) << "," << (i % 180 - 90) << "," << (i % 90) * 0.1f << ",0.6\n";
+        }
+        out.flush();
+        csv.close();
+
+        report("stars.open.binary", n, timeBest(3, [&] {
+            StarCatalog mapped;
+            mapped.open(binary.fileName());
+        }), n);
+        report("stars.open.csv", n, timeBest(1, [&] {
+            StarCatalog parsed;
+            parsed.open(csv.fileName());
+        }), n);
+    }
+}
@@ -0,0 +1,48 @@
+#include "benchmark.h"
+#include "virtualtexture.h"
+
+#include <QTemporaryDir>
+
+// A planet map with some detail for the JPEG encoder, width twice the height.
+static QImage generateMap(int width) {
+    QImage image(width, width / 2, QImage::Format_RGB32);
+    for (int y = 0; y != image.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x != width; ++x) {
+            int noise = ((x * 7919) ^ (y * 104729)) & 31;
+            line[x] = qRgb((x * 255 / width + noise) & 255, (y * 511 / width + noise) & 255, (x ^ y) & 255);
+        }
+    }
+    return image;
+}
+
+/**
+ * Splitting a map into pages, and reading every page of the finest level the
+ * way the loader thread does. The map has one 128 texel page across per 20000
+ * of size, between 2 and 32.
+ */
+void benchVirtualTexture(QVector<int> sizes) {
+    QTemporaryDir dir;
+    if (!dir.isValid()) return;
+
+    for (int n : sizes) {
+        int pagesAcross = qBound(2, n / 20000, 32);
+        QString source = dir.filePath("map.png"), pages = dir.filePath("map.vt");
+        if (!generateMap(pagesAcross * 128).save(source)) return;
+
+        VirtualTextureFile file;
+        double ms = timeBest(1, [&] {VirtualTextureFile::build(source, pages);});
+        if (!file.open(pages)) return;
+        report("virtualtexture.build", n, ms, file.getPageCount());
+
+        QImage page;
+        int count = file.getPagesX() * file.getPagesY();
+        report("virtualtexture.readPage", n, timeBest(3, [&] {
+            for (int y = 0; y != file.getPagesY(); ++y) {
+                for (int x = 0; x != file.getPagesX(); ++x) {
+                    file.readPage(0, x, y, page);
+                }
+            }
+        }), count);
+    }
+}
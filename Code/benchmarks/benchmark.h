@@ -0,0 +1,48 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+#include <algorithm>
+#include <limits>
+
+/**
+ * Benchmarks for the GL independent parts of the application.
+ * Each bench function runs its cases at the given problem sizes on generated
+ * input and records one result per case through report(). Results are printed
+ * as they come or, with --format json or csv, all at the end.
+ */
+
+// Best wall time of fn over the repeats, in milliseconds.
+template <typename F>
+double timeBest(int repeats, F fn) {
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i != repeats; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        fn();
+        best = std::min(best, timer.nsecsElapsed() / 1.0e6);
+    }
+    return best;
+}
+
+// items > 0 adds a throughput column, items processed per second.
+void report(QString name, int size, double ms, double items = 0);
+
+void benchSpatialGrid(QVector<int> sizes);
+void benchAssetPack(QVector<int> sizes);
+void benchFleet(QVector<int> sizes);
+void benchGravity(QVector<int> sizes);
+void benchLightClusters(QVector<int> sizes);
+void benchModel(QVector<int> sizes);
+void benchObject(QVector<int> sizes);
+void benchPicking(QVector<int> sizes);
+void benchScene(QVector<int> sizes);
+void benchStars(QVector<int> sizes);
+void benchSolarSystem(QVector<int> sizes);
+void benchTransforms(QVector<int> sizes);
+void benchVirtualTexture(QVector<int> sizes);
+
+#endif // BENCHMARK_H
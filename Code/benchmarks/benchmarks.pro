@@ -0,0 +1,74 @@
+QT       += core gui
+
+TARGET = benchmarks
+TEMPLATE = app
+
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    bench_assetpack.cpp \
+    bench_fleet.cpp \
+    bench_gravity.cpp \
+    bench_lightclusters.cpp \
+    bench_model.cpp \
+    bench_object.cpp \
+    bench_picking.cpp \
+    bench_scene.cpp \
+    bench_solarsystem.cpp \
+    bench_spatialgrid.cpp \
+    bench_stars.cpp \
+    bench_virtualtexture.cpp \
+    ../assetcache.cpp \
+    ../assetpack.cpp \
+    ../bvh.cpp \
+    ../ephemeris.cpp \
+    ../fleet.cpp \
+    ../lightclusters.cpp \
+    ../log.cpp \
+    ../memoryreport.cpp \
+    ../model.cpp \
+    ../navigation.cpp \
+    ../nbody.cpp \
+    ../object.cpp \
+    ../orbitbuffer.cpp \
+    ../scenefile.cpp \
+    ../shadercache.cpp \
+    ../solarsystem.cpp \
+    ../spatialgrid.cpp \
+    ../starfield.cpp \
+    ../threadpool.cpp \
+    ../transformhierarchy.cpp \
+    ../utility.cpp \
+    ../virtualtexture.cpp
+
+HEADERS += \
+    benchmark.h \
+    ../assetcache.h \
+    ../assetpack.h \
+    ../bvh.h \
+    ../ephemeris.h \
+    ../fleet.h \
+    ../lightclusters.h \
+    ../log.h \
+    ../memoryreport.h \
+    ../model.h \
+    ../navigation.h \
+    ../nbody.h \
+    ../object.h \
+    ../orbitbuffer.h \
+    ../scenefile.h \
+    ../shadercache.h \
+    ../solarsystem.h \
+    ../spatialgrid.h \
+    ../starfield.h \
+    ../threadpool.h \
+    ../transformhierarchy.h \
+    ../virtualtexture.h
+
+# The solar system scene and its assets.
+RESOURCES += \
+    ../resources.qrc
@@ -0,0 +1,154 @@
+#include "benchmark.h"
+#include "log.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QTextStream>
+
+namespace {
+
+struct Result {
+    QString name;
+    int size;
+    double ms;
+    double perSecond;   // 0 when the case has no throughput.
+};
+
+QVector<Result> results;
+bool printLines = true;
+
+struct Group {
+    QString name;
+    void (*run)(QVector<int>);
+};
+
+const Group groups[] = {
+    {"spatialgrid", benchSpatialGrid},
+    {"assetpack", benchAssetPack},
+    {"fleet", benchFleet},
+    {"gravity", benchGravity},
+    {"lightclusters", benchLightClusters},
+    {"model", benchModel},
+    {"object", benchObject},
+    {"picking", benchPicking},
+    {"scene", benchScene},
+    {"stars", benchStars},
+    {"solarsystem", benchSolarSystem},
+    {"transforms", benchTransforms},
+    {"virtualtexture", benchVirtualTexture}
+};
+
+QByteArray toJson() {
+    QJsonArray array;
+    for (const Result &r : results) {
+        QJsonObject o;
+        o["name"] = r.name;
+        o["size"] = r.size;
+        o["ms"] = r.ms;
+        if (r.perSecond > 0) o["perSecond"] = r.perSecond;
+        array.append(o);
+    }
+    QJsonObject root;
+    root["results"] = array;
+    return QJsonDocument(root).toJson();
+}
+
+QByteArray toCsv() {
+    QString text;
+    QTextStream out(&text);
+    out << "name,size,ms,perSecond\n";
+    for (const Result &r : results) {
+        out << r.name << "," << r.size << "," << QString::number(r.ms, 'f', 6) << ","
+            << QString::number(r.perSecond, 'g', 8) << "\n";
+    }
+    out.flush();
+    return text.toUtf8();
+}
+
+}
+
+void report(QString name, int size, double ms, double items) {
+    Result r = {name, size, ms, items > 0 ? items / ms * 1.0e3 : 0.0};
+    results.push_back(r);
+    if (!printLines) return;
+
+    QTextStream out(stdout);
+    out << name << "\t" << size << "\t" << QString::number(ms, 'f', 3) << " ms";
+    if (items > 0) {
+        out << "\t" << QString::number(r.perSecond, 'g', 4) << " /s";
+    }
+    out << "\n";
+}
+
+// Usage: benchmarks [options] [size ...], defaults to 10k, 100k and 1M objects.
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    Log::initialize();
+    Log::setLevel(Log::WARNING);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("sizes", "Problem sizes, each benchmark scales its input to them.", "[size ...]");
+    QCommandLineOption filterOption("filter", "Only run the groups whose name contains <text>, comma separated.", "text");
+    parser.addOption(filterOption);
+    QCommandLineOption formatOption("format", "Output as text, json or csv.", "format", "text");
+    parser.addOption(formatOption);
+    QCommandLineOption outputOption("output", "Write the results to <file> instead of stdout.", "file");
+    parser.addOption(outputOption);
+    parser.process(a);
+
+    QVector<int> sizes;
+    for (QString arg : parser.positionalArguments()) {
+        sizes.push_back(arg.toInt());
+    }
+    if (sizes.isEmpty()) {
+        sizes = {10000, 100000, 1000000};
+    }
+
+    QString format = parser.value(formatOption);
+    // Progress lines go to stdout only when they are the output.
+    printLines = format == "text" && !parser.isSet(outputOption);
+
+    QStringList filters = parser.value(filterOption).split(',', QString::SkipEmptyParts);
+    for (const Group &group : groups) {
+        bool selected = filters.isEmpty();
+        for (QString filter : filters) {
+            if (group.name.contains(filter)) selected = true;
+        }
+        if (selected) group.run(sizes);
+    }
+
+    QByteArray output;
+    if (format == "json") {
+        output = toJson();
+    } else if (format == "csv") {
+        output = toCsv();
+    } else if (!printLines) {
+        QString text;
+        QTextStream out(&text);
+        for (const Result &r : results) {
+            out << r.name << "\t" << r.size << "\t" << r.ms << "\t" << r.perSecond << "\n";
+        }
+        out.flush();
+        output = text.toUtf8();
+    }
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            Log::shutdown();
+            return 1;
+        }
+        file.write(output);
+    } else {
+        QTextStream(stdout) << output;
+    }
+
+    Log::shutdown();
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include "bvh.h"
+#include "memoryreport.h"
+
+void BVH::clear() {
+    nodes.clear();
+    order.clear();
+}
+
+/**
+ * @brief BVH::build
+ *
+ * Median splits give a balanced tree in O(n log n) with nth_element, which is
+ * fast enough to build over a million bodies on the first pick.
+ */
+void BVH::build(const QVector<QVector3D> &min, const QVector<QVector3D> &max) {
+    clear();
+    int n = min.size();
+    if (n == 0) return;
+
+    QVector<QVector3D> centers(n);
+    order.resize(n);
+    for (int i = 0; i != n; ++i) {
+        centers[i] = (min[i] + max[i]) * 0.5f;
+        order[i] = i;
+    }
+    nodes.reserve(2 * (n / leafSize + 1));
+    buildNode(0, n, min, max, centers);
+    nodes.squeeze();
+}
+
+int BVH::buildNode(int begin, int end, const QVector<QVector3D> &min, const QVector<QVector3D> &max,
+                   const QVector<QVector3D> &centers) {
+    int index = nodes.size();
+    nodes.push_back(Node());
+
+    QVector3D lo = min[order[begin]], hi = max[order[begin]];
+    QVector3D centerLo = centers[order[begin]], centerHi = centerLo;
+    for (int k = begin + 1; k != end; ++k) {
+        int i = order[k];
+        for (int a = 0; a != 3; ++a) {
+            lo[a] = std::min(lo[a], min[i][a]);
+            hi[a] = std::max(hi[a], max[i][a]);
+            centerLo[a] = std::min(centerLo[a], centers[i][a]);
+            centerHi[a] = std::max(centerHi[a], centers[i][a]);
+        }
+    }
+    nodes[index].min = lo;
+    nodes[index].max = hi;
+
+    if (end - begin <= leafSize) {
+        nodes[index].first = begin;
+        nodes[index].count = end - begin;
+        return index;
+    }
+
+    QVector3D extent = centerHi - centerLo;
+    int axis = extent.x() > extent.y() ? (extent.x() > extent.z() ? 0 : 2) : (extent.y() > extent.z() ? 1 : 2);
+    int middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](int a, int b) {
+        return centers[a][axis] < centers[b][axis];
+    });
+
+    buildNode(begin, middle, min, max, centers);
+    int right = buildNode(middle, end, min, max, centers);
+    nodes[index].first = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+/**
+ * @brief BVH::refit
+ *
+ * Children come after their parent, so one backwards pass sees every child
+ * before its parent. The splits are not revisited: as the bodies move on
+ * their orbits the boxes overlap more, until build() is called again.
+ */
+void BVH::refit(const QVector<QVector3D> &min, const QVector<QVector3D> &max) {
+    for (int index = nodes.size() - 1; index >= 0; --index) {
+        Node &node = nodes[index];
+        if (node.count > 0) {
+            node.min = min[order[node.first]];
+            node.max = max[order[node.first]];
+            for (int k = node.first + 1; k != node.first + node.count; ++k) {
+                int i = order[k];
+                for (int a = 0; a != 3; ++a) {
+                    node.min[a] = std::min(node.min[a], min[i][a]);
+                    node.max[a] = std::max(node.max[a], max[i][a]);
+                }
+            }
+        } else {
+            const Node &left = nodes[index + 1], &right = nodes[node.first];
+            for (int a = 0; a != 3; ++a) {
+                node.min[a] = std::min(left.min[a], right.min[a]);
+                node.max[a] = std::max(left.max[a], right.max[a]);
+            }
+        }
+    }
+}
+
+qint64 BVH::getMemoryUsage() {
+    return MemoryReport::bytes(nodes) + MemoryReport::bytes(order);
+}
+
+// --- Spheres
+
+void SphereBVH::bounds(const QVector<QVector3D> &centers, const QVector<float> &radii,
+                       QVector<QVector3D> &min, QVector<QVector3D> &max) {
+    min.resize(centers.size());
+    max.resize(centers.size());
+    for (int i = 0; i != centers.size(); ++i) {
+        QVector3D r(radii[i], radii[i], radii[i]);
+        min[i] = centers[i] - r;
+        max[i] = centers[i] + r;
+    }
+}
+
+void SphereBVH::gather(const QVector<QVector3D> &centers, const QVector<float> &radii) {
+    const QVector<int> &order = bvh.getOrder();
+    leafCenters.resize(order.size());
+    leafRadii.resize(order.size());
+    for (int k = 0; k != order.size(); ++k) {
+        leafCenters[k] = centers[order[k]];
+        leafRadii[k] = radii[order[k]];
+    }
+}
+
+void SphereBVH::build(const QVector<QVector3D> &centers, const QVector<float> &radii) {
+    QVector<QVector3D> min, max;
+    bounds(centers, radii, min, max);
+    bvh.build(min, max);
+    gather(centers, radii);
+}
+
+void SphereBVH::refit(const QVector<QVector3D> &centers, const QVector<float> &radii) {
+    if (centers.size() != bvh.size()) {
+        build(centers, radii);
+        return;
+    }
+    QVector<QVector3D> min, max;
+    bounds(centers, radii, min, max);
+    bvh.refit(min, max);
+    gather(centers, radii);
+}
+
+qint64 SphereBVH::getMemoryUsage() {
+    return bvh.getMemoryUsage() + MemoryReport::bytes(leafCenters) + MemoryReport::bytes(leafRadii);
+}
+
+// --- Triangles
+
+void TriangleBVH::build(const QVector<QVector3D> &vertices, const QVector<unsigned> &indices) {
+    int n = indices.size() / 3;
+    QVector<QVector3D> min(n), max(n);
+    for (int i = 0; i != n; ++i) {
+        QVector3D a = vertices[indices[3 * i]], b = vertices[indices[3 * i + 1]], c = vertices[indices[3 * i + 2]];
+        for (int k = 0; k != 3; ++k) {
+            min[i][k] = std::min(a[k], std::min(b[k], c[k]));
+            max[i][k] = std::max(a[k], std::max(b[k], c[k]));
+        }
+    }
+    bvh.build(min, max);
+
+    const QVector<int> &order = bvh.getOrder();
+    corners.resize(3 * n);
+    for (int k = 0; k != n; ++k) {
+        for (int c = 0; c != 3; ++c) {
+            corners[3 * k + c] = vertices[indices[3 * order[k] + c]];
+        }
+    }
+}
+
+/**
+ * @brief TriangleBVH::intersect
+ *
+ * Moller-Trumbore per triangle, both faces count: ships are picked from any
+ * side.
+ */
+int TriangleBVH::intersect(QVector3D origin, QVector3D direction, float &distance) {
+    int hit = -1;
+    distance = std::numeric_limits<float>::infinity();
+    const QVector<int> &order = bvh.getOrder();
+    bvh.traverse(origin, direction, distance, [&](int first, int count, float &nearest) {
+        for (int k = first; k != first + count; ++k) {
+            const QVector3D &a = corners[3 * k];
+            QVector3D e1 = corners[3 * k + 1] - a, e2 = corners[3 * k + 2] - a;
+            QVector3D p = QVector3D::crossProduct(direction, e2);
+            float determinant = QVector3D::dotProduct(e1, p);
+            if (std::abs(determinant) < 1.0e-12f) continue;
+            float inverse = 1.0f / determinant;
+            QVector3D s = origin - a;
+            float u = QVector3D::dotProduct(s, p) * inverse;
+            if (u < 0.0f || u > 1.0f) continue;
+            QVector3D q = QVector3D::crossProduct(s, e1);
+            float v = QVector3D::dotProduct(direction, q) * inverse;
+            if (v < 0.0f || u + v > 1.0f) continue;
+            float t = QVector3D::dotProduct(e2, q) * inverse;
+            if (t > 0.0f && t < nearest) {
+                nearest = t;
+                hit = order[k];
+            }
+        }
+    });
+    return hit;
+}
+
+qint64 TriangleBVH::getMemoryUsage() {
+    return bvh.getMemoryUsage() + MemoryReport::bytes(corners);
+}
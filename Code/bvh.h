@@ -0,0 +1,194 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <QVector>
+#include <QVector3D>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * @brief The BVH class
+ *
+ * Bounding volume hierarchy over axis aligned boxes, split at the median of
+ * the longest axis of the box centers. Nodes are stored depth first, so the
+ * left child directly follows its parent. Leaves cover ranges of getOrder(),
+ * the primitives sorted into leaf order, so the users can keep copies of their
+ * primitives in that order and test a leaf as one contiguous batch.
+ */
+class BVH {
+public:
+    struct Node {
+        QVector3D min, max;
+        int first;  // Leaf: first primitive in leaf order. Inner: the right child.
+        int count;  // Primitives in a leaf, 0 for inner nodes.
+    };
+
+    BVH() {}
+
+    void build(const QVector<QVector3D> &min, const QVector<QVector3D> &max);
+    // Moves the boxes of the same primitives, the tree is kept.
+    void refit(const QVector<QVector3D> &min, const QVector<QVector3D> &max);
+    void clear();
+
+    int size() {return order.size();}
+    const QVector<int> &getOrder() {return order;}
+    int getNodeCount() {return nodes.size();}
+    qint64 getMemoryUsage();
+
+    // Calls leaf(first, count, nearest) for every leaf the ray enters closer
+    // than nearest, nearer leaves first. A hit lowers nearest, which prunes the
+    // rest. Returns the number of nodes visited.
+    template <typename Leaf>
+    int traverse(QVector3D origin, QVector3D direction, float &nearest, Leaf leaf) const;
+
+private:
+    static const int leafSize = 4;
+    // Deep enough for any tree of 2^31 primitives split at the median.
+    static const int maxDepth = 64;
+
+    QVector<Node> nodes;
+    QVector<int> order;
+
+    int buildNode(int begin, int end, const QVector<QVector3D> &min, const QVector<QVector3D> &max,
+                  const QVector<QVector3D> &centers);
+
+    // Distance along the ray where it enters the node, infinity for a miss.
+    static float enter(const Node &node, QVector3D origin, QVector3D inverse, float nearest) {
+        float t0 = 0.0f, t1 = nearest;
+        for (int a = 0; a != 3; ++a) {
+            float n = (node.min[a] - origin[a]) * inverse[a];
+            float f = (node.max[a] - origin[a]) * inverse[a];
+            if (n > f) std::swap(n, f);
+            // NaN from 0 * infinity keeps the previous bound.
+            t0 = n > t0 ? n : t0;
+            t1 = f < t1 ? f : t1;
+            if (t0 > t1) return std::numeric_limits<float>::infinity();
+        }
+        return t0;
+    }
+};
+
+template <typename Leaf>
+int BVH::traverse(QVector3D origin, QVector3D direction, float &nearest, Leaf leaf) const {
+    if (nodes.isEmpty()) return 0;
+    QVector3D inverse(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+
+    int stack[maxDepth];
+    int depth = 0;
+    int visited = 0;
+    if (enter(nodes[0], origin, inverse, nearest) < nearest) stack[depth++] = 0;
+    while (depth > 0) {
+        const Node &node = nodes[stack[--depth]];
+        visited++;
+        if (node.count > 0) {
+            leaf(node.first, node.count, nearest);
+            continue;
+        }
+        int left = static_cast<int>(&node - nodes.constData()) + 1, right = node.first;
+        float tLeft = enter(nodes[left], origin, inverse, nearest);
+        float tRight = enter(nodes[right], origin, inverse, nearest);
+        // The nearer child is popped first.
+        if (tLeft > tRight) {
+            std::swap(left, right);
+            std::swap(tLeft, tRight);
+        }
+        if (tRight < nearest) stack[depth++] = right;
+        if (tLeft < nearest) stack[depth++] = left;
+    }
+    return visited;
+}
+
+/**
+ * @brief The SphereBVH class
+ *
+ * Ray queries against many bounding spheres, like the bodies of a scene. The
+ * spheres are copied in leaf order and tested a leaf at a time. A refine
+ * function can replace a sphere hit by an exact one, for bodies that do not
+ * fill their sphere.
+ */
+class SphereBVH {
+public:
+    SphereBVH() {}
+
+    void build(const QVector<QVector3D> &centers, const QVector<float> &radii);
+    // New positions of the same spheres; a different count rebuilds.
+    void refit(const QVector<QVector3D> &centers, const QVector<float> &radii);
+    int size() {return bvh.size();}
+
+    // Nearest sphere the ray enters at a distance above 0, or -1; spheres
+    // around the origin are skipped. refine(item, distance) returns the exact
+    // distance of a hit on the item or a negative value for a miss.
+    template <typename Refine>
+    int intersect(QVector3D origin, QVector3D direction, float &distance, Refine refine);
+    int intersect(QVector3D origin, QVector3D direction, float &distance) {
+        return intersect(origin, direction, distance, [](int, float t) {return t;});
+    }
+    // Nodes visited by the last intersect.
+    int getNodesVisited() {return nodesVisited;}
+    qint64 getMemoryUsage();
+
+private:
+    BVH bvh;
+    QVector<QVector3D> leafCenters;
+    QVector<float> leafRadii;
+    int nodesVisited = 0;
+
+    void bounds(const QVector<QVector3D> &centers, const QVector<float> &radii,
+                QVector<QVector3D> &min, QVector<QVector3D> &max);
+    void gather(const QVector<QVector3D> &centers, const QVector<float> &radii);
+};
+
+template <typename Refine>
+int SphereBVH::intersect(QVector3D origin, QVector3D direction, float &distance, Refine refine) {
+    direction.normalize();
+    int hit = -1;
+    distance = std::numeric_limits<float>::infinity();
+    const QVector<int> &order = bvh.getOrder();
+    nodesVisited = bvh.traverse(origin, direction, distance, [&](int first, int count, float &nearest) {
+        for (int k = first; k != first + count; ++k) {
+            // |o + t d - c|^2 = r^2 with |d| = 1.
+            QVector3D m = origin - leafCenters[k];
+            float b = QVector3D::dotProduct(m, direction);
+            float c = m.lengthSquared() - leafRadii[k] * leafRadii[k];
+            if (c <= 0.0f || b > 0.0f) continue;
+            float discriminant = b * b - c;
+            if (discriminant < 0.0f) continue;
+            float t = -b - std::sqrt(discriminant);
+            if (t >= nearest) continue;
+            t = refine(order[k], t);
+            if (t >= 0.0f && t < nearest) {
+                nearest = t;
+                hit = order[k];
+            }
+        }
+    });
+    return hit;
+}
+
+/**
+ * @brief The TriangleBVH class
+ *
+ * Ray queries against a triangle mesh, in the mesh's own coordinates. The
+ * triangles are copied in leaf order.
+ */
+class TriangleBVH {
+public:
+    TriangleBVH() {}
+
+    void build(const QVector<QVector3D> &vertices, const QVector<unsigned> &indices);
+    int size() {return bvh.size();}
+
+    // Nearest triangle hit at a distance above 0, in units of the length of
+    // direction, or -1.
+    int intersect(QVector3D origin, QVector3D direction, float &distance);
+    qint64 getMemoryUsage();
+
+private:
+    BVH bvh;
+    // Three corners per triangle in leaf order.
+    QVector<QVector3D> corners;
+};
+
+#endif // BVH_H
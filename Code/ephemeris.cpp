@@ -0,0 +1,70 @@
+#include "ephemeris.h"
+
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+// Newton's method converges to double precision in a few steps below this eccentricity.
+static const double maxEccentricity = 0.99;
+
+Orbit::Orbit(const OrbitalElements &e) : elements(e) {
+    elements.eccentricity = qBound(0.0, elements.eccentricity, maxEccentricity);
+    if (elements.period <= 0) elements.period = 1;
+    semiMinorAxis = elements.semiMajorAxis * std::sqrt(1.0 - elements.eccentricity * elements.eccentricity);
+
+    double node = qDegreesToRadians(elements.ascendingNode);
+    double w = qDegreesToRadians(elements.periapsis);
+    double i = qDegreesToRadians(elements.inclination);
+    double cn = std::cos(node), sn = std::sin(node), cw = std::cos(w), sw = std::sin(w);
+    double ci = std::cos(i), si = std::sin(i);
+
+    // Perifocal axes in ecliptic coordinates (x to the equinox, z north)...
+    double px = cn * cw - sn * sw * ci, py = sn * cw + cn * sw * ci, pz = sw * si;
+    double qx = -cn * sw - sn * cw * ci, qy = -sn * sw + cn * cw * ci, qz = cw * si;
+    // ...and in the world, where north is y.
+    p[0] = px; p[1] = pz; p[2] = -py;
+    q[0] = qx; q[1] = qz; q[2] = -qy;
+}
+
+double Orbit::meanAnomaly(double t) const {
+    double turns = t / elements.period;
+    turns -= std::floor(turns);
+    return qDegreesToRadians(elements.meanAnomaly) + 2.0 * M_PI * turns;
+}
+
+double Orbit::solveKepler(double M, double e) {
+    if (e == 0.0) return M;
+    M = std::remainder(M, 2.0 * M_PI);
+    // Starting at pi converges for every M when the orbit is very eccentric.
+    double E = e < 0.8 ? M + e * std::sin(M) : M_PI;
+    for (int i = 0; i != 16; ++i) {
+        double step = (E - e * std::sin(E) - M) / (1.0 - e * std::cos(E));
+        E -= step;
+        if (std::abs(step) < 1.0e-12) break;
+    }
+    return E;
+}
+
+QVector3D Orbit::position(double t) const {
+    double E = solveKepler(meanAnomaly(t), elements.eccentricity);
+    double x = elements.semiMajorAxis * (std::cos(E) - elements.eccentricity);
+    double y = semiMinorAxis * std::sin(E);
+    return QVector3D(static_cast<float>(p[0] * x + q[0] * y),
+                     static_cast<float>(p[1] * x + q[1] * y),
+                     static_cast<float>(p[2] * x + q[2] * y));
+}
+
+QVector3D Orbit::velocity(double t) const {
+    double E = solveKepler(meanAnomaly(t), elements.eccentricity);
+    double rate = 2.0 * M_PI / elements.period / (1.0 - elements.eccentricity * std::cos(E));
+    double x = -elements.semiMajorAxis * std::sin(E) * rate;
+    double y = semiMinorAxis * std::cos(E) * rate;
+    return QVector3D(static_cast<float>(p[0] * x + q[0] * y),
+                     static_cast<float>(p[1] * x + q[1] * y),
+                     static_cast<float>(p[2] * x + q[2] * y));
+}
+
+double Orbit::getParentMu() const {
+    double n = 2.0 * M_PI / elements.period;
+    return elements.semiMajorAxis * elements.semiMajorAxis * elements.semiMajorAxis * n * n;
+}
@@ -0,0 +1,59 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <QVector3D>
+
+/**
+ * Keplerian elements of an orbit around a parent body. Angles are in
+ * degrees; the reference plane is the ecliptic, the world's xz plane, with
+ * ecliptic north up as in StarCatalog.
+ */
+struct OrbitalElements {
+    double semiMajorAxis = 0;
+    double eccentricity = 0;    // 0 is a circle, up to but not including 1.
+    double inclination = 0;     // To the ecliptic.
+    double ascendingNode = 0;   // Longitude of the ascending node.
+    double periapsis = 0;       // Argument of periapsis, from the node.
+    double meanAnomaly = 0;     // At time 0.
+    double period = 1;          // Time of one revolution.
+};
+
+/**
+ * @brief The Orbit class
+ *
+ * Evaluates a body's offset from its parent at any time in closed form, so a
+ * position costs the same at time 10^9 as at time 0 and never drifts. The
+ * time is a double and the phase is reduced to one period before anything is
+ * rounded to float; Kepler's equation is solved with Newton's method.
+ */
+class Orbit {
+public:
+    Orbit() {}
+    explicit Orbit(const OrbitalElements &elements);
+
+    // Offset from the parent and velocity relative to it, at time t.
+    QVector3D position(double t) const;
+    QVector3D velocity(double t) const;
+
+    const OrbitalElements &getElements() const {return elements;}
+    double getSemiMinorAxis() const {return semiMinorAxis;}
+    // World directions towards periapsis and a quarter orbit further, see position().
+    QVector3D getPeriapsisAxis() const {return QVector3D(float(p[0]), float(p[1]), float(p[2]));}
+    QVector3D getQuarterAxis() const {return QVector3D(float(q[0]), float(q[1]), float(q[2]));}
+    // Gravitational parameter of a parent that gives this period, from Kepler's third law.
+    double getParentMu() const;
+
+    // Mean anomaly in radians, from the fraction of the current period.
+    double meanAnomaly(double t) const;
+    // Eccentric anomaly E for mean anomaly M, E - e sin E = M.
+    static double solveKepler(double M, double e);
+
+private:
+    OrbitalElements elements;
+    double semiMinorAxis = 0;
+    // World directions towards periapsis and a quarter orbit further.
+    double p[3] = {0, 0, 0};
+    double q[3] = {0, 0, 0};
+};
+
+#endif // EPHEMERIS_H
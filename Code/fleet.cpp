@@ -0,0 +1,181 @@
+#include "fleet.h"
+#include "memoryreport.h"
+
+#include <algorithm>
+#include <cmath>
+
+static quint32 mix(quint32 h) {
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+void Fleet::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    speed.clear();
+    destination.clear();
+    trips.clear();
+    courses.clear();
+    retargets.clear();
+}
+
+void Fleet::addShips(int n, QVector3D origin, float originRadius, int targets, float minSpeed, float maxSpeed) {
+    int first = size();
+    for (int i = first; i != first + n; ++i) {
+        // Spread the ships over a ring above the origin so they do not all overlap.
+        float a = i * 2.399963f;
+        x.push_back(origin.x() + originRadius * std::cos(a));
+        y.push_back(origin.y() + originRadius);
+        z.push_back(origin.z() + originRadius * std::sin(a));
+
+        float u = (mix(seed ^ (static_cast<quint32>(i) * 0x27D4EB2Du)) & 0xFFFF) / 65536.0f;
+        speed.push_back(minSpeed + u * (maxSpeed - minSpeed));
+        trips.push_back(0);
+        courses.push_back(Trajectory());
+        destination.push_back(pickDestination(i, -1, targets));
+    }
+}
+
+// Stateless hash of (seed, ship, trip), independent of update order.
+int Fleet::pickDestination(int ship, int current, int targets) {
+    quint32 h = mix(seed ^ (static_cast<quint32>(ship) * 0x9E3779B9u) ^ (trips.value(ship) * 0x85EBCA6Bu));
+    int next = static_cast<int>(h % static_cast<quint32>(targets));
+    if (next == current && targets > 1) {
+        next = (next + 1) % targets;
+    }
+    return next;
+}
+
+/**
+ * @brief Fleet::update
+ *
+ * Moves every ship s*speed towards its destination and retargets ships within
+ * arrival distance, the same rule as Spaceship::update and
+ * Spaceship::hasReachedDestination. Retarget events are collected per worker
+ * and merged by ship index afterwards.
+ */
+void Fleet::update(float s, const QVector<QVector3D> &targets, const QVector<float> &targetRadii, ThreadPool *pool) {
+    retargets.clear();
+    if (targets.isEmpty() || speed.isEmpty()) return;
+    beginUpdate(pool);
+
+    int targetCount = targets.size();
+    pool->parallelFor(size(), grain, [&](int begin, int end, int worker) {
+        QVector<Retarget> &events = workerRetargets[worker];
+        for (int i = begin; i != end; ++i) {
+            QVector3D t = targets[destination[i]];
+            float dx = t.x() - x[i], dy = t.y() - y[i], dz = t.z() - z[i];
+            float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+            if (length > 0.0f) {
+                float step = s * speed[i] / length;
+                x[i] += dx * step;
+                y[i] += dy * step;
+                z[i] += dz * step;
+                dx = t.x() - x[i];
+                dy = t.y() - y[i];
+                dz = t.z() - z[i];
+            }
+
+            float reach = shipScale + targetRadii[destination[i]] * 1.5f + 5.0f;
+            if (dx * dx + dy * dy + dz * dz <= reach * reach) {
+                int from = destination[i];
+                trips[i]++;
+                destination[i] = pickDestination(i, from, targetCount);
+                events.push_back({i, from, destination[i]});
+            }
+        }
+    });
+
+    mergeRetargets();
+}
+
+/**
+ * @brief Fleet::navigate
+ *
+ * A ship whose intercept course has ended has arrived and is retargeted, one
+ * whose chase has ended only needs a new course. Courses are planned in the
+ * same parallel pass, so a step that retargets many ships solves them as one
+ * batch spread over the workers.
+ */
+void Fleet::navigate(double t, const QVector<Navigator::Ephemeris> &targets, const QVector<float> &targetRadii,
+                     float timeStep, ThreadPool *pool) {
+    retargets.clear();
+    coursesPlanned = 0;
+    if (targets.isEmpty() || speed.isEmpty()) return;
+    beginUpdate(pool);
+    workerPlanned.fill(0, pool->size());
+
+    int targetCount = targets.size();
+    pool->parallelFor(size(), grain, [&](int begin, int end, int worker) {
+        QVector<Retarget> &events = workerRetargets[worker];
+        for (int i = begin; i != end; ++i) {
+            Trajectory &course = courses[i];
+            if (course.isValid() && t >= course.arrivalTime) {
+                if (course.intercepts) {
+                    int from = destination[i];
+                    trips[i]++;
+                    destination[i] = pickDestination(i, from, targetCount);
+                    events.push_back({i, from, destination[i]});
+                }
+                x[i] = course.arrival.x();
+                y[i] = course.arrival.y();
+                z[i] = course.arrival.z();
+                course = Trajectory();
+            }
+            if (!course.isValid() || t < course.departureTime) {
+                float reach = shipScale + targetRadii[destination[i]] * 1.5f + 5.0f;
+                Navigator::intercept(targets[destination[i]], QVector3D(x[i], y[i], z[i]), t,
+                                     speed[i] / timeStep, reach, course);
+                workerPlanned[worker]++;
+                if (!course.isValid()) continue;
+            }
+
+            QVector3D p = course.position(t);
+            x[i] = p.x();
+            y[i] = p.y();
+            z[i] = p.z();
+        }
+    });
+
+    for (int planned : workerPlanned) {
+        coursesPlanned += planned;
+    }
+    mergeRetargets();
+}
+
+void Fleet::clearCourses() {
+    courses.fill(Trajectory());
+}
+
+void Fleet::beginUpdate(ThreadPool *pool) {
+    workerRetargets.resize(pool->size());
+    for (QVector<Retarget> &events : workerRetargets) {
+        events.clear();
+    }
+}
+
+void Fleet::mergeRetargets() {
+    for (const QVector<Retarget> &events : workerRetargets) {
+        retargets += events;
+    }
+    std::sort(retargets.begin(), retargets.end(), [](const Retarget &a, const Retarget &b) {
+        return a.ship < b.ship;
+    });
+}
+
+qint64 Fleet::getMemoryUsage() {
+    qint64 total = MemoryReport::bytes(x) + MemoryReport::bytes(y) + MemoryReport::bytes(z) +
+                   MemoryReport::bytes(speed) + MemoryReport::bytes(destination) +
+                   MemoryReport::bytes(trips) + MemoryReport::bytes(courses) +
+                   MemoryReport::bytes(retargets) + MemoryReport::bytes(workerPlanned);
+    for (const QVector<Retarget> &r : workerRetargets) {
+        total += MemoryReport::bytes(r);
+    }
+    return total;
+}
@@ -0,0 +1,82 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <QVector>
+#include <QVector3D>
+
+#include "navigation.h"
+#include "threadpool.h"
+
+/**
+ * @brief The Fleet class
+ *
+ * Traffic of many spaceships, kept as plain arrays instead of one Spaceship
+ * object per ship. Steering and arrival are updated in parallel chunks.
+ * Destinations are indices into the target arrays passed to update(), which
+ * SolarSystem fills with the planets.
+ *
+ * Ships that arrive pick their next destination from a hash of the ship and
+ * its trip count, so the outcome does not depend on how chunks were scheduled.
+ *
+ * With navigate() ships follow intercept courses against the targets'
+ * ephemerides instead of steering every step. A course is kept until the ship
+ * arrives or clearCourses() is called, so a step mostly just evaluates it.
+ */
+class Fleet {
+public:
+    struct Retarget {
+        int ship;
+        int from;
+        int to;
+    };
+
+    Fleet() {}
+
+    int size() {return speed.size();}
+    void clear();
+    // Adds ships parked above the given target, heading to a hashed destination.
+    void addShips(int n, QVector3D origin, float originRadius, int targets, float minSpeed, float maxSpeed);
+
+    void update(float s, const QVector<QVector3D> &targets, const QVector<float> &targetRadii, ThreadPool *pool);
+    // Moves the ships along their courses to time t, planning courses where
+    // needed. A ship covers speed world units in timeStep time units.
+    void navigate(double t, const QVector<Navigator::Ephemeris> &targets, const QVector<float> &targetRadii,
+                  float timeStep, ThreadPool *pool);
+    // After a jump in time or when the targets no longer follow their ephemerides.
+    void clearCourses();
+    // Courses planned by the last navigate().
+    int getCoursesPlanned() {return coursesPlanned;}
+
+    QVector3D getLocation(int ship) {return QVector3D(x[ship], y[ship], z[ship]);}
+    int getDestination(int ship) {return destination[ship];}
+    // Arrivals of the last update, ordered by ship.
+    const QVector<Retarget> &getRetargets() {return retargets;}
+
+    void setSeed(quint32 s) {seed = s;}
+    qint64 getMemoryUsage();
+
+private:
+    // Same size as the Spaceship objects.
+    const float shipScale = 2.0f;
+    // Ships per chunk, large enough to amortize scheduling, small enough to balance.
+    const int grain = 2048;
+
+    quint32 seed = 0;
+
+    QVector<float> x, y, z;
+    QVector<float> speed;
+    QVector<int> destination;
+    QVector<quint32> trips;
+    QVector<Trajectory> courses;
+    int coursesPlanned = 0;
+    QVector<int> workerPlanned;
+
+    QVector<Retarget> retargets;
+    QVector<QVector<Retarget>> workerRetargets;
+
+    int pickDestination(int ship, int current, int targets);
+    void beginUpdate(ThreadPool *pool);
+    void mergeRetargets();
+};
+
+#endif // FLEET_H
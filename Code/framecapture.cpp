@@ -0,0 +1,223 @@
+#include "framecapture.h"
+#include "log.h"
+
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <algorithm>
+
+QString FrameCapture::defaultDirectory;
+FrameCapture::Format FrameCapture::defaultFormat = FrameCapture::PNG;
+double FrameCapture::defaultFps = 60.0;
+int FrameCapture::defaultFrameLimit = 0;
+
+// Longest wait for a readback that has not finished when its slot comes around.
+static const GLuint64 fenceTimeout = 1000000000;
+
+FrameCapture::~FrameCapture() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_all();
+    for (std::thread &t : workers) {
+        t.join();
+    }
+    if (!initialized) return;
+    for (Slot &slot : slots) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        glDeleteBuffers(1, &slot.buffer);
+    }
+}
+
+void FrameCapture::initialize() {
+    initializeOpenGLFunctions();
+    for (Slot &slot : slots) {
+        glGenBuffers(1, &slot.buffer);
+    }
+    initialized = true;
+}
+
+void FrameCapture::setDefaults(QString directory, Format format, double fps, int frameLimit) {
+    defaultDirectory = directory;
+    defaultFormat = format;
+    defaultFps = fps;
+    defaultFrameLimit = frameLimit;
+}
+
+bool FrameCapture::startDefault() {
+    if (defaultDirectory.isEmpty()) return false;
+    return start(defaultDirectory, defaultFormat, defaultFps, defaultFrameLimit);
+}
+
+bool FrameCapture::start(QString dir, Format f, double framesPerSecond, int limit) {
+    if (active) stop();
+    if (!QDir().mkpath(dir)) {
+        LOG(Log::RENDER, Log::WARNING) << "Cannot create capture directory" << dir;
+        return false;
+    }
+
+    directory = dir;
+    format = f;
+    fps = framesPerSecond > 0 ? framesPerSecond : 60.0;
+    frameLimit = limit;
+    frames = 0;
+    written = 0;
+    stopping = false;
+
+    // Encoding a PNG takes longer than rendering a frame, leave a core for the simulation.
+    int encoders = std::max(1, std::min(4, static_cast<int>(std::thread::hardware_concurrency()) / 2));
+    for (int i = 0; i != encoders; ++i) {
+        workers.emplace_back(&FrameCapture::encoderLoop, this);
+    }
+    active = true;
+    LOG(Log::RENDER, Log::INFO) << "Capturing to" << dir << "at" << fps << "frames per simulated second";
+    return true;
+}
+
+void FrameCapture::stop() {
+    if (!active) return;
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_all();
+    for (std::thread &t : workers) {
+        t.join();
+    }
+    workers.clear();
+    active = false;
+    LOG(Log::RENDER, Log::INFO) << "Captured" << frames << "frames to" << directory;
+}
+
+/**
+ * @brief FrameCapture::capture
+ *
+ * The slot written now was filled ringSize frames ago, so it is read back
+ * first; the copy into it has finished by then in all but the slowest frames.
+ */
+void FrameCapture::capture(GLuint fbo, int w, int h) {
+    if (!active || isFinished()) return;
+    if (w != width || h != height) resize(w, h);
+
+    Slot &slot = slots[next];
+    if (slot.frame >= 0) readSlot(slot);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frames++;
+
+    next = (next + 1) % ringSize;
+}
+
+void FrameCapture::resize(int w, int h) {
+    flush();
+    width = w;
+    height = h;
+    for (Slot &slot : slots) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, qint64(width) * height * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::readSlot(Slot &slot) {
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, fenceTimeout);
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED) {
+        LOG(Log::RENDER, Log::WARNING) << "Lost captured frame" << slot.frame;
+        slot.frame = -1;
+        return;
+    }
+
+    Frame frame = {slot.frame, width, height, QByteArray()};
+    qint64 size = qint64(width) * height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels) {
+        frame.pixels = QByteArray(static_cast<const char*>(pixels), static_cast<int>(size));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.frame = -1;
+
+    if (!frame.pixels.isEmpty()) enqueue(frame);
+}
+
+// Reads back every frame in flight, oldest first.
+void FrameCapture::flush() {
+    for (int i = 0; i != ringSize; ++i) {
+        Slot &slot = slots[(next + i) % ringSize];
+        if (slot.frame >= 0) readSlot(slot);
+    }
+}
+
+void FrameCapture::enqueue(Frame frame) {
+    std::unique_lock<std::mutex> lock(mutex);
+    dequeued.wait(lock, [this] {return static_cast<int>(queue.size()) < maxQueued;});
+    queue.push_back(std::move(frame));
+    queued.notify_one();
+}
+
+void FrameCapture::encoderLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queued.wait(lock, [this] {return !queue.empty() || stopping;});
+        if (queue.empty()) return;
+
+        Frame frame = std::move(queue.front());
+        queue.pop_front();
+        dequeued.notify_one();
+
+        lock.unlock();
+        write(frame);
+        lock.lock();
+        written++;
+    }
+}
+
+int FrameCapture::getFramesWritten() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return written;
+}
+
+int FrameCapture::getQueueLength() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<int>(queue.size());
+}
+
+/**
+ * @brief FrameCapture::write
+ *
+ * GL rows start at the bottom, both formats are written top row first. Raw
+ * files are plain RGBA bytes with the size in the name.
+ */
+void FrameCapture::write(const Frame &frame) {
+    QString base = QString("%1/frame_%2").arg(directory).arg(frame.index, 6, 10, QChar('0'));
+    const uchar *pixels = reinterpret_cast<const uchar*>(frame.pixels.constData());
+
+    if (format == PNG) {
+        // The alpha channel holds the clear color's 0, ignore it.
+        QImage image(pixels, frame.width, frame.height, frame.width * 4, QImage::Format_RGBX8888);
+        if (!image.mirrored().save(base + ".png")) {
+            LOG(Log::RENDER, Log::WARNING) << "Cannot write" << base + ".png";
+        }
+        return;
+    }
+
+    QFile file(QString("%1_%2x%3.rgba").arg(base).arg(frame.width).arg(frame.height));
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG(Log::RENDER, Log::WARNING) << "Cannot write" << file.fileName();
+        return;
+    }
+    qint64 row = qint64(frame.width) * 4;
+    for (int y = frame.height - 1; y >= 0; --y) {
+        file.write(reinterpret_cast<const char*>(pixels + y * row), row);
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QByteArray>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QString>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The FrameCapture class
+ *
+ * Records the rendered frames as an image sequence without stalling the GPU.
+ * Each frame is read into the next of a ring of pixel buffer objects with an
+ * asynchronous glReadPixels; the buffer is mapped when the ring comes around
+ * again, ringSize - 1 frames later, when the copy has long finished. The
+ * pixels go to a bounded queue that worker threads encode to PNG or raw RGBA
+ * files. When the encoders fall behind the queue blocks the render thread, so
+ * no frame is ever dropped.
+ *
+ * Frames are read from the framebuffer that was rendered to, so capturing
+ * works the same with -platform offscreen. While capturing, the simulation
+ * advances a fixed step per frame (getTimeStep) whatever the real frame time.
+ */
+class FrameCapture : protected QOpenGLFunctions_3_3_Core {
+public:
+    enum Format {
+        PNG = 0, RAW
+    };
+
+    FrameCapture() {}
+    ~FrameCapture();
+
+    // Requires a current context.
+    void initialize();
+
+    bool start(QString directory, Format format, double fps, int frameLimit = 0);
+    // Reads back the frames in flight and waits for the encoders.
+    void stop();
+    bool isActive() {return active;}
+    // Reached the frame limit given to start().
+    bool isFinished() {return frameLimit > 0 && frames >= frameLimit;}
+
+    // Queues the finished frame in framebuffer fbo for readback.
+    void capture(GLuint fbo, int width, int height);
+
+    float getTimeStep() {return static_cast<float>(1.0 / fps);}
+    int getFramesCaptured() {return frames;}
+    int getFramesWritten();
+    int getQueueLength();
+
+    // Started from the command line, --capture and friends.
+    static void setDefaults(QString directory, Format format, double fps, int frameLimit);
+    static QString getDefaultDirectory() {return defaultDirectory;}
+    bool startDefault();
+
+private:
+    struct Frame {
+        int index;
+        int width, height;
+        QByteArray pixels;  // Bottom row first, as read from GL.
+    };
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        int frame = -1;     // -1 when the slot holds nothing.
+    };
+
+    static const int ringSize = 3;
+    static const int maxQueued = 8;
+
+    static QString defaultDirectory;
+    static Format defaultFormat;
+    static double defaultFps;
+    static int defaultFrameLimit;
+
+    bool initialized = false;
+    bool active = false;
+    QString directory;
+    Format format = PNG;
+    double fps = 60.0;
+    int frameLimit = 0;
+    int frames = 0;
+
+    Slot slots[ringSize];
+    int next = 0;
+    int width = 0, height = 0;
+
+    // Encoder queue.
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable queued, dequeued;
+    std::deque<Frame> queue;
+    bool stopping = false;
+    int written = 0;
+
+    void resize(int w, int h);
+    void readSlot(Slot &slot);
+    void flush();
+    void enqueue(Frame frame);
+    void encoderLoop();
+    void write(const Frame &frame);
+};
+
+#endif // FRAMECAPTURE_H
@@ -0,0 +1,122 @@
+#include "framescheduler.h"
+
+#include "log.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <QWindow>
+#include <algorithm>
+#include <cmath>
+
+FrameScheduler::Mode FrameScheduler::defaultMode = FrameScheduler::CONTINUOUS;
+double FrameScheduler::defaultMaxFps = 30.0;
+
+// Gaps longer than this are idle time, not slow frames.
+static const double idleInterval = 500.0;
+
+FrameScheduler::FrameScheduler(QOpenGLWidget *w) : widget(w) {
+    mode = defaultMode;
+    maxFps = defaultMaxFps;
+
+    timer.setSingleShot(true);
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, SIGNAL(timeout()), widget, SLOT(update()));
+    connect(widget, SIGNAL(frameSwapped()), this, SLOT(onFrameSwapped()));
+}
+
+void FrameScheduler::start() {
+    clock.start();
+    nextDeadline = 0;
+    widget->update();
+}
+
+void FrameScheduler::setMode(Mode m) {
+    mode = m;
+    nextDeadline = clock.nsecsElapsed();
+    intervals.clear();
+    nextInterval = 0;
+    LOG(Log::RENDER, Log::INFO) << "Frame scheduling" << modeName(mode);
+    widget->update();
+}
+
+void FrameScheduler::setMaxFps(double fps) {
+    maxFps = std::max(1.0, fps);
+    intervals.clear();
+    nextInterval = 0;
+}
+
+QString FrameScheduler::modeName(Mode m) {
+    switch (m) {
+    case CONTINUOUS: return "continuous";
+    case CAPPED: return "capped";
+    case ON_DEMAND: return "on demand";
+    }
+    return QString();
+}
+
+void FrameScheduler::beginFrame() {
+    qint64 now = clock.nsecsElapsed();
+    if (lastFrame >= 0) {
+        double interval = (now - lastFrame) / 1.0e6;
+        frameTime = static_cast<float>(std::min(interval / 1000.0, 0.1));
+        if (interval < idleInterval) {
+            if (intervals.size() < history) {
+                intervals.push_back(interval);
+            } else {
+                intervals[nextInterval] = interval;
+            }
+            nextInterval = (nextInterval + 1) % history;
+        }
+    }
+    lastFrame = now;
+}
+
+/**
+ * @brief FrameScheduler::onFrameSwapped
+ *
+ * Requests the next frame once the previous one is on its way to the screen.
+ * A capped deadline that already passed restarts from now, so a slow frame
+ * does not cause a burst of catch-up frames.
+ */
+void FrameScheduler::onFrameSwapped() {
+    switch (mode) {
+    case CONTINUOUS:
+        widget->update();
+        break;
+    case CAPPED: {
+        qint64 now = clock.nsecsElapsed();
+        nextDeadline += static_cast<qint64>(1.0e9 / maxFps);
+        if (nextDeadline < now) nextDeadline = now;
+        timer.start(static_cast<int>((nextDeadline - now) / 1000000));
+        break;
+    }
+    case ON_DEMAND:
+        if (animating) widget->update();
+        break;
+    }
+}
+
+double FrameScheduler::targetInterval() {
+    if (mode == CAPPED) return 1000.0 / maxFps;
+    QWindow *window = widget->window()->windowHandle();
+    QScreen *screen = window ? window->screen() : QGuiApplication::primaryScreen();
+    double refresh = screen ? screen->refreshRate() : 60.0;
+    return 1000.0 / (refresh > 0 ? refresh : 60.0);
+}
+
+FrameScheduler::Statistics FrameScheduler::getStatistics() {
+    Statistics s = {intervals.size(), 0, 0, 0, 0, 0};
+    if (intervals.isEmpty()) return s;
+
+    double target = targetInterval();
+    double sum = 0, squares = 0;
+    for (double interval : intervals) {
+        sum += interval;
+        squares += interval * interval;
+        s.worstInterval = std::max(s.worstInterval, interval);
+        if (interval > 1.5 * target) s.late++;
+    }
+    s.meanInterval = sum / s.frames;
+    s.jitter = std::sqrt(std::max(0.0, squares / s.frames - s.meanInterval * s.meanInterval));
+    s.fps = 1000.0 / s.meanInterval;
+    return s;
+}
@@ -0,0 +1,91 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QOpenGLWidget>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+/**
+ * @brief The FrameScheduler class
+ *
+ * Decides when the widget paints next. Frames are chained to the swap of the
+ * previous frame (QOpenGLWidget::frameSwapped) instead of a free running
+ * timer, so they follow the display refresh:
+ *
+ * CONTINUOUS paints again right after every swap, paced by vsync.
+ * CAPPED waits for the next multiple of 1 / maxFps, measured from a fixed
+ *  start so the rate does not drift.
+ * ON_DEMAND only keeps painting while the scene animates; otherwise a frame
+ *  is painted when something calls update() on the widget (input, UI changes).
+ *
+ * It also measures the intervals between frames for pacing statistics.
+ */
+class FrameScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    enum Mode {
+        CONTINUOUS = 0, CAPPED, ON_DEMAND
+    };
+
+    struct Statistics {
+        int frames;             // Intervals measured, at most the last 120.
+        double fps;
+        double meanInterval;    // In milliseconds.
+        double jitter;          // Standard deviation of the interval.
+        double worstInterval;
+        int late;               // Intervals over 1.5 times the target.
+    };
+
+    explicit FrameScheduler(QOpenGLWidget *widget);
+
+    void start();
+
+    void setMode(Mode m);
+    Mode getMode() {return mode;}
+    void setMaxFps(double fps);
+    double getMaxFps() {return maxFps;}
+    static void setDefaultMode(Mode m) {defaultMode = m;}
+    static void setDefaultMaxFps(double fps) {defaultMaxFps = fps;}
+    static QString modeName(Mode m);
+
+    // Called at the start of paintGL.
+    void beginFrame();
+    // Whether the scene still changes on its own, for ON_DEMAND.
+    void setAnimating(bool a) {animating = a;}
+
+    // Seconds since the previous frame, at most 0.1 and 1/60 for the first frame.
+    float getFrameTime() {return frameTime;}
+    Statistics getStatistics();
+
+private slots:
+    void onFrameSwapped();
+
+private:
+    static Mode defaultMode;
+    static double defaultMaxFps;
+    // Intervals kept for the statistics.
+    static const int history = 120;
+
+    QOpenGLWidget *widget;
+    QTimer timer;
+    QElapsedTimer clock;
+
+    Mode mode;
+    double maxFps;
+    bool animating = true;
+
+    qint64 lastFrame = -1;
+    qint64 nextDeadline = 0;
+    float frameTime = 1.0f / 60.0f;
+
+    QVector<double> intervals;
+    int nextInterval = 0;
+
+    double targetInterval();
+};
+
+#endif // FRAMESCHEDULER_H
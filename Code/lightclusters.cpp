@@ -0,0 +1,160 @@
+#include "lightclusters.h"
+#include "memoryreport.h"
+
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+static int clampTile(float ndc, int tiles) {
+    int t = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * tiles));
+    return std::min(std::max(t, 0), tiles - 1);
+}
+
+/**
+ * @brief LightClusters::build
+ *
+ * Bins the lights for the given camera. First every light is moved to view space
+ * and culled against the frustum, which is a plain loop over arrays the compiler
+ * can vectorize. Then each depth slice finds the tiles covered by the lights that
+ * reach into it, using the x/y extent of the light at the near and far end of
+ * the slice; slices are independent and run in parallel.
+ */
+void LightClusters::build(const QVector<PointLight> &lights, const QMatrix4x4 &view,
+                          float fov, float aspect, float nearPlane, float farPlane, ThreadPool *pool) {
+    int n = lights.size();
+    float logRatio = std::log(farPlane / nearPlane);
+    sliceScale = slices / logRatio;
+    sliceBias = -slices * std::log(nearPlane) / logRatio;
+
+    float tanY = std::tan(qDegreesToRadians(fov) * 0.5f), tanX = tanY * aspect;
+    float normX = 1.0f / std::sqrt(1.0f + tanX * tanX), normY = 1.0f / std::sqrt(1.0f + tanY * tanY);
+
+    lightX.resize(n);
+    lightY.resize(n);
+    lightDepth.resize(n);
+    lightRadius.resize(n);
+    firstSlice.resize(n);
+    lastSlice.resize(n);
+
+    const float *m = view.constData();
+    const PointLight *in = lights.constData();
+    float *lx = lightX.data(), *ly = lightY.data(), *ld = lightDepth.data(), *lr = lightRadius.data();
+    int *first = firstSlice.data(), *last = lastSlice.data();
+    float scale = sliceScale, bias = sliceBias;
+
+    pool->parallelFor(n, 1024, [=](int begin, int end, int) {
+        for (int i = begin; i != end; ++i) {
+            QVector3D p = in[i].position;
+            float x = m[0] * p.x() + m[4] * p.y() + m[8] * p.z() + m[12];
+            float y = m[1] * p.x() + m[5] * p.y() + m[9] * p.z() + m[13];
+            float d = -(m[2] * p.x() + m[6] * p.y() + m[10] * p.z() + m[14]);
+            float r = in[i].radius;
+            lx[i] = x;
+            ly[i] = y;
+            ld[i] = d;
+            lr[i] = r;
+
+            // Signed distances to the four side planes, positive is outside.
+            bool outside = d + r < nearPlane || d - r > farPlane ||
+                           (x - d * tanX) * normX > r || (-x - d * tanX) * normX > r ||
+                           (y - d * tanY) * normY > r || (-y - d * tanY) * normY > r;
+
+            float zmin = std::max(d - r, nearPlane), zmax = std::min(d + r, farPlane);
+            int s0 = static_cast<int>(std::floor(std::log(zmin) * scale + bias));
+            int s1 = static_cast<int>(std::floor(std::log(zmax) * scale + bias));
+            first[i] = outside ? 1 : std::min(std::max(s0, 0), slices - 1);
+            last[i] = outside ? 0 : std::min(std::max(s1, 0), slices - 1);
+        }
+    });
+
+    visible.clear();
+    lightData.clear();
+    for (int i = 0; i != n; ++i) {
+        if (firstSlice[i] > lastSlice[i]) continue;
+        visible.push_back(i);
+        const PointLight &light = lights[i];
+        lightData << light.position.x() << light.position.y() << light.position.z() << light.radius
+                  << light.color.x() << light.color.y() << light.color.z() << 0.0f;
+    }
+    visibleLights = visible.size();
+
+    const int tiles = tilesX * tilesY;
+    sliceIndices.resize(slices);
+    sliceCounts.resize(slices);
+
+    pool->parallelFor(slices, 1, [&](int begin, int end, int) {
+        QVector<int> ranges;
+        for (int s = begin; s != end; ++s) {
+            float sliceNear = std::exp((s - sliceBias) / sliceScale);
+            float sliceFar = std::exp((s + 1 - sliceBias) / sliceScale);
+
+            // Tile range of every light in this slice: light, x0, x1, y0, y1.
+            ranges.clear();
+            QVector<quint32> &count = sliceCounts[s];
+            count.fill(0, tiles + 1);
+            for (int v = 0; v != visible.size(); ++v) {
+                int i = visible[v];
+                if (s < firstSlice[i] || s > lastSlice[i]) continue;
+
+                float x = lightX[i], y = lightY[i], d = lightDepth[i], r = lightRadius[i];
+                float da = std::max(d - r, sliceNear), db = std::min(d + r, sliceFar);
+
+                // x / depth is extreme at one of the two ends of the depth range.
+                float xmin = (x - r) / ((x - r) >= 0 ? db : da) / tanX;
+                float xmax = (x + r) / ((x + r) >= 0 ? da : db) / tanX;
+                float ymin = (y - r) / ((y - r) >= 0 ? db : da) / tanY;
+                float ymax = (y + r) / ((y + r) >= 0 ? da : db) / tanY;
+                if (xmin > 1.0f || xmax < -1.0f || ymin > 1.0f || ymax < -1.0f) continue;
+
+                int x0 = clampTile(xmin, tilesX), x1 = clampTile(xmax, tilesX);
+                int y0 = clampTile(ymin, tilesY), y1 = clampTile(ymax, tilesY);
+                ranges << v << x0 << x1 << y0 << y1;
+                for (int ty = y0; ty <= y1; ++ty) {
+                    for (int tx = x0; tx <= x1; ++tx) {
+                        count[ty * tilesX + tx + 1]++;
+                    }
+                }
+            }
+
+            for (int t = 0; t != tiles; ++t) {
+                count[t + 1] += count[t];
+            }
+
+            QVector<quint32> &indices = sliceIndices[s];
+            indices.resize(count[tiles]);
+            QVector<quint32> fill = count;
+            for (int k = 0; k != ranges.size(); k += 5) {
+                for (int ty = ranges[k + 3]; ty <= ranges[k + 4]; ++ty) {
+                    for (int tx = ranges[k + 1]; tx <= ranges[k + 2]; ++tx) {
+                        indices[fill[ty * tilesX + tx]++] = ranges[k];
+                    }
+                }
+            }
+        }
+    });
+
+    // Concatenate the slices, cluster (x, y, s) is at (s * tilesY + y) * tilesX + x.
+    clusterData.resize(2 * tiles * slices);
+    lightIndices.clear();
+    for (int s = 0; s != slices; ++s) {
+        quint32 offset = lightIndices.size();
+        const QVector<quint32> &count = sliceCounts[s];
+        for (int t = 0; t != tiles; ++t) {
+            clusterData[2 * (s * tiles + t)] = offset + count[t];
+            clusterData[2 * (s * tiles + t) + 1] = count[t + 1] - count[t];
+        }
+        lightIndices += sliceIndices[s];
+    }
+}
+
+qint64 LightClusters::getMemoryUsage() {
+    qint64 total = MemoryReport::bytes(lightX) + MemoryReport::bytes(lightY) + MemoryReport::bytes(lightDepth) +
+                   MemoryReport::bytes(lightRadius) + MemoryReport::bytes(firstSlice) +
+                   MemoryReport::bytes(lastSlice) + MemoryReport::bytes(visible) +
+                   MemoryReport::bytes(clusterData) + MemoryReport::bytes(lightIndices) +
+                   MemoryReport::bytes(lightData);
+    for (int s = 0; s != sliceIndices.size(); ++s) {
+        total += MemoryReport::bytes(sliceIndices[s]) + MemoryReport::bytes(sliceCounts[s]);
+    }
+    return total;
+}
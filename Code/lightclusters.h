@@ -0,0 +1,65 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <QMatrix4x4>
+#include <QVector>
+#include <QVector3D>
+
+#include "threadpool.h"
+
+struct PointLight {
+    QVector3D position;
+    float radius;       // Light has no effect beyond this distance.
+    QVector3D color;
+};
+
+/**
+ * @brief The LightClusters class
+ *
+ * Bins point lights into clusters of the view frustum for clustered forward
+ * shading: the screen is split in tiles and the depth range in slices that
+ * grow exponentially with the distance, so the fragment shader only loops over
+ * the lights of its own cluster.
+ *
+ * The binning runs on the CPU once per frame, one depth slice per task. The
+ * results are flat arrays ready for buffer textures: per cluster the offset and
+ * count into lightIndices, and per light two texels of lightData.
+ */
+class LightClusters {
+public:
+    static const int tilesX = 16, tilesY = 9, slices = 24;
+
+    LightClusters() {}
+
+    void build(const QVector<PointLight> &lights, const QMatrix4x4 &view,
+               float fov, float aspect, float nearPlane, float farPlane, ThreadPool *pool);
+
+    // Texels for GL_RG32UI, GL_R32UI and GL_RGBA32F buffer textures.
+    const QVector<quint32> &getClusterData() {return clusterData;}
+    const QVector<quint32> &getLightIndices() {return lightIndices;}
+    const QVector<float> &getLightData() {return lightData;}
+
+    // slice = log(depth) * scale + bias, for the fragment shader.
+    float getSliceScale() {return sliceScale;}
+    float getSliceBias() {return sliceBias;}
+
+    int getVisibleLights() {return visibleLights;}
+    qint64 getMemoryUsage();
+
+private:
+    float sliceScale = 0, sliceBias = 0;
+    int visibleLights = 0;
+
+    // Per visible light, in view space: x, y, depth along the view direction, radius.
+    QVector<float> lightX, lightY, lightDepth, lightRadius;
+    QVector<int> firstSlice, lastSlice;
+    QVector<int> visible;
+
+    QVector<quint32> clusterData;
+    QVector<quint32> lightIndices;
+    QVector<float> lightData;
+    QVector<QVector<quint32>> sliceIndices;
+    QVector<QVector<quint32>> sliceCounts;
+};
+
+#endif // LIGHTCLUSTERS_H
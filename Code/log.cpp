@@ -0,0 +1,247 @@
+#include "log.h"
+
+#include <QStringList>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+
+struct Entry {
+    qint64 time;    // Microseconds since initialize().
+    Log::Category category;
+    Log::Level level;
+    QString text;
+};
+
+// Bounded queue for many producers and one consumer. Each slot carries a
+// sequence number that tells whether it is free for the producer at position
+// pos (sequence == pos) or holds a message for the consumer (pos + 1).
+class RingBuffer {
+public:
+    static const size_t capacity = 4096;
+
+    RingBuffer() {
+        for (size_t i = 0; i != capacity; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(Entry &&entry) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;) {
+            slot = &slots[pos & (capacity - 1)];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        slot->entry = std::move(entry);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(Entry &entry) {
+        Slot &slot = slots[head & (capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) return false;
+        entry = std::move(slot.entry);
+        slot.sequence.store(head + capacity, std::memory_order_release);
+        head++;
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Entry entry;
+    };
+
+    Slot slots[capacity];
+    std::atomic<size_t> tail{0};
+    size_t head = 0;    // Only touched by the writer thread.
+};
+
+RingBuffer buffer;
+std::atomic<int> levels[Log::CATEGORY_COUNT];
+std::atomic<int> rateLimit{50};
+
+// Rate limiting, per category: start of the current one second window in
+// milliseconds, messages admitted and suppressed in it.
+std::atomic<qint64> windowStart[Log::CATEGORY_COUNT];
+std::atomic<int> admitted[Log::CATEGORY_COUNT];
+std::atomic<int> suppressed[Log::CATEGORY_COUNT];
+
+std::atomic<int> dropped{0};
+std::atomic<bool> running{false};
+std::thread writer;
+const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+qint64 now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+}
+
+struct Defaults {
+    Defaults() {
+        for (int c = 0; c != Log::CATEGORY_COUNT; ++c) {
+            levels[c].store(Log::INFO);
+            windowStart[c].store(0);
+            admitted[c].store(0);
+            suppressed[c].store(0);
+        }
+    }
+} defaults;
+
+void print(const Entry &entry) {
+    QByteArray line = QString("%1 %2 %3 %4\n")
+            .arg(entry.time / 1.0e6, 10, 'f', 4)
+            .arg(Log::categoryName(entry.category), -10)
+            .arg(Log::levelName(entry.level), -8)
+            .arg(entry.text).toLocal8Bit();
+    std::fwrite(line.constData(), 1, line.size(), stderr);
+}
+
+// Writes messages in batches, sleeping briefly when there is nothing to do.
+void drain() {
+    Entry entry;
+    for (;;) {
+        bool stopping = !running.load(std::memory_order_acquire);
+        int written = 0;
+        while (buffer.pop(entry)) {
+            print(entry);
+            written++;
+        }
+        int lost = dropped.exchange(0);
+        if (lost > 0) {
+            std::fprintf(stderr, "%d log messages dropped, buffer full\n", lost);
+        }
+        if (written > 0 || lost > 0) std::fflush(stderr);
+        if (stopping) return;
+        if (written == 0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+}
+
+// Registered after writer was constructed, so it runs before writer's
+// destructor, which would terminate on a joinable thread. exit() is called
+// by QCommandLineParser::process on --help and unknown options.
+void Log::initialize() {
+    if (running.exchange(true)) return;
+    writer = std::thread(drain);
+    static bool registered = false;
+    if (!registered) {
+        std::atexit(Log::shutdown);
+        registered = true;
+    }
+}
+
+void Log::shutdown() {
+    if (!running.exchange(false)) return;
+    writer.join();
+}
+
+void Log::setLevel(Category c, Level l) {
+    levels[c].store(l, std::memory_order_relaxed);
+}
+
+void Log::setLevel(Level l) {
+    for (int c = 0; c != CATEGORY_COUNT; ++c) {
+        setLevel(static_cast<Category>(c), l);
+    }
+}
+
+bool Log::configure(QString spec) {
+    for (QString item : spec.split(',', QString::SkipEmptyParts)) {
+        QStringList parts = item.trimmed().toLower().split('=');
+        int level = -1, category = -1;
+        for (int l = TRACE; l <= OFF; ++l) {
+            if (levelName(static_cast<Level>(l)) == parts.last()) level = l;
+        }
+        if (parts.size() == 2) {
+            for (int c = 0; c != CATEGORY_COUNT; ++c) {
+                if (categoryName(static_cast<Category>(c)) == parts.first()) category = c;
+            }
+            if (category < 0) return false;
+        }
+        if (level < 0 || parts.size() > 2) return false;
+
+        if (category < 0) {
+            setLevel(static_cast<Level>(level));
+        } else {
+            setLevel(static_cast<Category>(category), static_cast<Level>(level));
+        }
+    }
+    return true;
+}
+
+void Log::setRateLimit(int perSecond) {
+    rateLimit.store(perSecond, std::memory_order_relaxed);
+}
+
+bool Log::isEnabled(Category c, Level l) {
+    return l >= levels[c].load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Log::admit
+ *
+ * The first caller after a window ends starts the next one and reports how
+ * many messages the last window suppressed.
+ */
+bool Log::admit(Category c) {
+    qint64 ms = now() / 1000;
+    qint64 window = windowStart[c].load(std::memory_order_relaxed);
+    if (ms - window >= 1000 && windowStart[c].compare_exchange_strong(window, ms)) {
+        admitted[c].store(0, std::memory_order_relaxed);
+        int count = suppressed[c].exchange(0);
+        if (count > 0) {
+            write(c, WARNING, QString("%1 messages suppressed by the rate limit").arg(count));
+        }
+    }
+    if (admitted[c].fetch_add(1, std::memory_order_relaxed) < rateLimit.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    suppressed[c].fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Log::write(Category c, Level l, QString text) {
+    Entry entry = {now(), c, l, text};
+    if (!buffer.push(std::move(entry))) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+QString Log::categoryName(Category c) {
+    switch (c) {
+    case GENERAL: return "general";
+    case GL: return "gl";
+    case INPUT: return "input";
+    case SIMULATION: return "simulation";
+    case RENDER: return "render";
+    case ASSETS: return "assets";
+    case CATEGORY_COUNT: break;
+    }
+    return QString();
+}
+
+QString Log::levelName(Level l) {
+    switch (l) {
+    case TRACE: return "trace";
+    case DEBUG: return "debug";
+    case INFO: return "info";
+    case WARNING: return "warning";
+    case CRITICAL: return "critical";
+    case OFF: return "off";
+    }
+    return QString();
+}
@@ -0,0 +1,75 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <QDebug>
+#include <QString>
+
+// Messages below this level are compiled out, see OpenGL_3.pro.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+/**
+ * @brief The Log class
+ *
+ * Categorized logging that stays off the calling thread. A message that passes
+ * the level of its category and the rate limit is formatted with QDebug and
+ * pushed into a lock-free ring buffer; a background thread writes the buffer
+ * to stderr. When the buffer is full the message is dropped, logging never
+ * blocks. Levels below LOG_MIN_LEVEL cost nothing, higher disabled levels cost
+ * one atomic load.
+ *
+ * Use the LOG macro like qDebug():
+ *     LOG(Log::INPUT, Log::DEBUG) << "Mouse wheel:" << ev->delta();
+ */
+class Log {
+public:
+    enum Category {
+        GENERAL = 0, GL, INPUT, SIMULATION, RENDER, ASSETS, CATEGORY_COUNT
+    };
+
+    enum Level {
+        TRACE = 0, DEBUG, INFO, WARNING, CRITICAL, OFF
+    };
+
+    // Starts and stops the writer thread, shutdown writes what is left. It
+    // also runs at exit, so exit() without shutdown does not abort.
+    static void initialize();
+    static void shutdown();
+
+    static void setLevel(Category c, Level l);
+    static void setLevel(Level l);
+    // "info" sets all categories, "input=debug,gl=warning" sets some.
+    static bool configure(QString spec);
+
+    // Messages per category per second, the rest is counted and reported.
+    static void setRateLimit(int perSecond);
+
+    static bool isEnabled(Category c, Level l);
+    // Counts the message against the rate limit of its category.
+    static bool admit(Category c);
+    static void write(Category c, Level l, QString text);
+
+    static QString categoryName(Category c);
+    static QString levelName(Level l);
+};
+
+class LogMessage {
+public:
+    LogMessage(Log::Category c, Log::Level l) : category(c), level(l) {}
+    ~LogMessage() {Log::write(category, level, text);}
+
+    // The returned QDebug is destroyed first and leaves its output in text.
+    QDebug stream() {return QDebug(&text);}
+
+private:
+    Log::Category category;
+    Log::Level level;
+    QString text;
+};
+
+#define LOG(category, level) \
+    if ((level) < LOG_MIN_LEVEL || !Log::isEnabled(category, level) || !Log::admit(category)) {} \
+    else LogMessage(category, level).stream()
+
+#endif // LOG_H
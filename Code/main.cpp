@@ -1,25 +1,291 @@
+#include "assetpack.h"
+#include "framecapture.h"
+#include "framescheduler.h"
+#include "log.h"
+#include "mainview.h"
 #include "mainwindow.h"
+#include "orbitbuffer.h"
+#include "replay.h"
+#include "resolutionscaler.h"
+#include "scenefile.h"
+#include "shadinggovernor.h"
+#include "shadowmap.h"
+#include "solarsystem.h"
+#include "starfield.h"
+#include "virtualtexture.h"
+#include "virtualtexturecache.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
 #include <QSurfaceFormat>
 #include <ctime>
 
+// Reads a whole scene and writes it in binary form.
+static bool compileScene(QString in, QString out) {
+    SceneReader reader;
+    QVector<SceneBody> bodies;
+    if (reader.open(in)) {
+        while (reader.read(65536, bodies) > 0) {}
+    }
+    if (reader.hasError()) {
+        LOG(Log::ASSETS, Log::CRITICAL) << "Cannot read scene:" << reader.errorString();
+        return false;
+    }
+    QString error;
+    if (!SceneWriter::writeBinary(out, bodies, &error)) {
+        LOG(Log::ASSETS, Log::CRITICAL) << "Cannot write" << out << ":" << error;
+        return false;
+    }
+    LOG(Log::ASSETS, Log::INFO) << "Compiled" << bodies.size() << "bodies to" << out;
+    return true;
+}
+
+// Converts a star catalog to binary form, without input the generated sky.
+static bool compileStars(QString in, QString out) {
+    StarCatalog catalog;
+    if (in.isEmpty()) {
+        catalog.generate(100000, 1);
+    } else if (!catalog.open(in)) {
+        LOG(Log::ASSETS, Log::CRITICAL) << "Cannot read stars:" << catalog.errorString();
+        return false;
+    }
+    QString error;
+    if (!StarCatalog::writeBinary(out, catalog.stars(), catalog.size(), &error)) {
+        LOG(Log::ASSETS, Log::CRITICAL) << "Cannot write" << out << ":" << error;
+        return false;
+    }
+    LOG(Log::ASSETS, Log::INFO) << "Compiled" << catalog.size() << "stars to" << out;
+    return true;
+}
+
+// Splits an image into the pages of a virtual texture.
+static bool compileTexture(QString in, QString out) {
+    QString error;
+    if (in.isEmpty() || out.isEmpty() || !VirtualTextureFile::build(in, out, 128, &error)) {
+        LOG(Log::ASSETS, Log::CRITICAL) << "Cannot compile texture:" << (error.isEmpty() ? "expected <image>,<out>" : error);
+        return false;
+    }
+    VirtualTextureFile file;
+    file.open(out);
+    LOG(Log::ASSETS, Log::INFO) << "Compiled" << in << "to" << file.getPageCount() << "pages in" << file.getLevels()
+                                << "levels," << file.getStoredBytes() / 1048576.0 << "MB";
+    return true;
+}
+
+// Packs the files of a resource collection for --assets.
+static bool compilePack(QString in, QString out) {
+    QString error;
+    if (in.isEmpty() || out.isEmpty() || !AssetPack::build(in, out, &error)) {
+        LOG(Log::ASSETS, Log::CRITICAL) << "Cannot compile pack:" << (error.isEmpty() ? "expected <qrc>,<out>" : error);
+        return false;
+    }
+    AssetPack pack;
+    pack.open(out);
+    LOG(Log::ASSETS, Log::INFO) << "Packed" << pack.size() << "assets in" << pack.getFileBytes() / 1048576.0 << "MB to" << out;
+    return true;
+}
+
 int main(int argc, char *argv[]) {
-    std::srand(std::time(nullptr));
+    Log::initialize();
     QApplication a(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption fleetOption("fleet", "Simulate <ships> additional spaceships as traffic.", "ships", "0");
+    parser.addOption(fleetOption);
+    QCommandLineOption gravityOption("gravity", "Start with simulated gravity instead of analytic orbits (toggle with G).");
+    parser.addOption(gravityOption);
+    QCommandLineOption gpuOrbitsOption("gpu-orbits", "Place the planets on their orbits in the vertex shader (toggle with K).");
+    parser.addOption(gpuOrbitsOption);
+    QCommandLineOption framesOption("frames", "Frame scheduling: continuous, capped or on-demand (cycle with F).",
+                                    "mode", "continuous");
+    parser.addOption(framesOption);
+    QCommandLineOption fpsOption("fps", "Frame rate limit in capped mode.", "fps", "30");
+    parser.addOption(fpsOption);
+    QCommandLineOption logOption("log", "Log levels, e.g. \"debug\" or \"input=debug,gl=warning\".", "levels", "info");
+    parser.addOption(logOption);
+    QCommandLineOption glDebugOption("gl-debug", "Create a GL debug context and log its messages synchronously.");
+    parser.addOption(glDebugOption);
+    QCommandLineOption sceneOption("scene", "Load the bodies from a text or binary scene file.", "file",
+                                   ":/scenes/solarsystem.scene");
+    parser.addOption(sceneOption);
+    QCommandLineOption compileOption("compile-scene", "Write the scene in binary form to <out> and exit.", "out");
+    parser.addOption(compileOption);
+    QCommandLineOption starsOption("stars", "Draw the sky from a binary star catalog or a CSV file of ra,dec,magnitude,b-v.",
+                                   "file");
+    parser.addOption(starsOption);
+    QCommandLineOption compileStarsOption("compile-stars", "Write the star catalog in binary form to <out> and exit.",
+                                          "out");
+    parser.addOption(compileStarsOption);
+    QCommandLineOption compileTextureOption("compile-texture", "Split <image> into the pages of a virtual texture <out>.vt "
+                                            "for a scene, and exit.", "image,out");
+    parser.addOption(compileTextureOption);
+    QCommandLineOption assetsOption("assets", "Read the \":/\" assets from a pack before the compiled-in resources, "
+                                    "by default assets.pack next to the executable.", "file");
+    parser.addOption(assetsOption);
+    QCommandLineOption compilePackOption("compile-pack", "Pack the files listed in <qrc> into <out> for --assets, and exit.",
+                                         "qrc,out");
+    parser.addOption(compilePackOption);
+    QCommandLineOption textureCacheOption("texture-cache", "Video memory for the pages of virtual textures.", "MB", "64");
+    parser.addOption(textureCacheOption);
+    QCommandLineOption captureOption("capture", "Record the frames to <dir> from the start (toggle with C).", "dir");
+    parser.addOption(captureOption);
+    QCommandLineOption captureFormatOption("capture-format", "Captured frames as png or raw RGBA.", "format", "png");
+    parser.addOption(captureFormatOption);
+    QCommandLineOption captureFpsOption("capture-fps", "Frames per simulated second while capturing.", "fps", "60");
+    parser.addOption(captureFpsOption);
+    QCommandLineOption captureFramesOption("capture-frames", "Quit after capturing <n> frames, e.g. with -platform offscreen.",
+                                           "n", "0");
+    parser.addOption(captureFramesOption);
+    QCommandLineOption shadingOption("shading", "Shading: phong, gouraud, normal or auto to choose per object.",
+                                     "mode", "phong");
+    parser.addOption(shadingOption);
+    QCommandLineOption gouraudRadiusOption("gouraud-radius", "Automatic shading lights bodies smaller than this "
+                                           "per vertex, until the frame budget moves it.", "pixels", "24");
+    parser.addOption(gouraudRadiusOption);
+    QCommandLineOption shadowIntervalOption("shadow-interval", "Render each face of the sun's shadow map at most every "
+                                            "<frames>, one value or six for +X,-X,+Y,-Y,+Z,-Z.", "frames", "1");
+    parser.addOption(shadowIntervalOption);
+    QCommandLineOption viewsOption("views", "View layout: single, pip or quad (cycle with V).", "layout", "single");
+    parser.addOption(viewsOption);
+    QCommandLineOption resolutionOption("resolution", "Render scale, or auto to follow the frame budget (toggle with R, step with +/-).",
+                                        "scale", "auto");
+    parser.addOption(resolutionOption);
+    QCommandLineOption resolutionBoundsOption("resolution-bounds", "Lowest and highest automatic render scale.",
+                                              "min,max", "0.5,1");
+    parser.addOption(resolutionBoundsOption);
+    QCommandLineOption budgetOption("frame-budget", "Frame time the automatic render scale aims for.", "ms", "16.7");
+    parser.addOption(budgetOption);
+    QCommandLineOption upscaleOption("upscale", "Upscaling filter: bilinear or sharpen.", "filter", "sharpen");
+    parser.addOption(upscaleOption);
+    QCommandLineOption seedOption("seed", "Seed of the random ship destinations, the time by default.", "n");
+    parser.addOption(seedOption);
+    QCommandLineOption timeOption("time", "Simulation time to start at (jump with [ and ]).", "t", "0");
+    parser.addOption(timeOption);
+    QCommandLineOption recordOption("record", "Record the seed, time steps and input to <file> for --replay.", "file");
+    parser.addOption(recordOption);
+    QCommandLineOption replayOption("replay", "Play a recording frame by frame and quit at its end.", "file");
+    parser.addOption(replayOption);
+    QCommandLineOption timingsOption("timings", "Write the time of every frame to a CSV file.", "file");
+    parser.addOption(timingsOption);
+    parser.process(a);
+
+    if (!Log::configure(parser.value(logOption))) {
+        LOG(Log::GENERAL, Log::WARNING) << "Invalid log levels" << parser.value(logOption);
+    }
+
+    if (parser.isSet(compilePackOption)) {
+        QStringList files = parser.value(compilePackOption).split(',');
+        int result = compilePack(files.value(0), files.value(1)) ? 0 : 1;
+        Log::shutdown();
+        return result;
+    }
+    // Mounted before anything is read, the compile options below read assets too.
+    QString pack = parser.isSet(assetsOption) ? parser.value(assetsOption)
+                                              : QDir(QCoreApplication::applicationDirPath()).filePath("assets.pack");
+    if (parser.isSet(assetsOption) || QFile::exists(pack)) {
+        AssetPack::mount(pack);
+    }
+
+    if (parser.isSet(compileOption)) {
+        int result = compileScene(parser.value(sceneOption), parser.value(compileOption)) ? 0 : 1;
+        Log::shutdown();
+        return result;
+    }
+    if (parser.isSet(compileStarsOption)) {
+        int result = compileStars(parser.value(starsOption), parser.value(compileStarsOption)) ? 0 : 1;
+        Log::shutdown();
+        return result;
+    }
+    if (parser.isSet(compileTextureOption)) {
+        QStringList files = parser.value(compileTextureOption).split(',');
+        int result = compileTexture(files.value(0), files.value(1)) ? 0 : 1;
+        Log::shutdown();
+        return result;
+    }
+
+    // A replay needs the random numbers of its recording, so it sets the seed.
+    quint32 seed = parser.isSet(seedOption) ? parser.value(seedOption).toUInt() : static_cast<quint32>(std::time(nullptr));
+    if (parser.isSet(replayOption)) {
+        QString error;
+        if (!Replay::readSeed(parser.value(replayOption), seed, &error)) {
+            LOG(Log::GENERAL, Log::CRITICAL) << error;
+            Log::shutdown();
+            return 1;
+        }
+    }
+    std::srand(seed);
+    qsrand(seed);
+    Replay::setDefaults(parser.value(recordOption), parser.value(replayOption), parser.value(timingsOption), seed);
+
+    MainView::setDefaultTime(parser.value(timeOption).toDouble());
+    StarField::setDefaultCatalog(parser.value(starsOption));
+    VirtualTextureCache::setDefaultCacheSize(parser.value(textureCacheOption).toInt());
+    FrameCapture::setDefaults(parser.value(captureOption),
+                              parser.value(captureFormatOption) == "raw" ? FrameCapture::RAW : FrameCapture::PNG,
+                              parser.value(captureFpsOption).toDouble(), parser.value(captureFramesOption).toInt());
+
+    SolarSystem::setDefaultScene(parser.value(sceneOption));
+    SolarSystem::setDefaultFleetSize(parser.value(fleetOption).toInt());
+    if (parser.isSet(gravityOption)) {
+        SolarSystem::setDefaultSimulationMode(SolarSystem::GRAVITY);
+    }
+    OrbitBuffer::setDefaultEnabled(parser.isSet(gpuOrbitsOption));
+    QString frames = parser.value(framesOption);
+    if (frames == "capped") {
+        FrameScheduler::setDefaultMode(FrameScheduler::CAPPED);
+    } else if (frames == "on-demand") {
+        FrameScheduler::setDefaultMode(FrameScheduler::ON_DEMAND);
+    }
+    FrameScheduler::setDefaultMaxFps(parser.value(fpsOption).toDouble());
+    QString views = parser.value(viewsOption);
+    if (views == "pip") {
+        MainView::setDefaultLayout(MainView::PICTURE_IN_PICTURE);
+    } else if (views == "quad") {
+        MainView::setDefaultLayout(MainView::QUAD);
+    }
+    QString shading = parser.value(shadingOption);
+    if (shading == "gouraud") {
+        MainView::setDefaultShadingMode(MainView::GOURAUD);
+    } else if (shading == "normal") {
+        MainView::setDefaultShadingMode(MainView::NORMAL);
+    } else if (shading == "auto") {
+        MainView::setDefaultShadingMode(MainView::AUTOMATIC);
+    }
+    ShadingGovernor::setDefaultRadius(parser.value(gouraudRadiusOption).toFloat());
+    QStringList intervals = parser.value(shadowIntervalOption).split(',');
+    for (int face = 0; face != 6; ++face) {
+        ShadowCubeMap::setDefaultUpdateInterval(face, intervals.value(intervals.size() == 1 ? 0 : face, "1").toInt());
+    }
+    QStringList bounds = parser.value(resolutionBoundsOption).split(',');
+    ResolutionScaler::setDefaults(parser.value(resolutionOption) == "auto" ? 0.0f : parser.value(resolutionOption).toFloat(),
+                                  bounds.value(0, "0.5").toFloat(), bounds.value(1, "1").toFloat(),
+                                  parser.value(budgetOption).toFloat(),
+                                  parser.value(upscaleOption) == "bilinear" ? ResolutionScaler::BILINEAR : ResolutionScaler::SHARPEN);
+
     // Request OpenGL 3.3 Core
     QSurfaceFormat glFormat;
     glFormat.setProfile(QSurfaceFormat::CoreProfile);
     glFormat.setVersion(3, 3);
-    glFormat.setOption(QSurfaceFormat::DebugContext);
+    if (parser.isSet(glDebugOption)) {
+        glFormat.setOption(QSurfaceFormat::DebugContext);
+    }
+    // Frames are paced by the display, see FrameScheduler.
+    glFormat.setSwapInterval(1);
 
     // Some platforms need to explicitly set the depth buffer size (24 bits)
     glFormat.setDepthBufferSize(24);
 
     QSurfaceFormat::setDefaultFormat(glFormat);
 
-    MainWindow w;
-    w.show();
+    int result;
+    {
+        MainWindow w;
+        w.show();
+        result = a.exec();
+    }
 
-    return a.exec();
+    // The window logs while closing, write that before exiting.
+    Log::shutdown();
+    return result;
 }
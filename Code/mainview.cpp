@@ -1,7 +1,17 @@
 #include "mainview.h"
+#include "assetcache.h"
+#include "assetpack.h"
+#include "log.h"
 #include "model.h"
 #include "object.h"
 
+#include <QCoreApplication>
+#include <QHash>
+
+MainView::Layout MainView::defaultLayout = MainView::SINGLE;
+MainView::ShadingMode MainView::defaultShader = MainView::PHONG;
+double MainView::defaultTime = 0.0;
+
 /**
  * @brief MainView::MainView
  *
@@ -9,10 +19,12 @@
  *
  * @param parent
  */
-MainView::MainView(QWidget *parent) : QOpenGLWidget(parent)/*, cat(":/models/cat.obj")*/ {
-    qDebug() << "MainView constructor";
-
-    connect(&timer, SIGNAL(timeout()), this, SLOT(update()));
+MainView::MainView(QWidget *parent) : QOpenGLWidget(parent), scheduler(this)/*, cat(":/models/cat.obj")*/ {
+    LOG(Log::GENERAL, Log::DEBUG) << "MainView constructor";
+    setLayout(defaultLayout);
+    time = defaultTime;
+    currentShader = defaultShader;
+    solarSystem.setTimeStep(timeStep);
 }
 
 /**
@@ -24,16 +36,28 @@ MainView::MainView(QWidget *parent) : QOpenGLWidget(parent)/*, cat(":/models/cat
  *
  */
 MainView::~MainView() {
-    qDebug() << "MainView destructor";
+    LOG(Log::GENERAL, Log::DEBUG) << "MainView destructor";
 
     makeCurrent();
+
+    capture.stop();
+    replay.stop();
+    AssetCache::instance()->releaseGpu();
 }
 
 // --- OpenGL initialization
 
 void MainView::loadObjects() {
-    for (Object *o : solarSystem.objects) {
+    // Objects sharing a page file share its virtual texture.
+    QHash<QString, int> opened;
+    virtualTextureOf.fill(-1, solarSystem.objects.size());
+    for (int i = 0; i != solarSystem.objects.size(); ++i) {
+        Object *o = solarSystem.objects[i];
         o->load();
+        if (!o->hasVirtualTexture()) continue;
+        QString file = o->getTextureFile();
+        if (!opened.contains(file)) opened.insert(file, virtualTextures.open(file));
+        virtualTextureOf[i] = opened.value(file);
     }
 }
 
@@ -44,19 +68,23 @@ void MainView::loadObjects() {
  * Attaches a debugger and calls other init functions
  */
 void MainView::initializeGL() {
-    qDebug() << ":: Initializing OpenGL";
+    LOG(Log::GL, Log::INFO) << ":: Initializing OpenGL";
     initializeOpenGLFunctions();
 
-    connect(&debugLogger, SIGNAL(messageLogged(QOpenGLDebugMessage)),
-             this, SLOT(onMessageLogged(QOpenGLDebugMessage)), Qt::DirectConnection);
+    // Only a debug context (--gl-debug) reports GL messages, synchronously so
+    // they arrive right after the call that caused them.
+    if (format().testOption(QSurfaceFormat::DebugContext)) {
+        connect(&debugLogger, SIGNAL(messageLogged(QOpenGLDebugMessage)),
+                 this, SLOT(onMessageLogged(QOpenGLDebugMessage)), Qt::DirectConnection);
 
-    if (debugLogger.initialize()) {
-        qDebug() << ":: Logging initialized";
-        debugLogger.startLogging(QOpenGLDebugLogger::SynchronousLogging);
+        if (debugLogger.initialize()) {
+            LOG(Log::GL, Log::INFO) << ":: Logging initialized";
+            debugLogger.startLogging(QOpenGLDebugLogger::SynchronousLogging);
+        }
     }
 
     QString glVersion = reinterpret_cast<const char*>(glGetString(GL_VERSION));
-    qDebug() << ":: Using OpenGL" << qPrintable(glVersion);
+    LOG(Log::GL, Log::INFO) << ":: Using OpenGL" << qPrintable(glVersion);
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
@@ -64,44 +92,115 @@ void MainView::initializeGL() {
     glClearColor(0.0F, 0.0F, 0.0F, 0.0F);
 
     fillComboBoxes(&solarSystem);
+    shaderCache.initialize();
     createShaderProgram();
     loadObjects ();
-
-    // Initialize transformations.
-    updateModelTransforms();
-    updateViewTransform();
-    updateProjectionTransform();
-
-    timer.start(1000.0 / 60.0);
+    orbits.initialize();
+    governor.initialize();
+    starField.loadDefaultCatalog();
+    capture.initialize();
+    capture.startDefault();
+    replay.startDefault();
+    emit playingChanged(replay.isPlaying());
+
+    // Transforms are computed per view when painting, model transforms come
+    // from the solar system.
+    scheduler.start();
 }
 
 void MainView::fillComboBoxes (SolarSystem *ss) {
-    for (Object *o : ss->objects) {
-        comboBox_lookingFrom->addItem(o->getName());
-        comboBox_lookingAt->addItem(o->getName());
+    // Catalog bodies are unlisted, the item data is the index in objects.
+    for (int i = 0; i != ss->objects.size(); ++i) {
+        if (!ss->isListed(i)) continue;
+        comboBox_lookingFrom->addItem(ss->objects[i]->getName(), i);
+        comboBox_lookingAt->addItem(ss->objects[i]->getName(), i);
     }
     comboBox_lookingFrom->setCurrentIndex(0);
-    comboBox_lookingAt->setCurrentIndex(2);
+    comboBox_lookingAt->setCurrentIndex(qMax(0, comboBox_lookingAt->findData(ss->objects.indexOf(ss->getSun()))));
+    chooseViewTargets();
+}
+
+/**
+ * @brief MainView::chooseViewTargets
+ *
+ * The first view starts as the combo boxes, the others at bodies of the
+ * default scene; a scene without them falls back to the first body looking at
+ * the sun.
+ */
+void MainView::chooseViewTargets() {
+    static const char *targets[maxViews][2] = {
+        {nullptr, nullptr}, {"Earth", "Moon Earth"}, {"Apollo 13", "Earth"}, {"Eye 2", "Sun"}
+    };
+    int sun = solarSystem.objects.indexOf(solarSystem.getSun());
+    views[0].setLookingFrom(comboBox_lookingFrom->currentData().toInt());
+    views[0].setLookingAt(comboBox_lookingAt->currentData().toInt());
+    for (int v = 1; v != maxViews; ++v) {
+        int from = solarSystem.objects.indexOf(solarSystem.findObject(targets[v][0]));
+        int at = solarSystem.objects.indexOf(solarSystem.findObject(targets[v][1]));
+        views[v].setLookingFrom(qMax(0, from));
+        views[v].setLookingAt(at >= 0 ? at : sun);
+    }
 }
 
 void MainView::createShaderProgram() {
-    // Create Phong shader program.
-    phongShaderProgram.addShaderFromSourceFile(QOpenGLShader::Vertex,
-                                           ":/shaders/vertshader_phong.glsl");
-    phongShaderProgram.addShaderFromSourceFile(QOpenGLShader::Fragment,
-                                           ":/shaders/fragshader_phong.glsl");
-    phongShaderProgram.link();
-
-    // Get the uniforms for the Phong shader program.
-    uniformModelTransformPhong       = phongShaderProgram.uniformLocation("modelTransform");
-    uniformViewTransformPhong        = phongShaderProgram.uniformLocation("viewTransform");
-    uniformProjectionTransformPhong  = phongShaderProgram.uniformLocation("projectionTransform");
-    uniformNormalTransformPhong      = phongShaderProgram.uniformLocation("normalTransform");
-    uniformMaterialPhong             = phongShaderProgram.uniformLocation("material");
-    uniformLightPositionPhong        = phongShaderProgram.uniformLocation("lightPosition");
-    uniformLightColorPhong           = phongShaderProgram.uniformLocation("lightColor");
-    uniformTextureSamplerPhong       = phongShaderProgram.uniformLocation("textureSampler");
-    uniformCameraPosition            = phongShaderProgram.uniformLocation("cameraPosition");
+    // The cluster grid of LightClusters is compiled into the Phong and Gouraud shaders.
+    QStringList clusterDefines = {
+        QString("CLUSTER_X %1").arg(LightClusters::tilesX),
+        QString("CLUSTER_Y %1").arg(LightClusters::tilesY),
+        QString("CLUSTER_Z %1").arg(LightClusters::slices)
+    };
+
+    // Create the shading programs. Gouraud lights the vertices of the Phong
+    // vertex shader, the normal tier only colors its normals.
+    shaderCache.build(&shadingPrograms[ShadingGovernor::PHONG].program, ":/shaders/vertshader_phong.glsl",
+                      ":/shaders/fragshader_phong.glsl", clusterDefines);
+    shaderCache.build(&shadingPrograms[ShadingGovernor::NORMAL].program, ":/shaders/vertshader_phong.glsl",
+                      ":/shaders/fragshader_normal.glsl");
+    shaderCache.build(&shadingPrograms[ShadingGovernor::GOURAUD].program, ":/shaders/vertshader_phong.glsl",
+                      ":/shaders/fragshader_gouraud.glsl", clusterDefines + QStringList("GOURAUD"));
+
+    // Shadow casters are drawn depth only, from just outside the sun's core.
+    sunShadow.initialize(&shaderCache);
+    sunShadow.setRange(solarSystem.getSun()->getScale() * 0.5f, views[0].getCamera().getFarPlane());
+    for (RenderView &view : views) {
+        view.initialize(&shaderCache);
+    }
+    resolution.initialize(&shaderCache);
+    starField.initialize(&shaderCache);
+    virtualTextures.initialize(&shaderCache);
+
+    // Warm programs came from the binary cache, cold ones were compiled from source.
+    LOG(Log::GL, Log::INFO) << ":: Shader programs:"
+             << shaderCache.getWarmCount() << "warm in" << shaderCache.getWarmTime() << "ms,"
+             << shaderCache.getColdCount() << "cold in" << shaderCache.getColdTime() << "ms";
+
+    // Get the uniforms of the shading programs.
+    for (ShadingProgram &shading : shadingPrograms) {
+        QOpenGLShaderProgram &program = shading.program;
+        shading.modelTransform       = program.uniformLocation("modelTransform");
+        shading.viewTransform        = program.uniformLocation("viewTransform");
+        shading.projectionTransform  = program.uniformLocation("projectionTransform");
+        shading.normalTransform      = program.uniformLocation("normalTransform");
+        shading.material             = program.uniformLocation("material");
+        shading.lightPosition        = program.uniformLocation("lightPosition");
+        shading.lightColor           = program.uniformLocation("lightColor");
+        shading.textureSampler       = program.uniformLocation("textureSampler");
+        shading.cameraPosition       = program.uniformLocation("cameraPosition");
+        shading.lightData            = program.uniformLocation("lightData");
+        shading.clusterData          = program.uniformLocation("clusterData");
+        shading.lightIndices         = program.uniformLocation("lightIndices");
+        shading.clusterViewport      = program.uniformLocation("clusterViewport");
+        shading.clusterSlice         = program.uniformLocation("clusterSlice");
+        shading.shadowMap            = program.uniformLocation("shadowMap");
+        shading.shadowParams         = program.uniformLocation("shadowParams");
+        shading.indirection          = program.uniformLocation("indirection");
+        shading.pageCache            = program.uniformLocation("pageCache");
+        shading.virtualPages         = program.uniformLocation("virtualPages");
+        shading.pageSlot             = program.uniformLocation("pageSlot");
+        shading.orbits               = program.uniformLocation("orbits");
+        shading.orbitTime            = program.uniformLocation("orbitTime");
+        shading.orbitBody            = program.uniformLocation("orbitBody");
+    }
 }
 
 // --- OpenGL drawing
@@ -113,59 +212,353 @@ void MainView::createShaderProgram() {
  *
  */
 void MainView::paintGL() {
-    // Clear the screen before rendering
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    solarSystem.simulate(time, speed);
-    calculateCameraPosition();
+    paintTimer.start();
+    scheduler.beginFrame();
+    // Steps were tuned for 60 frames per second, scale them to the real frame
+    // time, to the fixed step of a capture or to the step of a replay.
+    float frameTime = capture.isActive() ? capture.getTimeStep() : scheduler.getFrameTime();
+
+    // Combo box changes are recorded before the frame they apply to.
+    int lookingFrom = comboBox_lookingFrom->currentData().toInt();
+    int lookingAt = comboBox_lookingAt->currentData().toInt();
+    if (lookingFrom != views[activeView].getLookingFrom()) replay.add(ReplayEvent::LOOK_FROM, lookingFrom);
+    if (lookingAt != views[activeView].getLookingAt()) replay.add(ReplayEvent::LOOK_AT, lookingAt);
+    if (!replay.beginFrame(frameTime, replayEvents)) {
+        // A replay only comes from the command line, its end ends the run.
+        replay.stop();
+        emit playingChanged(false);
+        QCoreApplication::quit();
+        return;
+    }
+    for (const ReplayEvent &event : replayEvents) {
+        applyReplayEvent(event);
+    }
+    float frameScale = frameTime * 60.0f;
+
+    solarSystem.simulate(time, speed * frameScale);
+    solarSystem.gatherLights(pointLights);
+    orbits.update(&solarSystem, time);
+
+    // The active view follows the combo boxes.
+    views[activeView].setLookingFrom(comboBox_lookingFrom->currentData().toInt());
+    views[activeView].setLookingAt(comboBox_lookingAt->currentData().toInt());
+
+    // Shadow faces render into their own framebuffer, the views into the scaled target.
+    lightPosition = solarSystem.getSun()->getLocation();
+    sunShadow.update(&solarSystem, lightPosition, solarSystem.getSun());
+    // Pages asked for by the feedback of earlier frames.
+    virtualTextures.update();
+
+    // Every tier gets the frame's uniforms, the views pick the program per object.
+    for (ShadingProgram &shading : shadingPrograms) {
+        shading.program.bind();
+        updateFrameUniforms(shading);
+        shading.program.release();
+    }
+    governor.beginFrame();
+
+    // Later views are drawn over earlier ones, each clears only its own area.
+    // They render at the scaled size, then are scaled up into the widget.
+    int w = qRound(width() * devicePixelRatioF()), h = qRound(height() * devicePixelRatioF());
+    QSize size = resolution.begin(w, h);
+    float pixelScale = devicePixelRatioF() * size.width() / w;
+    glEnable(GL_SCISSOR_TEST);
+    for (int v = 0; v != getViewCount(); ++v) {
+        paintView(views[v], views[v].getViewport(size.width(), size.height()), pixelScale);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    governor.endFrame();
+    resolution.end(defaultFramebufferObject());
+    if (currentShader == AUTOMATIC) {
+        governor.adjust(qMax(resolution.getGpuTime(), resolution.getCpuTime()), resolution.getBudget(),
+                        !resolution.isAutomatic() || resolution.getScale() <= resolution.getMinScale());
+    }
+    paintFeedback(size);
+
+    // Read back asynchronously, a later frame maps the pixels.
+    capture.capture(defaultFramebufferObject(), w, h);
+    if (capture.isFinished()) {
+        // Only a capture from the command line has a frame limit, it ends the run.
+        capture.stop();
+        QCoreApplication::quit();
+    }
+    reportStatistics();
+
+    time += timeStep*speed*frameScale;
+    // A paused simulation only needs new frames when something else changes,
+    // or while work started by a change finishes on later frames.
+    bool queriesInFlight = false;
+    for (int v = 0; v != getViewCount(); ++v) {
+        queriesInFlight = queriesInFlight || views[v].getOcclusionCuller().hasQueriesInFlight();
+    }
+    scheduler.setAnimating(speed != 0.0f || capture.isActive() || replay.isPlaying() ||
+                           virtualTextures.hasPendingWork() || queriesInFlight);
 
-    updateModelTransforms();
-    updateViewTransform();
+    int drawn = 0;
+    for (int v = 0; v != getViewCount(); ++v) {
+        drawn += views[v].getStatistics().drawn;
+    }
+    replay.endFrame(paintTimer.nsecsElapsed() / 1.0e6, resolution.getGpuTime(), drawn);
+}
 
-    // Choose the selected shader.
-    switch (currentShader) {
-    case NORMAL:
-        qDebug() << "Normal shader program not implemented";
+/**
+ * @brief MainView::applyReplayEvent
+ *
+ * Does what the recorded input did, without recording it again.
+ */
+void MainView::applyReplayEvent(const ReplayEvent &event) {
+    switch (event.type) {
+    case ReplayEvent::HEIGHT: radius = event.number; break;
+    case ReplayEvent::ANGLE: angle = event.number; break;
+    case ReplayEvent::SPEED: speed = event.number; break;
+    case ReplayEvent::FOV:
+        for (RenderView &view : views) {
+            view.getCamera().setFOV(event.number);
+        }
+        break;
+    case ReplayEvent::LOOK_FROM:
+    case ReplayEvent::LOOK_AT: {
+        QComboBox *box = event.type == ReplayEvent::LOOK_FROM ? comboBox_lookingFrom : comboBox_lookingAt;
+        int index = box->findData(event.integer);
+        if (index >= 0) box->setCurrentIndex(index);
         break;
-    case GOURAUD:
-        qDebug() << "Gouraud shader program not implemented";
+    }
+    case ReplayEvent::ACTIVE_VIEW:
+        if (event.integer >= 0 && event.integer < getViewCount()) setActiveView(event.integer);
         break;
-    case PHONG:
-        phongShaderProgram.bind();
-        updatePhongUniforms();
+    case ReplayEvent::SHADING:
+        if (event.integer >= 0 && event.integer <= static_cast<qint32>(AUTOMATIC)) currentShader = static_cast<ShadingMode>(event.integer);
         break;
+    case ReplayEvent::KEY: handleKey(event.integer); break;
+    case ReplayEvent::FRAME: break;
     }
+}
 
-    paintSolarSystem(&solarSystem);
+/**
+ * @brief MainView::paintView
+ *
+ * Draws one view into its viewport of the bound framebuffer. pixelScale is
+ * the size of a logical pixel in that framebuffer.
+ */
+void MainView::paintView(RenderView &view, QRect viewport, float pixelScale) {
+    view.update(&solarSystem, angle, radius, viewport);
+    view.updateLightClusters(pointLights);
 
-    phongShaderProgram.release();
+    glViewport(viewport.x(), viewport.y(), viewport.width(), viewport.height());
+    glScissor(viewport.x(), viewport.y(), viewport.width(), viewport.height());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    paintSolarSystem(&solarSystem, view, viewport);
+
+    // Stars only pass the depth test where no object was drawn.
+    starField.draw(view.getViewTransform(), view.getProjectionTransform(), pixelScale);
 
-    time += timeStep*speed;
+    // Bounding boxes are tested against this view's depth, the results skip
+    // hidden objects in a later frame.
+    view.getOcclusionCuller().issueQueries(solarSystem.objects,
+                                           view.getProjectionTransform() * view.getViewTransform(),
+                                           view.getCamera().getPosition(), view.getCamera().getNearPlane());
 }
 
-void MainView::paintSolarSystem (SolarSystem *ss) {
-    for (Object *o : ss->objects) {
-        paintObject(o);
+void MainView::paintSolarSystem (SolarSystem *ss, RenderView &view, QRect viewport) {
+    OcclusionCuller &culler = view.getOcclusionCuller();
+    RenderView::Statistics &statistics = view.getStatistics();
+    culler.beginFrame(ss->objects.size());
+    statistics.drawn = 0;
+    statistics.outside = 0;
+    statistics.occluded = culler.getOccludedCount();
+
+    float pixels[ShadingGovernor::tierCount] = {};
+    for (QVector<int> &objects : tierObjects) {
+        objects.clear();
+    }
+    for (int i = 0; i != ss->objects.size(); ++i) {
+        Object *o = ss->objects[i];
+        if (!view.isInFrustum(o->getLocation(), o->getBoundingRadius())) {
+            statistics.outside++;
+        } else if (culler.isVisible(i)) {
+            float covered;
+            ShadingGovernor::Tier tier = shadingTier(view, viewport, i, covered);
+            tierObjects[tier].push_back(i);
+            pixels[tier] += covered;
+            statistics.drawn++;
+        }
+    }
+
+    for (int t = 0; t != ShadingGovernor::tierCount; ++t) {
+        if (tierObjects[t].isEmpty()) continue;
+        ShadingProgram &shading = shadingPrograms[t];
+        shading.program.bind();
+        updateViewUniforms(shading, view, viewport);
+        governor.beginPass(static_cast<ShadingGovernor::Tier>(t), tierObjects[t].size(), pixels[t]);
+        for (int i : tierObjects[t]) {
+            paintObject(shading, i);
+        }
+        governor.endPass();
+        shading.program.release();
     }
 }
 
-void MainView::paintObject(Object *obj) {
-    glUniformMatrix4fv(uniformModelTransformPhong, 1, GL_FALSE, obj->meshTransform.data());
-    glUniformMatrix3fv(uniformNormalTransformPhong, 1, GL_FALSE, obj->meshNormalTransform.data());
-    obj->draw();
+/**
+ * @brief MainView::shadingTier
+ *
+ * The chosen tier, or in automatic mode the governor's choice by the radius on
+ * screen. Virtually textured objects look up their pages per fragment anyway,
+ * they keep Phong shading instead of Gouraud.
+ */
+ShadingGovernor::Tier MainView::shadingTier(RenderView &view, QRect viewport, int object, float &pixels) {
+    Object *o = solarSystem.objects[object];
+    float distance = (o->getLocation() - view.getCamera().getPosition()).length();
+    float radius = ShadingGovernor::pixelRadius(o->getBoundingRadius(), distance,
+                                                view.getProjectionTransform()(1, 1), viewport.height());
+    pixels = qMin(float(M_PI) * radius * radius, float(viewport.width()) * viewport.height());
+
+    ShadingGovernor::Tier tier = currentShader == AUTOMATIC ? governor.choose(radius)
+                                                            : static_cast<ShadingGovernor::Tier>(currentShader);
+    if (tier == ShadingGovernor::GOURAUD && virtualTextureOf.value(object, -1) >= 0) return ShadingGovernor::PHONG;
+    return tier;
 }
 
-void MainView::calculateCameraPosition() {
-    Object *lookingFrom = solarSystem.objects[comboBox_lookingFrom->currentIndex()];
-    QVector3D dir =
-            solarSystem.objects[comboBox_lookingAt->currentIndex()]->getLocation() -
-            lookingFrom->getLocation();
-    if (dir == QVector3D()) dir = QVector3D (0,0,1);
-    QVector3D pos = -dir.normalized() * radius * lookingFrom->getScale();
-    QVector3D r = QVector3D::crossProduct(dir, QVector3D(0,1,0));
-    QMatrix4x4 rot = QMatrix4x4();
-    rot.rotate(angle, r);
-    camera.setPosition(rot * pos + solarSystem.objects[comboBox_lookingFrom->currentIndex()]->getLocation());
+void MainView::paintObject(ShadingProgram &shading, int object) {
+    if (orbits.isOrbiting(object)) {
+        // The vertex shader places it, its matrices are never built.
+        glUniform1i(shading.orbitBody, object + 1);
+    } else {
+        glUniform1i(shading.orbitBody, 0);
+        glUniformMatrix4fv(shading.modelTransform, 1, GL_FALSE, solarSystem.getModelTransform(object).constData());
+        glUniformMatrix3fv(shading.normalTransform, 1, GL_FALSE, solarSystem.getNormalTransform(object).constData());
+    }
+    int virtualTexture = virtualTextureOf.value(object, -1);
+    if (virtualTexture >= 0) {
+        QVector3D pages = virtualTextures.getPages(virtualTexture);
+        glUniform4f(shading.virtualPages, pages.x(), pages.y(), pages.z(), 1.0F);
+        glActiveTexture(GL_TEXTURE5);
+        glBindTexture(GL_TEXTURE_2D, virtualTextures.getIndirection(virtualTexture));
+        glActiveTexture(GL_TEXTURE0);
+    } else {
+        glUniform4f(shading.virtualPages, 0.0F, 0.0F, 0.0F, 0.0F);
+    }
+    solarSystem.objects[object]->draw();
+}
+
+/**
+ * @brief MainView::paintFeedback
+ *
+ * Each view draws into its own area of the feedback target, at a fraction of
+ * the render size. Objects without a virtual texture are not drawn, so pages
+ * behind them are still asked for; that only costs cache space. The pages
+ * wanted only change with the views and the scene, so an unchanged frame
+ * draws no new pass.
+ */
+void MainView::paintFeedback(QSize size) {
+    int divisor = VirtualTextureCache::getFeedbackDivisor();
+    int w = qMax(1, size.width() / divisor), h = qMax(1, size.height() / divisor);
+    QVector<QMatrix4x4> transforms;
+    QVector<QRect> viewports;
+    for (int v = 0; v != getViewCount(); ++v) {
+        transforms.append(views[v].getProjectionTransform() * views[v].getViewTransform());
+        viewports.append(views[v].getViewport(w, h));
+    }
+    if (transforms != feedbackTransforms || viewports != feedbackViewports ||
+            solarSystem.getSteps() != feedbackSteps || time != feedbackTime) {
+        feedbackTransforms = transforms;
+        feedbackViewports = viewports;
+        feedbackSteps = solarSystem.getSteps();
+        feedbackTime = time;
+        virtualTextures.invalidateFeedback();
+    }
+    if (!virtualTextures.beginFeedback(w, h)) return;
+    for (int v = 0; v != getViewCount(); ++v) {
+        RenderView &view = views[v];
+        virtualTextures.setFeedbackView(view.getViewport(w, h), view.getViewTransform(), view.getProjectionTransform());
+        for (int i = 0; i != solarSystem.objects.size(); ++i) {
+            Object *o = solarSystem.objects[i];
+            if (virtualTextureOf.value(i, -1) < 0 || !view.isInFrustum(o->getLocation(), o->getBoundingRadius())) continue;
+            virtualTextures.drawFeedback(virtualTextureOf[i], solarSystem.getModelTransform(i), o);
+        }
+    }
+    virtualTextures.endFeedback(defaultFramebufferObject());
+}
+
+void MainView::reportStatistics() {
+    if (statisticsTimer.isValid() && statisticsTimer.elapsed() < 250) return;
+    statisticsTimer.start();
+
+    QStringList lines;
+    FrameScheduler::Statistics frames = scheduler.getStatistics();
+    lines << QString("Time: %1").arg(time, 0, 'f', 2);
+    lines << QString("Frames (%1): %2 fps").arg(FrameScheduler::modeName(scheduler.getMode()))
+                 .arg(frames.fps, 0, 'f', 1);
+    lines << QString("Interval %1 ms, jitter %2 ms").arg(frames.meanInterval, 0, 'f', 2)
+                 .arg(frames.jitter, 0, 'f', 2);
+    lines << QString("Worst %1 ms, %2 late of %3").arg(frames.worstInterval, 0, 'f', 2)
+                 .arg(frames.late).arg(frames.frames);
+    lines << QString("Objects: %1, occlusion culling %2").arg(solarSystem.objects.size())
+                 .arg(views[0].getOcclusionCuller().isEnabled() ? "on" : "off");
+    lines << QString("Transforms updated: %1").arg(solarSystem.getTransformsUpdated());
+    lines << QString("Point lights: %1").arg(pointLights.size());
+    if (orbits.isActive()) {
+        lines << QString("Orbits on the GPU: %1 past the epoch, %2 uploads").arg(orbits.getTime(), 0, 'f', 1)
+                     .arg(orbits.getUploads());
+    }
+    // The active view is marked with a star.
+    lines << QString("Layout: %1").arg(layoutName(layout));
+    for (int v = 0; v != getViewCount(); ++v) {
+        RenderView::Statistics &s = views[v].getStatistics();
+        lines << QString("View %1%2: drawn %3, outside %4, occluded %5, lights %6").arg(v + 1)
+                     .arg(v == activeView ? "*" : "").arg(s.drawn).arg(s.outside).arg(s.occluded).arg(s.lights);
+    }
+    // GPU time per tier, and per million pixels covered to compare the tiers.
+    lines << QString("Shading: %1%2").arg(shadingName(currentShader))
+                 .arg(currentShader == AUTOMATIC ? QString(", Gouraud below %1 px").arg(governor.getGouraudRadius(), 0, 'f', 0) : "");
+    for (int t = 0; t != ShadingGovernor::tierCount; ++t) {
+        ShadingGovernor::Tier tier = static_cast<ShadingGovernor::Tier>(t);
+        if (governor.getObjects(tier) == 0) continue;
+        float megapixels = governor.getPixels(tier) / 1.0e6f;
+        lines << QString("  %1: %2 objects, %3 ms, %4 ms/Mpx").arg(ShadingGovernor::tierName(tier))
+                     .arg(governor.getObjects(tier)).arg(governor.getTime(tier), 0, 'f', 2)
+                     .arg(megapixels > 0.0f ? governor.getTime(tier) / megapixels : 0.0f, 0, 'f', 2);
+    }
+    lines << QString("Shadow faces rendered: %1").arg(sunShadow.getFacesRendered());
+    lines << QString("Stars: %1").arg(starField.getCount());
+    if (virtualTextures.getTextureCount() > 0) {
+        VirtualTextureCache::Statistics pages = virtualTextures.getStatistics();
+        lines << QString("Virtual pages: %1 resident, %2 queued, %3 missing, %4 evicted").arg(pages.resident)
+                     .arg(pages.queued).arg(pages.missing).arg(pages.evicted);
+    }
+    lines << QString("Resolution: %1%2, GPU %3 ms, CPU %4 ms").arg(QString::number(qRound(resolution.getScale() * 100)) + "%")
+                 .arg(resolution.isAutomatic() ? QString(" (auto, %1 ms)").arg(resolution.getBudget(), 0, 'f', 1) : "")
+                 .arg(resolution.getGpuTime(), 0, 'f', 2).arg(resolution.getCpuTime(), 0, 'f', 2);
+    if (selected >= 0) {
+        lines << QString("Selected: %1, picked in %2 ms (+%3 ms refit)").arg(solarSystem.objects[selected]->getName())
+                     .arg(picker.getQueryTime(), 0, 'f', 3).arg(picker.getUpdateTime(), 0, 'f', 3);
+    }
+    if (replay.getMode() != Replay::OFF) {
+        lines << QString("%1: frame %2").arg(replay.isPlaying() ? "Replaying" : "Recording").arg(replay.getFrame());
+    }
+    if (capture.isActive()) {
+        lines << QString("Capture: %1 frames, %2 written, %3 queued").arg(capture.getFramesCaptured())
+                     .arg(capture.getFramesWritten()).arg(capture.getQueueLength());
+    }
+    // A full report walks every object, so it is only counted again when
+    // the objects, assets or render targets changed.
+    QVector<qint64> key = {solarSystem.objects.size(), AssetCache::instance()->getMeshCount(),
+                           AssetCache::instance()->getTextureCount(), getViewCount(), starField.getCount(),
+                           resolution.getMemoryUsage(), orbits.getMemoryUsage(), virtualTextures.getTextureCount()};
+    if (key != memoryKey) {
+        MemoryReport memory;
+        reportMemory(memory);
+        updateMemoryTotals(memory);
+        memoryKey = key;
+    }
+    lines << QString("Memory: CPU %1 MB, GPU %2 MB").arg(memoryCpu / 1048576.0, 0, 'f', 1)
+                 .arg(memoryGpu / 1048576.0, 0, 'f', 1);
+    emit statisticsChanged(lines.join('\n'));
+}
+
+void MainView::updateMemoryTotals(MemoryReport &report) {
+    memoryCpu = report.getTotal(MemoryReport::CPU);
+    memoryGpu = report.getGpuTotal();
 }
 
 /**
@@ -179,72 +572,203 @@ void MainView::calculateCameraPosition() {
 void MainView::resizeGL(int newWidth, int newHeight) {
     Q_UNUSED(newWidth)
     Q_UNUSED(newHeight)
-    updateProjectionTransform();
 }
 
-void MainView::updatePhongUniforms() {
-    glUniformMatrix4fv(uniformViewTransformPhong, 1, GL_FALSE, viewTransform.data());
-    glUniformMatrix4fv(uniformProjectionTransformPhong, 1, GL_FALSE, projectionTransform.data());
+// Set once per frame, the program keeps them while the views change the rest.
+void MainView::updateFrameUniforms(ShadingProgram &shading) {
+    glUniform4fv(shading.material, 1, &material[0]);
+    glUniform3fv(shading.lightPosition, 1, &lightPosition[0]);
+    glUniform3f(shading.lightColor, lightColor.x(), lightColor.y(), lightColor.z());
+
+    glUniform1i(shading.textureSampler, 0);
+    glUniform1i(shading.lightData, 1);
+    glUniform1i(shading.clusterData, 2);
+    glUniform1i(shading.lightIndices, 3);
+
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, sunShadow.getTexture());
+    glUniform1i(shading.shadowMap, 4);
+    glUniform3f(shading.shadowParams, sunShadow.getNearPlane(), sunShadow.getFarPlane(), 2.0F / sunShadow.getSize());
+
+    glActiveTexture(GL_TEXTURE6);
+    glBindTexture(GL_TEXTURE_2D, virtualTextures.getCacheTexture());
+    glUniform1i(shading.indirection, 5);
+    glUniform1i(shading.pageCache, 6);
+    QVector4D slot = virtualTextures.getSlotLayout();
+    glUniform4f(shading.pageSlot, slot.x(), slot.y(), slot.z(), slot.w());
+
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_BUFFER, orbits.getTexture());
+    glUniform1i(shading.orbits, 7);
+    glUniform1f(shading.orbitTime, orbits.getTime());
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void MainView::updateViewUniforms(ShadingProgram &shading, RenderView &view, QRect viewport) {
+    glUniformMatrix4fv(shading.viewTransform, 1, GL_FALSE, view.getViewTransform().constData());
+    glUniformMatrix4fv(shading.projectionTransform, 1, GL_FALSE, view.getProjectionTransform().constData());
+    QVector3D eye = view.getCamera().getPosition();
+    glUniform3f(shading.cameraPosition, eye.x(), eye.y(), eye.z());
 
-    glUniform4fv(uniformMaterialPhong, 1, &material[0]);
-    glUniform3fv(uniformLightPositionPhong, 1, &lightPosition[0]);
-    glUniform3f(uniformLightColorPhong, lightColor.x(), lightColor.y(), lightColor.z());
-    glUniform3f(uniformCameraPosition, camera.getPosition().x(), camera.getPosition().y(), camera.getPosition().z());
+    // The shader maps gl_FragCoord to tiles, which is in device pixels.
+    glUniform4f(shading.clusterViewport, viewport.x(), viewport.y(), viewport.width(), viewport.height());
+    LightClusters &clusters = view.getLightClusters();
+    glUniform2f(shading.clusterSlice, clusters.getSliceScale(), clusters.getSliceBias());
 
-    glUniform1i(uniformTextureSamplerPhong, 0);
+    for (int i = 0; i != 3; ++i) {
+        glActiveTexture(GL_TEXTURE1 + i);
+        glBindTexture(GL_TEXTURE_BUFFER, view.getClusterTexture(i));
+    }
+    glActiveTexture(GL_TEXTURE0);
 }
 
-void MainView::updateProjectionTransform() {
-    float aspectRatio = static_cast<float>(width()) / static_cast<float>(height());
-    projectionTransform.setToIdentity();
-    projectionTransform.perspective(
-                camera.getFOV(),
-                aspectRatio,
-                camera.getNearPlane(),
-                camera.getFarPlane()
-            );
+// --- Public interface
+
+/**
+ * @brief MainView::reportMemory
+ *
+ * Everything the view and the solar system hold, including the shared assets.
+ */
+void MainView::reportMemory(MemoryReport &report) {
+    solarSystem.reportMemory(report);
+    AssetCache::instance()->reportMemory(report);
+    AssetPack::reportMounted(report);
+
+    report.add(MemoryReport::CPU, "lights", "point lights", MemoryReport::bytes(pointLights));
+    static const char *clusterNames[3] = {"light data", "cluster ranges", "light indices"};
+    for (int v = 0; v != getViewCount(); ++v) {
+        QString prefix = QString("view %1 ").arg(v + 1);
+        report.add(MemoryReport::CPU, "lights", prefix + "clusters", views[v].getLightClusters().getMemoryUsage());
+        for (int i = 0; i != 3; ++i) {
+            report.add(MemoryReport::GPU_BUFFER, "lights", prefix + clusterNames[i], views[v].getClusterBufferBytes(i));
+        }
+    }
+
+    // GL_DEPTH_COMPONENT24 is stored in 32 bits.
+    qint64 shadowBytes = qint64(sunShadow.getSize()) * sunShadow.getSize() * 6 * 4;
+    report.add(MemoryReport::GPU_TEXTURE, "shadows", "sun cube map", shadowBytes);
+    report.add(MemoryReport::GPU_BUFFER, "stars", "stars", qint64(starField.getCount()) * sizeof(StarCatalog::Star));
+    report.add(MemoryReport::GPU_TEXTURE, "resolution", "scaled target", resolution.getMemoryUsage());
+    report.add(MemoryReport::GPU_BUFFER, "scene", "orbits", orbits.getMemoryUsage());
+    picker.reportMemory(report);
+    if (virtualTextures.getTextureCount() > 0) virtualTextures.reportMemory(report);
 }
 
-void MainView::updateViewTransform() {
-    viewTransform.setToIdentity();
-    viewTransform.lookAt(camera.getPosition(), solarSystem.objects[comboBox_lookingAt->currentIndex()]->getLocation(), QVector3D(0,1,0));
+bool MainView::exportMemoryReport(QString file) {
+    MemoryReport report;
+    reportMemory(report);
+    // The panel shows the same totals as the file.
+    updateMemoryTotals(report);
+    if (!report.write(file)) {
+        LOG(Log::GENERAL, Log::WARNING) << "Cannot write memory report" << file;
+        return false;
+    }
+    LOG(Log::GENERAL, Log::INFO) << "Wrote memory report" << file;
+    return true;
 }
 
-void MainView::updateModelTransform(Object *obj) {
-    obj->meshTransform.setToIdentity();
-    obj->meshTransform.translate(obj->getLocation());
+void MainView::setShadingMode(ShadingMode shading) {
+    if (replay.isPlaying()) return;
+    replay.add(ReplayEvent::SHADING, static_cast<qint32>(shading));
+    LOG(Log::RENDER, Log::INFO) << "Changed shading to" << shadingName(shading);
+    currentShader = shading;
+}
 
-    obj->meshTransform.rotate(rotation.x(), {1.0F, 0.0F, 0.0F});
-    obj->meshTransform.rotate(rotation.y(), {0.0F, 1.0F, 0.0F});
-    obj->meshTransform.rotate(rotation.z(), {0.0F, 0.0F, 1.0F});
+QString MainView::shadingName(ShadingMode shading) {
+    if (shading == AUTOMATIC) return "automatic";
+    return ShadingGovernor::tierName(static_cast<ShadingGovernor::Tier>(shading));
+}
 
-    obj->meshTransform.scale(obj->getScale());
+void MainView::setHeight(float r) {
+    if (replay.isPlaying()) return;
+    replay.add(ReplayEvent::HEIGHT, r);
+    radius = r;
+    update();
+}
 
-    obj->meshTransform.rotate(obj->getAngle(), {0,1,0});
+void MainView::setAngle(float a) {
+    if (replay.isPlaying()) return;
+    replay.add(ReplayEvent::ANGLE, a);
+    angle = a;
+    update();
+}
 
-    obj->meshNormalTransform = obj->meshTransform.normalMatrix();
+void MainView::setSpeed(float s) {
+    if (replay.isPlaying()) return;
+    replay.add(ReplayEvent::SPEED, s);
+    speed = s;
+    update();
+}
 
+void MainView::setTime(double t) {
+    time = t;
+    solarSystem.resetTime();
+    LOG(Log::SIMULATION, Log::INFO) << "Time" << time;
     update();
 }
 
-void MainView::updateModelTransforms() {
-    for (Object *o : solarSystem.objects) {
-        updateModelTransform(o);
+void MainView::setCameraFOV(float fov) {
+    if (replay.isPlaying()) return;
+    replay.add(ReplayEvent::FOV, fov);
+    for (RenderView &view : views) {
+        view.getCamera().setFOV(fov);
     }
+    update();
+}
 
+/**
+ * @brief MainView::setLayout
+ *
+ * Picture in picture puts the second view in the top right corner, the quad
+ * layout gives each view a quarter.
+ */
+void MainView::setLayout(Layout l) {
+    layout = l;
+    switch (layout) {
+    case SINGLE:
+        views[0].setArea(QRectF(0, 0, 1, 1));
+        break;
+    case PICTURE_IN_PICTURE:
+        views[0].setArea(QRectF(0, 0, 1, 1));
+        views[1].setArea(QRectF(0.69, 0.69, 0.3, 0.3));
+        break;
+    case QUAD:
+        views[0].setArea(QRectF(0, 0.5, 0.5, 0.5));
+        views[1].setArea(QRectF(0.5, 0.5, 0.5, 0.5));
+        views[2].setArea(QRectF(0, 0, 0.5, 0.5));
+        views[3].setArea(QRectF(0.5, 0, 0.5, 0.5));
+        break;
+    }
+    if (activeView >= getViewCount()) setActiveView(0);
+    LOG(Log::RENDER, Log::INFO) << "Layout" << layoutName(layout);
     update();
 }
 
-// --- Public interface
+int MainView::getViewCount() {
+    switch (layout) {
+    case PICTURE_IN_PICTURE: return 2;
+    case QUAD: return 4;
+    default: return 1;
+    }
+}
 
-void MainView::setShadingMode(ShadingMode shading) {
-    qDebug() << "Changed shading to" << shading;
-    currentShader = shading;
+// The combo boxes switch to the view, painting then reads them into it.
+void MainView::setActiveView(int view) {
+    activeView = view;
+    if (!comboBox_lookingFrom || comboBox_lookingFrom->count() == 0) return;
+    int from = comboBox_lookingFrom->findData(views[view].getLookingFrom());
+    int at = comboBox_lookingAt->findData(views[view].getLookingAt());
+    if (from >= 0) comboBox_lookingFrom->setCurrentIndex(from);
+    if (at >= 0) comboBox_lookingAt->setCurrentIndex(at);
+    update();
 }
 
-void MainView::setCameraFOV(float fov) {
-    camera.setFOV(fov);
-    updateProjectionTransform();
+QString MainView::layoutName(Layout l) {
+    switch (l) {
+    case PICTURE_IN_PICTURE: return "picture in picture";
+    case QUAD: return "quad";
+    default: return "single";
+    }
 }
 
 // --- Private helpers
@@ -257,5 +781,12 @@ void MainView::setCameraFOV(float fov) {
  * @param Message
  */
 void MainView::onMessageLogged( QOpenGLDebugMessage Message ) {
-    qDebug() << " → Log:" << Message;
+    Log::Level level = Log::DEBUG;
+    switch (Message.severity()) {
+    case QOpenGLDebugMessage::HighSeverity:   level = Log::CRITICAL; break;
+    case QOpenGLDebugMessage::MediumSeverity: level = Log::WARNING; break;
+    case QOpenGLDebugMessage::LowSeverity:    level = Log::INFO; break;
+    default: break;
+    }
+    LOG(Log::GL, level) << " → Log:" << Message;
 }
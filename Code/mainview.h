@@ -5,6 +5,20 @@
 #include "object.h"
 #include "camera.h"
 #include "solarsystem.h"
+#include "shadercache.h"
+#include "lightclusters.h"
+#include "shadowmap.h"
+#include "renderview.h"
+#include "replay.h"
+#include "resolutionscaler.h"
+#include "shadinggovernor.h"
+#include "starfield.h"
+#include "framecapture.h"
+#include "framescheduler.h"
+#include "memoryreport.h"
+#include "orbitbuffer.h"
+#include "picker.h"
+#include "virtualtexturecache.h"
 
 #include <QImage>
 #include <QKeyEvent>
@@ -14,10 +28,10 @@
 #include <QOpenGLFunctions_3_3_Core>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLWidget>
-#include <QTimer>
 #include <QVector>
 #include <QVector3D>
 #include <QComboBox>
+#include <QElapsedTimer>
 #include <QtMath>
 
 #include <memory>
@@ -26,34 +40,61 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
     Q_OBJECT
 
     QOpenGLDebugLogger debugLogger;
-    QTimer timer; // Timer used for animation.
+    FrameScheduler scheduler; // Decides when the next frame is painted.
+    FrameCapture capture;     // Image sequence recording, toggled with C.
 
-    QOpenGLShaderProgram phongShaderProgram;
+    ShaderCache shaderCache;
 
-    // Uniforms for the Phong shader program.
-    GLint uniformModelTransformPhong;
-    GLint uniformViewTransformPhong;
-    GLint uniformProjectionTransformPhong;
-    GLint uniformNormalTransformPhong;
+    // A program per shading tier, in the order of ShadingGovernor::Tier, with
+    // its uniforms. Uniforms a program does not use are -1, which GL ignores.
+    struct ShadingProgram {
+        QOpenGLShaderProgram program;
 
-    GLint uniformMaterialPhong;
-    GLint uniformLightPositionPhong;
-    GLint uniformLightColorPhong;
-    GLint uniformCameraPosition;
+        GLint modelTransform;
+        GLint viewTransform;
+        GLint projectionTransform;
+        GLint normalTransform;
 
-    GLint uniformTextureSamplerPhong;
+        GLint material;
+        GLint lightPosition;
+        GLint lightColor;
+        GLint cameraPosition;
 
-    SolarSystem solarSystem;
+        GLint textureSampler;
+
+        GLint lightData;
+        GLint clusterData;
+        GLint lightIndices;
+        GLint clusterViewport;
+        GLint clusterSlice;
+
+        GLint shadowMap;
+        GLint shadowParams;
+
+        GLint indirection;
+        GLint pageCache;
+        GLint virtualPages;
+        GLint pageSlot;
+
+        GLint orbits;
+        GLint orbitTime;
+        GLint orbitBody;
+    };
+    ShadingProgram shadingPrograms[ShadingGovernor::tierCount];
 
-    // Transforms
-    QMatrix4x4 projectionTransform;
-    QMatrix4x4 viewTransform;
-    QVector3D rotation = QVector3D();
+    // Picks the tier per object in automatic shading and times the tiers.
+    ShadingGovernor governor;
+    // Objects of each tier in the view being drawn.
+    QVector<int> tierObjects[ShadingGovernor::tierCount];
+
+    SolarSystem solarSystem;
 
-    Camera camera;
     float angle = 0, radius = 1.0f;
 
-    float time = 0;
+    // Double, so orbits stay exact after long runs and far jumps, see Orbit.
+    double time = 0;
+    static double defaultTime;
+    // Simulation time per 1/60 s at speed 1.
     float timeStep = 0.016f/10.0f;
     float speed = 1.0f;
 
@@ -62,26 +103,99 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
     QVector3D lightPosition = {0.0F, 0.0F, 0.0F};
     QVector3D lightColor = {1.0F, 1.0F, 1.0F};
 
+    // Point lights of the ships, gathered once per frame and clustered per
+    // view into buffer textures on units 1 to 3.
+    QVector<PointLight> pointLights;
+
+    // Shadows of the sun, on texture unit 4.
+    ShadowCubeMap sunShadow;
+
+    // The sky, drawn after the opaque geometry.
+    StarField starField;
+
+    // Surfaces too large for video memory, streamed in pages. The indirection
+    // texture of an object is on unit 5, the page cache on unit 6. Per object
+    // the id of its virtual texture, or -1.
+    VirtualTextureCache virtualTextures;
+    QVector<int> virtualTextureOf;
+    // What the last feedback pass was drawn for, see paintFeedback.
+    QVector<QMatrix4x4> feedbackTransforms;
+    QVector<QRect> feedbackViewports;
+    quint64 feedbackSteps = 0;
+    double feedbackTime = 0;
+
+    // Analytic orbits evaluated by the vertex shader, on unit 7 (toggle with K).
+    OrbitBuffer orbits;
+
+    // The views render offscreen at a scale that keeps the frame time in budget.
+    ResolutionScaler resolution;
+
+    // Recording or replaying the session, and the time spent in paintGL.
+    Replay replay;
+    QVector<ReplayEvent> replayEvents;
+    QElapsedTimer paintTimer;
+
+    // Limits how often the statistics panel is refreshed.
+    QElapsedTimer statisticsTimer;
+    // Memory totals for the panel and what they were counted for, see
+    // updateMemoryTotals.
+    QVector<qint64> memoryKey;
+    qint64 memoryCpu = 0, memoryGpu = 0;
+
 public:
+    // AUTOMATIC picks Phong or Gouraud per object, see ShadingGovernor.
     enum ShadingMode : GLuint
     {
-        PHONG = 0, NORMAL, GOURAUD
+        PHONG = 0, NORMAL, GOURAUD, AUTOMATIC
     };
 
+    // Arrangement of the views in the widget.
+    enum Layout
+    {
+        SINGLE = 0, PICTURE_IN_PICTURE, QUAD
+    };
+    static const int maxViews = 4;
+
     MainView(QWidget *parent = 0);
     ~MainView();
 
-    QComboBox *comboBox_lookingFrom;
-    QComboBox *comboBox_lookingAt;
+    QComboBox *comboBox_lookingFrom = nullptr;
+    QComboBox *comboBox_lookingAt = nullptr;
 
     // Functions for widget input events.
-    void setRotation(int rotateX, int rotateY, int rotateZ);
     void setShadingMode(ShadingMode shading);
+    ShadingMode getShadingMode() {return currentShader;}
+    static void setDefaultShadingMode(ShadingMode shading) {defaultShader = shading;}
+    static QString shadingName(ShadingMode shading);
     SolarSystem *getSolarSystem() {return &solarSystem;}
-    void setHeight(float r) {radius = r;}
-    void setAngle(float a) {angle = a;}
-    void setSpeed(float s) {speed = s;}
+    // Setters request a frame, for on-demand scheduling. They are recorded,
+    // and ignored during a replay.
+    void setHeight(float r);
+    void setAngle(float a);
+    void setSpeed(float s);
+    FrameScheduler *getScheduler() {return &scheduler;}
     void setCameraFOV(float fov);
+    void setLayout(Layout l);
+    Layout getLayout() {return layout;}
+    int getViewCount();
+    void setActiveView(int view);
+    static void setDefaultLayout(Layout l) {defaultLayout = l;}
+    static QString layoutName(Layout l);
+    ResolutionScaler *getResolutionScaler() {return &resolution;}
+    // Jumps to simulation time t, the orbits are evaluated there directly.
+    void setTime(double t);
+    double getTime() {return time;}
+    static void setDefaultTime(double t) {defaultTime = t;}
+
+    void reportMemory(MemoryReport &report);
+    // JSON, or CSV for a .csv file.
+    bool exportMemoryReport(QString file);
+
+signals:
+    // Summary of the last frame for the statistics panel, a few times per second.
+    void statisticsChanged(QString text);
+    // A replay started or ended. Live input is ignored while it plays.
+    void playingChanged(bool playing);
 
 protected:
     void initializeGL();
@@ -109,19 +223,42 @@ private:
 
     void destroyObjects();
 
-    void updateProjectionTransform();
-    void updateViewTransform();
-    void updateModelTransforms();
-    void updateModelTransform(Object *obj);
+    // Uniforms shared by all views, then the ones of a single view.
+    void updateFrameUniforms(ShadingProgram &shading);
+    void updateViewUniforms(ShadingProgram &shading, RenderView &view, QRect viewport);
 
-    void updatePhongUniforms();
+    void handleKey(int key);
+    void applyReplayEvent(const ReplayEvent &event);
 
-    void paintObject (Object *obj);
-    void paintSolarSystem (SolarSystem *ss);
-    void calculateCameraPosition();
+    void paintView(RenderView &view, QRect viewport, float pixelScale);
+    // objects[object], placed by its matrices or by the orbit buffer.
+    void paintObject (ShadingProgram &shading, int object);
+    // Each tier is drawn in one pass with its program.
+    void paintSolarSystem (SolarSystem *ss, RenderView &view, QRect viewport);
+    // The tier of objects[object] in view, and the pixels it covers.
+    ShadingGovernor::Tier shadingTier (RenderView &view, QRect viewport, int object, float &pixels);
+    // The virtually textured objects of every view, for the pages they need.
+    void paintFeedback (QSize size);
+    void chooseViewTargets();
+    // p in fractions of the widget from the bottom left, inside the area of view.
+    void selectObjectAt(int view, QPointF p);
+    void reportStatistics();
+    void updateMemoryTotals(MemoryReport &report);
 
     // The current shader to use.
     ShadingMode currentShader = PHONG;
+    static ShadingMode defaultShader;
+
+    // Views share the frame's simulation, lights and shadows. The combo boxes
+    // and sliders control the active view, clicking a view makes it active.
+    RenderView views[maxViews];
+    Layout layout = SINGLE;
+    int activeView = 0;
+    static Layout defaultLayout;
+
+    // Clicking selects the object under the cursor, double clicking looks at it.
+    Picker picker;
+    int selected = -1;
 };
 
 #endif // MAINVIEW_H
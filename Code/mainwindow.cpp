@@ -3,6 +3,8 @@
 
 #include "math.h"
 
+#include <QFileDialog>
+
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow) {
@@ -10,6 +12,25 @@ MainWindow::MainWindow(QWidget *parent) :
 
     ui->mainView->comboBox_lookingAt = ui->lookAt;
     ui->mainView->comboBox_lookingFrom = ui->lookFrom;
+
+    // The view reads the combo boxes when painting, so a change needs a frame.
+    connect(ui->lookFrom, SIGNAL(currentIndexChanged(int)), ui->mainView, SLOT(update()));
+    connect(ui->lookAt, SIGNAL(currentIndexChanged(int)), ui->mainView, SLOT(update()));
+    connect(ui->mainView, &MainView::statisticsChanged, ui->statistics, &QLabel::setText);
+    // A replay drives the camera, time and shading controls itself.
+    connect(ui->mainView, &MainView::playingChanged, this, [this](bool playing) {
+        ui->groupBox_2->setEnabled(!playing);
+        ui->timeBox->setEnabled(!playing);
+        ui->shadingBox->setEnabled(!playing);
+    });
+
+    // The shading can be chosen on the command line.
+    switch (ui->mainView->getShadingMode()) {
+    case MainView::GOURAUD: ui->GouraudButton->setChecked(true); break;
+    case MainView::NORMAL: ui->NormalButton->setChecked(true); break;
+    case MainView::AUTOMATIC: ui->AutomaticButton->setChecked(true); break;
+    default: break;
+    }
 }
 
 MainWindow::~MainWindow() {
@@ -27,6 +48,27 @@ void MainWindow::on_PhongButton_toggled(bool checked) {
     }
 }
 
+void MainWindow::on_GouraudButton_toggled(bool checked) {
+    if (checked) {
+        ui->mainView->setShadingMode(MainView::GOURAUD);
+        ui->mainView->update();
+    }
+}
+
+void MainWindow::on_NormalButton_toggled(bool checked) {
+    if (checked) {
+        ui->mainView->setShadingMode(MainView::NORMAL);
+        ui->mainView->update();
+    }
+}
+
+void MainWindow::on_AutomaticButton_toggled(bool checked) {
+    if (checked) {
+        ui->mainView->setShadingMode(MainView::AUTOMATIC);
+        ui->mainView->update();
+    }
+}
+
 void MainWindow::on_height_valueChanged(int value) {
     ui->mainView->setHeight(value/100.0f);
 }
@@ -43,3 +85,9 @@ void MainWindow::on_fov_valueChanged(int value) {
 void MainWindow::on_angle_valueChanged(int value) {
     ui->mainView->setAngle(value/10.0f);
 }
+
+void MainWindow::on_exportMemory_clicked() {
+    QString file = QFileDialog::getSaveFileName(this, "Export memory report", "memory.json",
+                                                "JSON (*.json);;CSV (*.csv)");
+    if (!file.isEmpty()) ui->mainView->exportMemoryReport(file);
+}
@@ -19,11 +19,16 @@ public:
 
 private slots:
     void on_PhongButton_toggled(bool checked);
+    void on_GouraudButton_toggled(bool checked);
+    void on_NormalButton_toggled(bool checked);
+    void on_AutomaticButton_toggled(bool checked);
 
     void on_height_valueChanged(int value);
     void on_speed_valueChanged(int value);
     void on_fov_valueChanged(int value);
     void on_angle_valueChanged(int value);
+
+    void on_exportMemory_clicked();
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,64 @@
+#include "memoryreport.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+static const char *kindNames[] = {"cpu", "gpu-buffer", "gpu-texture"};
+
+void MemoryReport::add(Kind kind, QString subsystem, QString name, qint64 bytes) {
+    Entry e = {kind, subsystem, name, bytes};
+    entries.push_back(e);
+}
+
+qint64 MemoryReport::getTotal(Kind kind) {
+    qint64 total = 0;
+    for (const Entry &e : entries) {
+        if (e.kind == kind) total += e.bytes;
+    }
+    return total;
+}
+
+QByteArray MemoryReport::toJson() {
+    QJsonArray array;
+    for (const Entry &e : entries) {
+        QJsonObject o;
+        o["kind"] = kindNames[e.kind];
+        o["subsystem"] = e.subsystem;
+        o["name"] = e.name;
+        o["bytes"] = double(e.bytes);
+        array.append(o);
+    }
+    QJsonObject totals;
+    totals["cpu"] = double(getTotal(CPU));
+    totals["gpuBuffers"] = double(getTotal(GPU_BUFFER));
+    totals["gpuTextures"] = double(getTotal(GPU_TEXTURE));
+
+    QJsonObject root;
+    root["entries"] = array;
+    root["totals"] = totals;
+    return QJsonDocument(root).toJson();
+}
+
+QByteArray MemoryReport::toCsv() {
+    QString text;
+    QTextStream out(&text);
+    out << "kind,subsystem,name,bytes\n";
+    for (const Entry &e : entries) {
+        QString name = e.name;
+        name.replace('"', "\"\"");
+        out << kindNames[e.kind] << "," << e.subsystem << ",\"" << name << "\"," << e.bytes << "\n";
+    }
+    out.flush();
+    return text.toUtf8();
+}
+
+bool MemoryReport::write(QString name) {
+    QFile file(name);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    bool csv = QFileInfo(name).suffix().compare("csv", Qt::CaseInsensitive) == 0;
+    return file.write(csv ? toCsv() : toJson()) >= 0;
+}
@@ -0,0 +1,48 @@
+#ifndef MEMORYREPORT_H
+#define MEMORYREPORT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The MemoryReport class
+ *
+ * Memory in use, collected on request: every owner adds its CPU bytes per
+ * subsystem and the size of each GPU buffer and texture it allocated. GPU
+ * sizes are what was requested from GL, the driver may use more.
+ */
+class MemoryReport {
+public:
+    enum Kind {
+        CPU = 0, GPU_BUFFER, GPU_TEXTURE
+    };
+
+    struct Entry {
+        Kind kind;
+        QString subsystem;
+        QString name;
+        qint64 bytes;
+    };
+
+    void add(Kind kind, QString subsystem, QString name, qint64 bytes);
+
+    const QVector<Entry> &getEntries() {return entries;}
+    qint64 getTotal(Kind kind);
+    qint64 getGpuTotal() {return getTotal(GPU_BUFFER) + getTotal(GPU_TEXTURE);}
+
+    QByteArray toJson();
+    QByteArray toCsv();
+    // JSON or CSV depending on the suffix of the file.
+    bool write(QString file);
+
+    // Bytes reserved by a container.
+    template <typename T>
+    static qint64 bytes(const QVector<T> &v) {return qint64(v.capacity()) * qint64(sizeof(T));}
+    static qint64 bytes(const QString &s) {return qint64(s.capacity()) * qint64(sizeof(QChar));}
+
+private:
+    QVector<Entry> entries;
+};
+
+#endif // MEMORYREPORT_H
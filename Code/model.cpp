@@ -1,52 +1,78 @@
 #include "model.h"
+#include "assetpack.h"
+#include "log.h"
+#include "memoryreport.h"
 
-#include <QDebug>
-#include <QFile>
 #include <QTextStream>
 #include <QMatrix4x4>
 #include <limits>
 #include <math.h>
 
 Model::Model(QString filename) {
-    qDebug() << ":: Loading model:" << filename;
-    QFile file(filename);
-    if(file.open(QIODevice::ReadOnly)) {
-        QTextStream in(&file);
+    LOG(Log::ASSETS, Log::INFO) << ":: Loading model:" << filename;
+    // From a mounted asset pack or the resources.
+    std::unique_ptr<QIODevice> file = AssetPack::openAsset(filename);
+    if(file) {
+        QTextStream in(file.get());
+        parse(in);
+        file->close();
 
-        QString line;
-        QStringList tokens;
+        // create an array version of the data
+        unpackIndexes();
 
-        while(!in.atEnd()) {
-            line = in.readLine();
-            if (line.startsWith("#")) continue; // skip comments
+        // Align all vertex indices with the right normal/texturecoord indices
+        alignData();
+        releaseParseData();
+    }
+}
 
-            tokens = line.split(" ", QString::SkipEmptyParts);
+/**
+ * @brief Model::releaseParseData
+ *
+ * The separate normal and texture coordinate lists and their indices are only
+ * needed until alignData, everything after reads the aligned arrays.
+ */
+void Model::releaseParseData() {
+    norm = QVector<QVector3D>();
+    tex = QVector<QVector2D>();
+    normal_indices = QVector<unsigned>();
+    texcoord_indices = QVector<unsigned>();
+}
 
-            // Switch depending on first element
-            if (tokens[0] == "v") {
-                parseVertex(tokens);
-            }
+qint64 Model::getMemoryUsage() {
+    return MemoryReport::bytes(vertices_indexed) + MemoryReport::bytes(normals_indexed) +
+           MemoryReport::bytes(textureCoords_indexed) + MemoryReport::bytes(indices) +
+           MemoryReport::bytes(vertices) + MemoryReport::bytes(normals) + MemoryReport::bytes(textureCoords) +
+           MemoryReport::bytes(normal_indices) + MemoryReport::bytes(texcoord_indices) +
+           MemoryReport::bytes(norm) + MemoryReport::bytes(tex);
+}
+
+void Model::parse(QTextStream &in) {
+    QString line;
+    QStringList tokens;
 
-            if (tokens[0] == "vn" ) {
-                parseNormal(tokens);
-            }
+    while(!in.atEnd()) {
+        line = in.readLine();
+        if (line.startsWith("#")) continue; // skip comments
 
-            if (tokens[0] == "vt" ) {
-                parseTexture(tokens);
-            }
+        tokens = line.split(" ", QString::SkipEmptyParts);
 
-            if (tokens[0] == "f" ) {
-                parseFace(tokens);
-            }
+        // Switch depending on first element
+        if (tokens[0] == "v") {
+            parseVertex(tokens);
         }
 
-        file.close();
+        if (tokens[0] == "vn" ) {
+            parseNormal(tokens);
+        }
 
-        // create an array version of the data
-        unpackIndexes();
+        if (tokens[0] == "vt" ) {
+            parseTexture(tokens);
+        }
 
-        // Align all vertex indices with the right normal/texturecoord indices
-        alignData();
+        if (tokens[0] == "f" ) {
+            parseFace(tokens);
+        }
     }
 }
 
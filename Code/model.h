@@ -2,6 +2,7 @@
 #define MODEL_H
 
 #include <QString>
+#include <QTextStream>
 #include <QStringList>
 #include <QVector>
 #include <QVector2D>
@@ -48,7 +49,13 @@ public:
 
     void unitize();
 
+    // Bytes held by the arrays above.
+    qint64 getMemoryUsage();
+
 private:
+    // The benchmarks time the loading stages separately.
+    friend struct ModelBenchmark;
+
     // A Vertex struct for Vertex comparisons.
     struct Vertex {
         QVector3D coord;
@@ -70,6 +77,7 @@ private:
     };
 
     // OBJ parsing
+    void parse(QTextStream &in);
     void parseVertex(QStringList tokens);
     void parseNormal(QStringList tokens);
     void parseTexture(QStringList tokens);
@@ -78,6 +86,7 @@ private:
     // Alignment of data
     void alignData();
     void unpackIndexes();
+    void releaseParseData();
 
     // Intermediate storage of values
     QVector<QVector3D> vertices_indexed;
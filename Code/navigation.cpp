@@ -0,0 +1,57 @@
+#include "navigation.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Iterations before giving up on a target that is nearly as fast as the ship.
+static const int maxIterations = 32;
+// Distance in world units the arrival may still move when the iteration stops.
+static const float tolerance = 0.01f;
+
+QVector3D Trajectory::position(double t) const {
+    if (t >= arrivalTime) return arrival;
+    if (t <= departureTime) return departure;
+    float f = static_cast<float>((t - departureTime) / (arrivalTime - departureTime));
+    return departure + (arrival - departure) * f;
+}
+
+/**
+ * @brief Navigator::intercept
+ *
+ * Each iteration moves the arrival time to when the ship would reach where
+ * the target is at the current estimate. The error shrinks by the ratio of
+ * the target's speed to the ship's, so most targets converge in a few steps.
+ * The arrival point stops stopDistance short of the target's center.
+ */
+bool Navigator::intercept(const Ephemeris &target, QVector3D from, double t, float velocity, float stopDistance, Trajectory &course) {
+    course = Trajectory();
+    if (velocity <= 0.0f) return false;
+
+    QVector3D at = target(t);
+    double arrival = t;
+    bool converged = false;
+    for (int i = 0; i != maxIterations; ++i) {
+        double next = t + std::max(0.0f, (at - from).length() - stopDistance) / velocity;
+        bool settled = std::abs(next - arrival) * velocity < tolerance;
+        arrival = next;
+        if (settled) {
+            converged = true;
+            break;
+        }
+        at = target(arrival);
+    }
+    if (!converged) {
+        // Head for where the target is now and plan again from there.
+        at = target(t);
+        arrival = t + std::max(0.0f, (at - from).length() - stopDistance) / velocity;
+    }
+
+    QVector3D offset = at - from;
+    float length = offset.length();
+    course.departure = from;
+    course.arrival = length > stopDistance ? at - offset * (stopDistance / length) : from;
+    course.departureTime = t;
+    course.arrivalTime = arrival;
+    course.intercepts = converged;
+    return converged;
+}
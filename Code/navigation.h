@@ -0,0 +1,42 @@
+#ifndef NAVIGATION_H
+#define NAVIGATION_H
+
+#include <QVector3D>
+#include <functional>
+
+/**
+ * A straight course at constant speed, from where a ship departs to where it
+ * meets its target. A course that does not intercept is a chase: it ends
+ * where the target was when it was planned.
+ */
+struct Trajectory {
+    QVector3D departure, arrival;
+    double departureTime = 0;
+    double arrivalTime = -1;
+    bool intercepts = false;
+
+    bool isValid() const {return arrivalTime >= departureTime;}
+    // Held at the ends outside [departureTime, arrivalTime].
+    QVector3D position(double t) const;
+};
+
+/**
+ * @brief The Navigator class
+ *
+ * Plans intercept courses against a target's ephemeris. A ship leaving from p
+ * at time t with velocity v meets the target at the time T where
+ * |target(T) - p| - stop = v (T - t). T is found by fixed-point iteration,
+ * starting from the target's current position; it converges while the
+ * target is slower than the ship.
+ */
+class Navigator {
+public:
+    // Position of the target at a time.
+    typedef std::function<QVector3D(double)> Ephemeris;
+
+    // Plans the course into course. When the iteration does not converge the
+    // course is a chase and false is returned.
+    static bool intercept(const Ephemeris &target, QVector3D from, double t, float velocity, float stopDistance, Trajectory &course);
+};
+
+#endif // NAVIGATION_H
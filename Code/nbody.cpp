@@ -0,0 +1,292 @@
+#include "nbody.h"
+#include "memoryreport.h"
+
+#include <QPair>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+// Spreads the low 21 bits of v so there are two zero bits between each.
+static quint64 spreadBits(quint64 v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffULL;
+    v = (v | v << 16) & 0x1f0000ff0000ffULL;
+    v = (v | v << 8)  & 0x100f00f00f00f00fULL;
+    v = (v | v << 4)  & 0x10c30c30c30c30c3ULL;
+    v = (v | v << 2)  & 0x1249249249249249ULL;
+    return v;
+}
+
+// Octant o of a cube: bit 2 is x, bit 1 is y, bit 0 is z, set means the upper half.
+static QVector3D octantCenter(QVector3D center, float half, int o) {
+    float q = half * 0.5f;
+    return center + QVector3D(o & 4 ? q : -q, o & 2 ? q : -q, o & 1 ? q : -q);
+}
+
+void NBody::clear() {
+    position.clear();
+    velocity.clear();
+    acceleration.clear();
+    thrust.clear();
+    mu.clear();
+    nodes.clear();
+    forcesValid = false;
+}
+
+int NBody::addBody(QVector3D p, QVector3D v, float m) {
+    position.push_back(p);
+    velocity.push_back(v);
+    acceleration.push_back(QVector3D());
+    thrust.push_back(QVector3D());
+    mu.push_back(m);
+    forcesValid = false;
+    return position.size() - 1;
+}
+
+/**
+ * @brief NBody::step
+ *
+ * Advances dt with kick-drift-kick. The accelerations of the end of a step are
+ * those of the start of the next, so there is one force pass per step.
+ */
+void NBody::step(float dt, ThreadPool *pool) {
+    if (!forcesValid) computeForces(pool);
+
+    QVector3D *p = position.data(), *v = velocity.data();
+    const QVector3D *a = acceleration.constData(), *t = thrust.constData();
+    float halfDt = dt * 0.5f;
+
+    pool->parallelFor(size(), 4096, [=](int begin, int end, int) {
+        for (int i = begin; i != end; ++i) {
+            v[i] += (a[i] + t[i]) * halfDt;
+            p[i] += v[i] * dt;
+        }
+    });
+
+    computeForces(pool);
+
+    pool->parallelFor(size(), 4096, [=](int begin, int end, int) {
+        for (int i = begin; i != end; ++i) {
+            v[i] += (a[i] + t[i]) * halfDt;
+        }
+    });
+}
+
+void NBody::computeForces(ThreadPool *pool) {
+    buildTree(pool);
+
+    QVector3D *a = acceleration.data();
+    pool->parallelFor(size(), 256, [=](int begin, int end, int) {
+        for (int i = begin; i != end; ++i) {
+            a[i] = accelerationAt(i);
+        }
+    });
+    forcesValid = true;
+}
+
+/**
+ * @brief NBody::buildTree
+ *
+ * Sorts the bodies with mass along a Morton curve and builds the octree from
+ * the sorted ranges. The ranges below splitDepth are independent, so they are
+ * sorted and built in parallel and the few nodes above them are added after.
+ */
+void NBody::buildTree(ThreadPool *pool) {
+    nodes.clear();
+    order.clear();
+    for (int i = 0; i != size(); ++i) {
+        if (mu[i] > 0.0f) order.push_back(i);
+    }
+    int n = order.size();
+    if (n == 0) return;
+
+    QVector3D lo = position[order[0]], hi = lo;
+    for (int i : order) {
+        QVector3D p = position[i];
+        lo = QVector3D(std::min(lo.x(), p.x()), std::min(lo.y(), p.y()), std::min(lo.z(), p.z()));
+        hi = QVector3D(std::max(hi.x(), p.x()), std::max(hi.y(), p.y()), std::max(hi.z(), p.z()));
+    }
+    QVector3D center = (lo + hi) * 0.5f;
+    float half = std::max({hi.x() - lo.x(), hi.y() - lo.y(), hi.z() - lo.z(), 1.0e-3f}) * 0.5f * 1.001f;
+    QVector3D corner = center - QVector3D(half, half, half);
+    float quantize = float(1 << maxDepth) / (2.0f * half);
+
+    QVector<QPair<quint64, int>> keys(n);
+    const QVector3D *p = position.constData();
+    const int *bodies = order.constData();
+    QPair<quint64, int> *k = keys.data();
+    pool->parallelFor(n, 4096, [=](int begin, int end, int) {
+        const quint64 top = (1u << maxDepth) - 1;
+        for (int i = begin; i != end; ++i) {
+            QVector3D q = (p[bodies[i]] - corner) * quantize;
+            quint64 x = std::min(top, quint64(std::max(0.0f, q.x())));
+            quint64 y = std::min(top, quint64(std::max(0.0f, q.y())));
+            quint64 z = std::min(top, quint64(std::max(0.0f, q.z())));
+            k[i] = qMakePair(spreadBits(x) << 2 | spreadBits(y) << 1 | spreadBits(z), bodies[i]);
+        }
+    });
+
+    // Counting sort on the top levels, one bucket per subtree.
+    const int buckets = 1 << (3 * splitDepth);
+    const int shift = 3 * (maxDepth - splitDepth);
+    QVector<int> start(buckets + 1, 0);
+    for (const QPair<quint64, int> &key : keys) {
+        start[int(key.first >> shift) + 1]++;
+    }
+    for (int b = 0; b != buckets; ++b) {
+        start[b + 1] += start[b];
+    }
+    QVector<QPair<quint64, int>> sorted(n);
+    QVector<int> fill = start;
+    for (const QPair<quint64, int> &key : keys) {
+        sorted[fill[int(key.first >> shift)]++] = key;
+    }
+
+    codes.resize(n);
+    QVector<QVector<Node>> subtrees(buckets);
+    pool->parallelFor(buckets, 1, [&](int begin, int end, int) {
+        for (int b = begin; b != end; ++b) {
+            std::sort(sorted.begin() + start[b], sorted.begin() + start[b + 1]);
+            for (int i = start[b]; i != start[b + 1]; ++i) {
+                codes[i] = sorted[i].first;
+                order[i] = sorted[i].second;
+            }
+
+            QVector3D c = center;
+            float h = half;
+            for (int d = 0; d != splitDepth; ++d) {
+                c = octantCenter(c, h, (b >> (3 * (splitDepth - 1 - d))) & 7);
+                h *= 0.5f;
+            }
+            buildNode(subtrees[b], start[b], start[b + 1], splitDepth, c, h);
+        }
+    });
+
+    // Levels above splitDepth, nodes are appended parent first like buildNode.
+    std::function<int(int, int, QVector3D, float)> assemble = [&](int depth, int prefix, QVector3D c, float h) {
+        if (depth == splitDepth) {
+            QVector<Node> &subtree = subtrees[prefix];
+            if (subtree.isEmpty()) return -1;
+            int offset = nodes.size();
+            for (Node node : subtree) {
+                for (int &child : node.child) {
+                    if (child >= 0) child += offset;
+                }
+                nodes.push_back(node);
+            }
+            return offset;
+        }
+
+        int index = nodes.size();
+        Node node = {c, h, QVector3D(), 0.0f, {-1, -1, -1, -1, -1, -1, -1, -1}, -1, 0};
+        nodes.push_back(node);
+        for (int o = 0; o != 8; ++o) {
+            int child = assemble(depth + 1, prefix * 8 + o, octantCenter(c, h, o), h * 0.5f);
+            nodes[index].child[o] = child;
+        }
+        summarize(nodes[index], nodes);
+        return index;
+    };
+    assemble(0, 0, center, half);
+}
+
+int NBody::buildNode(QVector<Node> &out, int first, int last, int depth, QVector3D center, float half) {
+    if (first == last) return -1;
+
+    int index = out.size();
+    Node node = {center, half, QVector3D(), 0.0f, {-1, -1, -1, -1, -1, -1, -1, -1}, -1, 0};
+
+    if (last - first <= leafSize || depth == maxDepth) {
+        node.first = first;
+        node.count = last - first;
+        for (int k = first; k != last; ++k) {
+            int j = order[k];
+            node.mu += mu[j];
+            node.com += position[j] * mu[j];
+        }
+        node.com /= node.mu;
+        out.push_back(node);
+        return index;
+    }
+
+    out.push_back(node);
+
+    // The range is sorted, so each octant is a consecutive run of codes.
+    int shift = 3 * (maxDepth - 1 - depth);
+    int begin = first;
+    for (int o = 0; o != 8; ++o) {
+        int end = begin;
+        while (end != last && int((codes[end] >> shift) & 7) == o) {
+            end++;
+        }
+        int child = buildNode(out, begin, end, depth + 1, octantCenter(center, half, o), half * 0.5f);
+        out[index].child[o] = child;
+        begin = end;
+    }
+
+    summarize(out[index], out);
+    return index;
+}
+
+void NBody::summarize(Node &node, QVector<Node> &in) {
+    node.mu = 0.0f;
+    node.com = QVector3D();
+    for (int child : node.child) {
+        if (child < 0) continue;
+        node.mu += in[child].mu;
+        node.com += in[child].com * in[child].mu;
+    }
+    if (node.mu > 0.0f) node.com /= node.mu;
+}
+
+QVector3D NBody::accelerationAt(int body) {
+    QVector3D a;
+    if (nodes.isEmpty()) return a;
+
+    const Node *tree = nodes.constData();
+    const QVector3D *pos = position.constData();
+    const float *m = mu.constData();
+    const int *sources = order.constData();
+
+    QVector3D p = pos[body];
+    float eps2 = softening * softening;
+    float theta2 = theta * theta;
+
+    int stack[8 * (maxDepth + 2)];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node &node = tree[stack[--top]];
+
+        if (node.count > 0) {
+            for (int k = node.first; k != node.first + node.count; ++k) {
+                int j = sources[k];
+                if (j == body) continue;
+                QVector3D d = pos[j] - p;
+                float r2 = d.lengthSquared() + eps2;
+                a += d * (m[j] / (r2 * std::sqrt(r2)));
+            }
+            continue;
+        }
+
+        QVector3D d = node.com - p;
+        float dist2 = d.lengthSquared();
+        float side = 2.0f * node.half;
+        if (side * side < theta2 * dist2) {
+            float r2 = dist2 + eps2;
+            a += d * (node.mu / (r2 * std::sqrt(r2)));
+        } else {
+            for (int child : node.child) {
+                if (child >= 0) stack[top++] = child;
+            }
+        }
+    }
+    return a;
+}
+
+qint64 NBody::getMemoryUsage() {
+    return MemoryReport::bytes(position) + MemoryReport::bytes(velocity) + MemoryReport::bytes(acceleration) +
+           MemoryReport::bytes(thrust) + MemoryReport::bytes(mu) + MemoryReport::bytes(codes) +
+           MemoryReport::bytes(order) + MemoryReport::bytes(nodes);
+}
@@ -0,0 +1,79 @@
+#ifndef NBODY_H
+#define NBODY_H
+
+#include <QVector>
+#include <QVector3D>
+
+#include "threadpool.h"
+
+/**
+ * @brief The NBody class
+ *
+ * Gravity simulation of point masses, integrated with kick-drift-kick leapfrog
+ * (symplectic, so orbits do not spiral in or out over long runs).
+ * Forces come from a Barnes-Hut octree over the bodies with mass: a cell that
+ * is small compared to its distance (size / distance < theta) acts as a single
+ * mass at its center of mass, which keeps a force pass at O(N log N).
+ *
+ * Bodies with mu = 0 are test particles: they feel gravity but do not attract,
+ * and can be steered with an extra acceleration (spaceship thrust).
+ */
+class NBody {
+public:
+    NBody() {}
+
+    void clear();
+    // mu is the gravitational parameter G*M of the body.
+    int addBody(QVector3D position, QVector3D velocity, float mu);
+    int size() {return position.size();}
+
+    void setTheta(float t) {theta = t;}
+    void setSoftening(float eps) {softening = eps;}
+
+    QVector3D getPosition(int i) {return position[i];}
+    QVector3D getVelocity(int i) {return velocity[i];}
+    void setThrust(int i, QVector3D a) {thrust[i] = a;}
+
+    void step(float dt, ThreadPool *pool);
+    // Builds the tree and fills the gravitational accelerations.
+    void computeForces(ThreadPool *pool);
+    QVector3D getAcceleration(int i) {return acceleration[i];}
+
+    qint64 getMemoryUsage();
+
+private:
+    struct Node {
+        QVector3D center;   // Center of the cube.
+        float half;         // Half the side of the cube.
+        QVector3D com;      // Center of mass.
+        float mu;           // Summed mass.
+        int child[8];       // -1 when empty.
+        int first, count;   // Range in order[] when a leaf.
+    };
+
+    // Leaves hold at most this many bodies.
+    const int leafSize = 8;
+    // Levels resolved by the 63-bit Morton codes.
+    static const int maxDepth = 21;
+    // Subtrees rooted at this depth are built in parallel.
+    static const int splitDepth = 2;
+
+    float theta = 0.5f;
+    float softening = 1.0f;
+    bool forcesValid = false;
+
+    QVector<QVector3D> position, velocity, acceleration, thrust;
+    QVector<float> mu;
+
+    // Bodies with mass sorted by Morton code, the tree refers to these.
+    QVector<quint64> codes;
+    QVector<int> order;
+    QVector<Node> nodes;
+
+    void buildTree(ThreadPool *pool);
+    int buildNode(QVector<Node> &out, int first, int last, int depth, QVector3D center, float half);
+    void summarize(Node &node, QVector<Node> &in);
+    QVector3D accelerationAt(int body);
+};
+
+#endif // NBODY_H
@@ -1,43 +1,59 @@
 #include "object.h"
+#include "assetpack.h"
 #include "utility"
-#include <QDebug>
+#include "log.h"
 #include <math.h>
 
-Object::Object(QString n, QString filename, QString texturefile) : model(filename) {
-    qDebug() << "Instantiated object " << filename;
+Object::Object(QString n, QString filename, QString texturefile) {
+    LOG(Log::ASSETS, Log::TRACE) << "Instantiated object " << filename;
+    modelFile = filename;
     texture = texturefile;
     name = n;
 }
 
+// Buffers and textures belong to the AssetCache.
 Object::~Object() {
-    delBuffers();
 }
 
-void Object::load() {
-    initializeOpenGLFunctions();
+qint64 Object::getStringBytes() {
+    return MemoryReport::bytes(name) + MemoryReport::bytes(texture) + MemoryReport::bytes(modelFile);
+}
 
-    genBuffers();
-    loadTextures();
-    loadMesh();
+QSharedPointer<Model> Object::getModel() {
+    if (!model) model = AssetCache::instance()->model(modelFile);
+    return model;
 }
 
-void Object::genBuffers() {
-    glGenBuffers(1, &meshVBO);
-    glGenBuffers(1, &meshVIO);
-    glGenVertexArrays(1, &meshVAO);
+/**
+ * @brief Object::load
+ *
+ * Takes mesh and texture from the cache, the first object to use them uploads them.
+ * Afterwards the model is only kept when setKeepModel asked for it.
+ */
+void Object::load() {
+    initializeOpenGLFunctions();
 
-    glGenTextures(1, &textureDiff);
+    AssetCache *cache = AssetCache::instance();
+    if (!cache->findMesh(getMeshKey(), mesh)) {
+        genBuffers();
+        loadMesh();
+        cache->addMesh(getMeshKey(), mesh);
+    }
+    // Virtual textures are streamed by the view's VirtualTextureCache.
+    if (!hasVirtualTexture() && !cache->findTexture(texture, textureDiff)) {
+        glGenTextures(1, &textureDiff);
+        cache->addTexture(texture, textureDiff, loadTextures());
+    }
+    if (!keepModel) model.reset();
 }
 
-void Object::delBuffers() {
-    glDeleteBuffers(1, &meshVBO);
-    glDeleteBuffers(1, &meshVIO);
-    glDeleteVertexArrays(1, &meshVAO);
-
-    glDeleteTextures(1, &textureDiff);
+void Object::genBuffers() {
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.vio);
+    glGenVertexArrays(1, &mesh.vao);
 }
 
-void Object::loadTexture(QString file, GLuint textureName) {
+qint64 Object::loadTexture(QString file, GLuint textureName) {
     // Set texture parameters.
     glBindTexture(GL_TEXTURE_2D, textureName);
 
@@ -47,42 +63,49 @@ void Object::loadTexture(QString file, GLuint textureName) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
     // Push image data to texture.
-    QImage image(file);
+    QImage image;
+    QByteArray bytes;
+    if (AssetPack::readAsset(file, bytes)) image.loadFromData(bytes);
     QVector<quint8> imageData = imageToBytes(image);
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width(), image.height(),
                  0, GL_RGBA, GL_UNSIGNED_BYTE, imageData.data());
+    return qint64(image.width()) * image.height() * 4;
 }
 
-void Object::loadTextures() {
-    loadTexture(texture, textureDiff);
+qint64 Object::loadTextures() {
+    return loadTexture(texture, textureDiff);
 }
 
-QVector<float> Object::getMeshData() {
-    return model.getVNTInterleaved_indexed();
+QVector<float> Object::getMeshData(Model &m) {
+    return m.getVNTInterleaved_indexed();
 }
 
 // Inverted normals
-QVector<float> Sun::getMeshData() {
-    return model.getVNinvTInterleaved_indexed();
+QVector<float> Sun::getMeshData(Model &m) {
+    return m.getVNinvTInterleaved_indexed();
 }
 
 void Object::loadMesh() {
-    qDebug() << "loadMesh";
-    model.unitize();
-    QVector<float> meshData = getMeshData();
+    LOG(Log::ASSETS, Log::DEBUG) << "loadMesh" << getMeshKey();
+    // The shared model stays as parsed, unitize a copy.
+    Model unitized = *getModel();
+    unitized.unitize();
+    QVector<float> meshData = getMeshData(unitized);
 
-    meshSize = model.getIndices().size();
+    mesh.size = unitized.getIndices().size();
+    mesh.vertexBytes = meshData.size() * qint64(sizeof(GLfloat));
+    mesh.indexBytes = mesh.size * qint64(sizeof(GLuint));
 
-    glBindVertexArray(meshVAO);
+    glBindVertexArray(mesh.vao);
 
-    glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
     // Write the data to the buffer
     glBufferData(GL_ARRAY_BUFFER, meshData.size() * sizeof(GL_FLOAT), meshData.data(), GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshVIO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vio);
     // Write the data to the buffer
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, model.getIndices().size()*sizeof(unsigned), model.getIndices().data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, unitized.getIndices().size()*sizeof(unsigned), unitized.getIndices().data(), GL_STATIC_DRAW);
 
     // Set vertex coordinates to location 0
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GL_FLOAT), reinterpret_cast<void*>(0));
@@ -108,8 +131,8 @@ void Object::draw() {
 //    glActiveTexture(GL_TEXTURE1);
 //    glBindTexture(GL_TEXTURE_2D, textureNorm);
 
-    glBindVertexArray(meshVAO);
-    glDrawElements(GL_TRIANGLES, meshSize, GL_UNSIGNED_INT, nullptr);
+    glBindVertexArray(mesh.vao);
+    glDrawElements(GL_TRIANGLES, mesh.size, GL_UNSIGNED_INT, nullptr);
 }
 
 void Object::rotate(float a) {
@@ -117,16 +140,28 @@ void Object::rotate(float a) {
 }
 
 
-void Planet::moveAround(float t) {
-    location.setX(rotateAround->getLocation().x() + distanceFrom * sin (t/orbitalPeriod));
-    location.setZ(rotateAround->getLocation().z() + distanceFrom * cos (t/orbitalPeriod));
+void Planet::setOrbit(const OrbitalElements &elements) {
+    orbit = Orbit(elements);
+    location = rotateAround->getLocation() + orbit.position(0.0);
+}
+
+void Planet::moveAround(double t) {
+    location = rotateAround->getLocation() + orbit.position(t);
 }
 
-void Spaceship::update(float t, float s) {
-    Q_UNUSED(t)
+void Spaceship::update(double t, float s) {
+    time = t;
+    if (course.isValid()) {
+        location = course.position(t);
+        // A chase ends where the target was, the next course starts from there.
+        if (!course.intercepts && t >= course.arrivalTime) clearCourse();
+        return;
+    }
     location += s*speed*(moveTo->getLocation() - location).normalized();
 }
 
 bool Spaceship::hasReachedDestination() {
-    return (this->distanceTo(moveTo) <= getScale() + moveTo->getScale()*1.5f + 5); // reached object
+    // An intercept arrives on time, the target is where the ephemeris put it.
+    if (course.isValid() && course.intercepts) return time >= course.arrivalTime;
+    return (this->distanceTo(moveTo) <= getArrivalDistance()); // reached object
 }
@@ -6,19 +6,17 @@
 #include <QImage>
 #include <QVector>
 #include <QMatrix4x4>
+#include <QtMath>
 
+#include "assetcache.h"
+#include "ephemeris.h"
 #include "model.h"
+#include "navigation.h"
 
 class Object : protected QOpenGLFunctions_3_3_Core {
-    // Buffers
-    GLuint meshVAO;
-    GLuint meshVBO;
-    GLuint meshVIO;
-    GLuint meshSize;
+    // Buffers, shared through the AssetCache.
+    AssetCache::Mesh mesh;
 public:
-    QMatrix4x4 meshTransform;
-    QMatrix3x3 meshNormalTransform;
-
     Object(QString name, QString modelfile, QString texturefile);
     ~Object();
     void load();
@@ -29,28 +27,49 @@ public:
     QString getName() {return name;}
     float getAngle() {return angle;}
     float getScale() {return scale;}
-
-    virtual void update(float t, float s) {Q_UNUSED(t) Q_UNUSED(s)}
+    // The model is parsed on first use and shared with other objects.
+    QSharedPointer<Model> getModel();
+    // Only before load().
+    void setModelFile (QString file) {modelFile = file;}
+    QString getTextureFile() {return texture;}
+    // A page file for the VirtualTextureCache, load() leaves it alone.
+    bool hasVirtualTexture() {return texture.endsWith(".vt");}
+    // Name and file names, for memory accounting.
+    qint64 getStringBytes();
+    // Keeps the CPU copy of the model after load(), for picking or physics.
+    void setKeepModel (bool keep) {keepModel = keep;}
+    // Radius of a sphere around the location that encloses the unitized mesh.
+    virtual float getBoundingRadius() {return scale * 1.7320508f;}
+
+    // t is the simulation time, s the speed times the frame time in 1/60 s.
+    virtual void update(double t, float s) {Q_UNUSED(t) Q_UNUSED(s)}
     void rotate(float a);
     float distanceTo (Object *obj) {return (location - obj->getLocation()).length();}
 protected:
     QVector3D location;
     QString texture;
-    Model model;
-    virtual QVector<float> getMeshData();
+    QString modelFile;
+    QSharedPointer<Model> model;
+    virtual QVector<float> getMeshData(Model &m);
+    // Objects whose getMeshData differs need their own key.
+    virtual QString getMeshKey() {return modelFile;}
     float scale = 1.0f;
 private:
+    // The benchmarks time imageToBytes without a GL context.
+    friend struct ObjectBenchmark;
+
     // Texture
-    GLuint textureDiff;
+    GLuint textureDiff = 0;
 
     QString name;
     float angle = 0;
+    bool keepModel = false;
 
     void genBuffers ();
-    void loadTexture (QString file, GLuint textureName);
-    void loadTextures ();
+    // Return the bytes uploaded.
+    qint64 loadTexture (QString file, GLuint textureName);
+    qint64 loadTextures ();
     void loadMesh ();
-    void delBuffers();
 
     // Useful utility method to convert image to bytes.
     QVector<quint8> imageToBytes(QImage image);
@@ -63,33 +82,45 @@ public:
         rotationPeriod = rotP;
     }
     float getRotationPeriod(){return rotationPeriod;}
+    float getBoundingRadius() override {return scale;}
 protected:
     float rotationPeriod;
 };
 
 class Sun : public Sphere {
 public:
-    Sun (QString n, float r, float rotP) : Sphere{n, ":/textures/sun.jpg", r, rotP} {
+    Sun (QString n, float r, float rotP, QString texturefile = ":/textures/sun.jpg") : Sphere{n, texturefile, r, rotP} {
         location = QVector3D();
     }
-    QVector<float> getMeshData() override;
-    void update(float t, float s) override {rotate(s*t*rotationPeriod);}
+    QVector<float> getMeshData(Model &m) override;
+    QString getMeshKey() override {return modelFile + "#inverted";}
+    void update(double t, float s) override {rotate(s*static_cast<float>(t)*rotationPeriod);}
 };
 
 class Planet : public Sphere {
 public:
+    // A circular orbit through angle t/orbP, so one revolution takes 2 pi orbP.
     Planet (QString n, QString texturefile, float r, float rotP, float df, float orbP, Sphere *rot) : Sphere{n, texturefile, r, rotP} {
         distanceFrom = df + r + rot->getScale();
         orbitalPeriod = orbP;
-        location = QVector3D(0,0,-distanceFrom);
         rotateAround = rot;
+        OrbitalElements circle;
+        circle.semiMajorAxis = distanceFrom;
+        circle.period = 2.0 * M_PI * orbitalPeriod;
+        setOrbit(circle);
     }
     float distanceFrom;
     float orbitalPeriod;
     Sphere *rotateAround;
 
-    void moveAround(float t);
-    void update(float t, float s) {Q_UNUSED(s) moveAround(t);}
+    // Replaces the circle, the semi-major axis is measured between the centers.
+    void setOrbit (const OrbitalElements &elements);
+    const Orbit &getOrbit () {return orbit;}
+
+    void moveAround(double t);
+    void update(double t, float s) override {Q_UNUSED(s) moveAround(t);}
+private:
+    Orbit orbit;
 };
 
 
@@ -97,6 +128,9 @@ class Spaceship : public Object {
     float speed = 0;
     Object *moveFrom;
     Object *moveTo;
+    // Followed instead of steering while valid, see SolarSystem::planCourses.
+    Trajectory course;
+    double time = 0;
 
 public:
     Spaceship (QString n, QString texturefile, float s, Object *mf, Object *mt) : Object{n, ":/models/cat.obj", texturefile} {
@@ -107,10 +141,18 @@ public:
         scale = 2.0f;
     }
     bool hasReachedDestination ();
-    void update(float t, float s) override;
+    void update(double t, float s) override;
     void setMoveFrom (Object *mf) {moveFrom = mf;}
-    void setMoveTo (Object *mt) {moveTo = mt;}
+    // A new destination needs a new course.
+    void setMoveTo (Object *mt) {moveTo = mt; course = Trajectory();}
     Object *getDestination () {return moveTo;}
+    float getSpeed () {return speed;}
+    // Distance from the destination's center that counts as arrived.
+    float getArrivalDistance () {return getScale() + moveTo->getScale()*1.5f + 5;}
+
+    void setCourse (const Trajectory &c) {course = c;}
+    const Trajectory &getCourse () {return course;}
+    void clearCourse () {course = Trajectory();}
 };
 
 #endif // OBJECT_H
@@ -0,0 +1,135 @@
+#include "occlusionculler.h"
+
+// Cube from -1 to 1, outward facing triangles.
+static const GLfloat boxVertices[] = {
+    -1, -1, -1,   1, -1, -1,   1,  1, -1,  -1,  1, -1,
+    -1, -1,  1,   1, -1,  1,   1,  1,  1,  -1,  1,  1
+};
+static const GLuint boxIndices[] = {
+    0, 2, 1,  0, 3, 2,      // -z
+    4, 5, 6,  4, 6, 7,      // +z
+    0, 1, 5,  0, 5, 4,      // -y
+    3, 6, 2,  3, 7, 6,      // +y
+    0, 4, 7,  0, 7, 3,      // -x
+    1, 2, 6,  1, 6, 5       // +x
+};
+
+OcclusionCuller::~OcclusionCuller() {
+    if (boxVAO == 0) return;
+    glDeleteQueries(queries.size(), queries.data());
+    glDeleteBuffers(1, &boxVBO);
+    glDeleteBuffers(1, &boxVIO);
+    glDeleteVertexArrays(1, &boxVAO);
+}
+
+void OcclusionCuller::initialize(ShaderCache *cache) {
+    initializeOpenGLFunctions();
+
+    glGenVertexArrays(1, &boxVAO);
+    glGenBuffers(1, &boxVBO);
+    glGenBuffers(1, &boxVIO);
+
+    glBindVertexArray(boxVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(boxVertices), boxVertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxVIO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(boxIndices), boxIndices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), reinterpret_cast<void*>(0));
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    cache->build(&program, ":/shaders/vertshader_box.glsl", ":/shaders/fragshader_box.glsl");
+    uniformBoxTransform = program.uniformLocation("boxTransform");
+}
+
+/**
+ * @brief OcclusionCuller::beginFrame
+ *
+ * Reads the queries the GPU has finished. A query that is still running keeps
+ * the visibility of its previous result.
+ */
+void OcclusionCuller::beginFrame(int objects) {
+    while (queries.size() < objects) {
+        GLuint query;
+        glGenQueries(1, &query);
+        queries.push_back(query);
+        pending.push_back(false);
+        visible.push_back(true);
+        issued.push_back(0);
+        boxes.push_back(QVector4D());
+    }
+
+    occludedCount = 0;
+    if (!enabled) return;
+
+    for (int i = 0; i != objects; ++i) {
+        if (pending[i]) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint samples = 0;
+                glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT, &samples);
+                if (visible[i] != (samples != 0) || issued[i] != round) changed = true;
+                visible[i] = samples != 0;
+                pending[i] = false;
+                inFlight--;
+            }
+        }
+        if (!visible[i]) occludedCount++;
+    }
+}
+
+void OcclusionCuller::issueQueries(const QVector<Object*> &objects, const QMatrix4x4 &viewProjection,
+                                   QVector3D eye, float nearPlane) {
+    if (!enabled) return;
+
+    // A newly visible object hides others, a moved one uncovers them.
+    bool stale = changed || viewProjection != lastViewProjection;
+    for (int i = 0; i != objects.size(); ++i) {
+        QVector4D box(objects[i]->getLocation(), objects[i]->getBoundingRadius());
+        if (box != boxes[i]) {
+            boxes[i] = box;
+            stale = true;
+        }
+    }
+    if (!stale) return;
+    lastViewProjection = viewProjection;
+    changed = false;
+    round++;
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    program.bind();
+    glBindVertexArray(boxVAO);
+
+    for (int i = 0; i != objects.size(); ++i) {
+        // A query still in flight cannot be restarted.
+        if (pending[i]) continue;
+
+        Object *o = objects[i];
+        float r = o->getBoundingRadius();
+        // The near plane would cut the box open, so its samples mean nothing.
+        if (r <= 0.0f || (o->getLocation() - eye).length() < r * 1.7320508f + nearPlane) {
+            visible[i] = true;
+            continue;
+        }
+
+        QMatrix4x4 transform = viewProjection;
+        transform.translate(o->getLocation());
+        transform.scale(r);
+        glUniformMatrix4fv(uniformBoxTransform, 1, GL_FALSE, transform.data());
+
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, queries[i]);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        pending[i] = true;
+        issued[i] = round;
+        inFlight++;
+    }
+
+    glBindVertexArray(0);
+    program.release();
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
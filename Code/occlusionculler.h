@@ -0,0 +1,78 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QVector>
+#include <QVector3D>
+#include <QVector4D>
+
+#include "object.h"
+#include "shadercache.h"
+
+/**
+ * @brief The OcclusionCuller class
+ *
+ * Hardware occlusion queries on bounding boxes. After the visible objects are
+ * drawn, the box around the bounding sphere of every object is rasterized
+ * against the depth buffer inside a GL_ANY_SAMPLES_PASSED query, without color
+ * or depth writes. The results are read at the start of a later frame, only
+ * once the GPU reports them available, so the CPU never waits on a query.
+ *
+ * An object that becomes visible therefore shows up one frame late. Objects
+ * with the camera inside their box are always visible.
+ *
+ * While the view and the boxes stay the same and the last results changed
+ * nothing, no new queries are issued, so a still scene settles. A result from
+ * before the last change counts as a change and is tested again.
+ */
+class OcclusionCuller : protected QOpenGLFunctions_3_3_Core {
+public:
+    OcclusionCuller() {}
+    ~OcclusionCuller();
+
+    // Requires a current context.
+    void initialize(ShaderCache *cache);
+
+    // Collects the query results that are ready, for objects.size() objects.
+    void beginFrame(int objects);
+    bool isVisible(int object) {return !enabled || visible[object];}
+
+    // Tests the objects against the current depth buffer for a later frame.
+    void issueQueries(const QVector<Object*> &objects, const QMatrix4x4 &viewProjection,
+                      QVector3D eye, float nearPlane);
+
+    // Re-enabled culling starts from all visible, old results are stale.
+    void setEnabled(bool e) {enabled = e; visible.fill(true); changed = true;}
+    bool isEnabled() {return enabled;}
+    // Results a later frame still has to read and apply.
+    bool hasQueriesInFlight() {return enabled && inFlight > 0;}
+    // Objects skipped this frame.
+    int getOccludedCount() {return occludedCount;}
+
+private:
+    bool enabled = true;
+    int occludedCount = 0;
+
+    QVector<GLuint> queries;
+    QVector<bool> pending;
+    QVector<bool> visible;
+    int inFlight = 0;
+
+    // What the last queries were issued for: the round, and per object the
+    // round of its query and its box as center and radius.
+    QMatrix4x4 lastViewProjection;
+    quint32 round = 0;
+    QVector<quint32> issued;
+    QVector<QVector4D> boxes;
+    bool changed = true;
+
+    GLuint boxVAO = 0;
+    GLuint boxVBO;
+    GLuint boxVIO;
+    QOpenGLShaderProgram program;
+    GLint uniformBoxTransform;
+};
+
+#endif // OCCLUSIONCULLER_H
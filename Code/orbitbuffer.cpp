@@ -0,0 +1,103 @@
+#include "orbitbuffer.h"
+#include "log.h"
+
+#include <QHash>
+#include <QtMath>
+#include <cmath>
+
+bool OrbitBuffer::defaultEnabled = false;
+
+// Time from the epoch after which it moves. A moon turns about 30 times in
+// it, which float time still resolves to 1e-5 radians.
+static const double maxEpochAge = 64.0;
+
+OrbitBuffer::~OrbitBuffer() {
+    if (!initialized) return;
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &buffer);
+}
+
+void OrbitBuffer::initialize() {
+    initializeOpenGLFunctions();
+    glGenBuffers(1, &buffer);
+    glGenTextures(1, &texture);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STATIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    bufferBytes = 16;
+    initialized = true;
+}
+
+/**
+ * @brief OrbitBuffer::pack
+ *
+ * Planets orbit their parent. Everything else stays where it is at the epoch;
+ * in analytic mode the sun does not move, and the eyes and spaceships are
+ * drawn with their matrices anyway.
+ */
+QVector<bool> OrbitBuffer::pack(const QVector<Object*> &objects, double epoch, QVector<float> &data) {
+    QHash<Object*, int> index;
+    index.reserve(objects.size());
+    for (int i = 0; i != objects.size(); ++i) {
+        index.insert(objects[i], i);
+    }
+
+    QVector<bool> orbits(objects.size(), false);
+    data.resize(objects.size() * texelsPerObject * 4);
+    float *d = data.data();
+    for (int i = 0; i != objects.size(); ++i, d += texelsPerObject * 4) {
+        Object *o = objects[i];
+        Planet *planet = dynamic_cast<Planet*>(o);
+        int parent = planet ? index.value(planet->rotateAround, -1) : -1;
+        if (planet && parent >= 0) {
+            const Orbit &orbit = planet->getOrbit();
+            const OrbitalElements &elements = orbit.getElements();
+            QVector3D p = orbit.getPeriapsisAxis(), q = orbit.getQuarterAxis();
+            d[0] = static_cast<float>(elements.semiMajorAxis);
+            d[1] = static_cast<float>(elements.eccentricity);
+            d[2] = static_cast<float>(std::remainder(orbit.meanAnomaly(epoch), 2.0 * M_PI));
+            d[3] = static_cast<float>(2.0 * M_PI / elements.period);
+            d[4] = p.x(); d[5] = p.y(); d[6] = p.z();
+            d[7] = static_cast<float>(orbit.getSemiMinorAxis());
+            d[8] = q.x(); d[9] = q.y(); d[10] = q.z();
+            d[11] = static_cast<float>(parent);
+            orbits[i] = true;
+        } else {
+            QVector3D location = o->getLocation();
+            d[0] = 1.0f; d[1] = 0.0f; d[2] = 0.0f; d[3] = 0.0f;
+            d[4] = location.x(); d[5] = location.y(); d[6] = location.z(); d[7] = 0.0f;
+            d[8] = 0.0f; d[9] = 0.0f; d[10] = 0.0f; d[11] = -1.0f;
+        }
+        float radians = qDegreesToRadians(o->getAngle());
+        d[12] = std::cos(radians);
+        d[13] = std::sin(radians);
+        d[14] = o->getScale();
+        d[15] = 0.0f;
+    }
+    return orbits;
+}
+
+void OrbitBuffer::update(SolarSystem *ss, double t) {
+    bool wasActive = active;
+    active = initialized && enabled && ss->getSimulationMode() == SolarSystem::ANALYTIC;
+    if (!active) return;
+
+    // The sun may have been moved by gravity while the orbits were inactive.
+    if (!wasActive || ss->objects.size() != objectCount || std::abs(t - epoch) > maxEpochAge) {
+        QVector<float> data;
+        orbiting = pack(ss->objects, t, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        bufferBytes = qMax<qint64>(data.size() * qint64(sizeof(float)), 16);
+        glBufferData(GL_TEXTURE_BUFFER, bufferBytes, data.isEmpty() ? nullptr : data.constData(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        epoch = t;
+        objectCount = ss->objects.size();
+        uploads++;
+        LOG(Log::RENDER, Log::DEBUG) << "Orbits uploaded for" << objectCount << "objects at epoch" << epoch;
+    }
+    time = static_cast<float>(t - epoch);
+}
@@ -0,0 +1,76 @@
+#ifndef ORBITBUFFER_H
+#define ORBITBUFFER_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QVector>
+
+#include "object.h"
+#include "solarsystem.h"
+
+/**
+ * @brief The OrbitBuffer class
+ *
+ * The analytic orbits in a buffer texture, so the Phong vertex shader places
+ * the planets itself from a single time uniform instead of a model and normal
+ * matrix per draw.
+ *
+ * Every object has four RGBA32F texels:
+ *   semi-major axis, eccentricity, mean anomaly at the epoch, mean motion;
+ *   periapsis axis, semi-minor axis;
+ *   quarter axis, index of the parent object or -1;
+ *   cosine and sine of the spin angle, scale, 0.
+ * A body that does not orbit has mean motion 0, semi-major axis 1 and its
+ * position as periapsis axis, so the same formula puts it there.
+ *
+ * The shader's time is relative to an epoch, and the mean anomalies are
+ * reduced at the epoch in double precision, so float time in the shader stays
+ * small. The buffer is only uploaded again when the time gets too far from the
+ * epoch, when the objects change or when the orbits become active again.
+ */
+class OrbitBuffer : protected QOpenGLFunctions_3_3_Core {
+public:
+    static const int texelsPerObject = 4;
+
+    OrbitBuffer() {}
+    ~OrbitBuffer();
+
+    // Requires a current context.
+    void initialize();
+
+    // Only analytic orbits are a function of time, gravity falls back to the matrices.
+    void setEnabled(bool e) {enabled = e;}
+    bool isEnabled() {return enabled;}
+    static void setDefaultEnabled(bool e) {defaultEnabled = e;}
+    bool isActive() {return active;}
+
+    // Call after simulating to time t, uploads when the epoch has to move.
+    void update(SolarSystem *ss, double t);
+    // Whether the shader places objects[object], valid while active.
+    bool isOrbiting(int object) {return active && orbiting.value(object);}
+    // Time since the epoch, for the shader.
+    float getTime() {return time;}
+    GLuint getTexture() {return texture;}
+    int getUploads() {return uploads;}
+    qint64 getMemoryUsage() {return bufferBytes;}
+
+    // The texels of objects at time epoch. Returns per object whether it orbits.
+    static QVector<bool> pack(const QVector<Object*> &objects, double epoch, QVector<float> &data);
+
+private:
+    bool initialized = false;
+    bool enabled = defaultEnabled;
+    bool active = false;
+    static bool defaultEnabled;
+
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    qint64 bufferBytes = 0;
+
+    double epoch = 0;
+    float time = 0;
+    int objectCount = 0;
+    int uploads = 0;
+    QVector<bool> orbiting;
+};
+
+#endif // ORBITBUFFER_H
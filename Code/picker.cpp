@@ -0,0 +1,92 @@
+#include "picker.h"
+#include "log.h"
+
+#include <QElapsedTimer>
+
+/**
+ * @brief Picker::update
+ *
+ * Moves the sphere hierarchy to the last simulation step. A refit keeps the
+ * splits of the build, which grow loose as the bodies drift apart along
+ * their orbits, so the hierarchy is rebuilt every rebuildSteps steps.
+ */
+void Picker::update(SolarSystem *ss) {
+    quint64 step = ss->getSteps();
+    if (built && bodies.size() == ss->objects.size() && step == refitAt) return;
+
+    centers.resize(ss->objects.size());
+    radii.resize(ss->objects.size());
+    for (int i = 0; i != ss->objects.size(); ++i) {
+        centers[i] = ss->objects[i]->getLocation();
+        radii[i] = ss->objects[i]->getBoundingRadius();
+    }
+    if (!built || bodies.size() != centers.size() || step - builtAt >= rebuildSteps) {
+        bodies.build(centers, radii);
+        builtAt = step;
+        built = true;
+    } else {
+        bodies.refit(centers, radii);
+    }
+    refitAt = step;
+}
+
+// The triangles of objects that do not fill their bounding sphere.
+TriangleBVH *Picker::meshOf(Object *o) {
+    if (dynamic_cast<Sphere*>(o)) return nullptr;
+    QSharedPointer<Model> model = o->getModel();
+    if (!model) return nullptr;
+
+    auto found = meshes.find(model.data());
+    if (found != meshes.end()) return &found->triangles;
+
+    // Drawn unitized, see Object::loadMesh.
+    Model unitized = *model;
+    unitized.unitize();
+    Mesh &mesh = meshes[model.data()];
+    mesh.model = model;
+    mesh.triangles.build(unitized.getVertices_indexed(), unitized.getIndices());
+    LOG(Log::INPUT, Log::DEBUG) << "Built picking hierarchy of" << mesh.triangles.size() << "triangles";
+    return &mesh.triangles;
+}
+
+Picker::Hit Picker::pick(SolarSystem *ss, QVector3D origin, QVector3D direction) {
+    QElapsedTimer timer;
+    timer.start();
+    update(ss);
+    updateTime = timer.nsecsElapsed() / 1.0e6f;
+
+    timer.start();
+    direction.normalize();
+    Hit hit;
+    hit.object = bodies.intersect(origin, direction, hit.distance, [&](int object, float distance) {
+        if (!refineMeshes) return distance;
+        TriangleBVH *mesh = meshOf(ss->objects[object]);
+        if (!mesh) return distance;
+        // In model space the direction is scaled with the model, the distances stay the same.
+        QMatrix4x4 inverse = ss->getModelTransform(object).inverted();
+        float exact;
+        if (mesh->intersect(inverse.map(origin), inverse.mapVector(direction), exact) < 0) return -1.0f;
+        return exact;
+    });
+    queryTime = timer.nsecsElapsed() / 1.0e6f;
+    return hit;
+}
+
+void Picker::viewRay(const QMatrix4x4 &projection, const QMatrix4x4 &view, QPointF ndc,
+                     QVector3D &origin, QVector3D &direction) {
+    QMatrix4x4 inverse = (projection * view).inverted();
+    QVector4D nearPoint = inverse * QVector4D(ndc.x(), ndc.y(), -1.0f, 1.0f);
+    QVector4D farPoint = inverse * QVector4D(ndc.x(), ndc.y(), 1.0f, 1.0f);
+    origin = nearPoint.toVector3DAffine();
+    direction = (farPoint.toVector3DAffine() - origin).normalized();
+}
+
+void Picker::reportMemory(MemoryReport &report) {
+    qint64 triangles = 0;
+    for (Mesh &mesh : meshes) {
+        triangles += mesh.triangles.getMemoryUsage();
+    }
+    report.add(MemoryReport::CPU, "picking", "bodies",
+               bodies.getMemoryUsage() + MemoryReport::bytes(centers) + MemoryReport::bytes(radii));
+    report.add(MemoryReport::CPU, "picking", "meshes", triangles);
+}
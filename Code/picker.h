@@ -0,0 +1,74 @@
+#ifndef PICKER_H
+#define PICKER_H
+
+#include <QHash>
+#include <QMatrix4x4>
+#include <QPointF>
+#include <QSharedPointer>
+#include <QVector3D>
+
+#include "bvh.h"
+#include "memoryreport.h"
+#include "solarsystem.h"
+
+/**
+ * @brief The Picker class
+ *
+ * Finds the object of a SolarSystem under a ray. A SphereBVH over the
+ * bounding spheres finds the candidates nearest first; objects that are not
+ * spheres, the spaceships, are then tested against a TriangleBVH of their
+ * unitized mesh in their model space, so a click next to a ship misses it.
+ *
+ * The sphere hierarchy is refit only when the simulation stepped since the
+ * last pick and rebuilt when the object count changed or after many steps,
+ * so repeated picks in a paused scene only pay for the query.
+ */
+class Picker {
+public:
+    struct Hit {
+        int object = -1;        // Index in SolarSystem::objects, -1 for none.
+        float distance = 0;     // Along the ray from its origin.
+    };
+
+    Picker() {}
+
+    // Direction need not be normalized.
+    Hit pick(SolarSystem *ss, QVector3D origin, QVector3D direction);
+    // Ray from the near plane through ndc, in normalized device coordinates of a view.
+    static void viewRay(const QMatrix4x4 &projection, const QMatrix4x4 &view, QPointF ndc,
+                        QVector3D &origin, QVector3D &direction);
+
+    void setRefineMeshes(bool refine) {refineMeshes = refine;}
+    bool getRefineMeshes() {return refineMeshes;}
+
+    // Milliseconds of the last pick spent on the query and on the refit or build before it.
+    float getQueryTime() {return queryTime;}
+    float getUpdateTime() {return updateTime;}
+
+    void reportMemory(MemoryReport &report);
+
+private:
+    // Simulation steps after which the hierarchy is rebuilt instead of refit.
+    static const quint64 rebuildSteps = 1000;
+
+    struct Mesh {
+        QSharedPointer<Model> model;
+        TriangleBVH triangles;
+    };
+
+    bool refineMeshes = true;
+    SphereBVH bodies;
+    quint64 builtAt = 0, refitAt = 0;
+    bool built = false;
+    QVector<QVector3D> centers;
+    QVector<float> radii;
+    // Keyed by the shared model, which the entry keeps alive.
+    QHash<Model*, Mesh> meshes;
+
+    float queryTime = 0, updateTime = 0;
+
+    void update(SolarSystem *ss);
+    TriangleBVH *meshOf(Object *o);
+};
+
+#endif // PICKER_H
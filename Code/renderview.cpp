@@ -0,0 +1,108 @@
+#include "renderview.h"
+#include "threadpool.h"
+
+RenderView::~RenderView() {
+    if (!initialized) return;
+    glDeleteTextures(3, clusterTextures);
+    glDeleteBuffers(3, clusterBuffers);
+}
+
+void RenderView::initialize(ShaderCache *cache) {
+    initializeOpenGLFunctions();
+    static const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+
+    glGenBuffers(3, clusterBuffers);
+    glGenTextures(3, clusterTextures);
+    for (int i = 0; i != 3; ++i) {
+        glBindBuffer(GL_TEXTURE_BUFFER, clusterBuffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, clusterTextures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], clusterBuffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    occlusionCuller.initialize(cache);
+    initialized = true;
+}
+
+QRect RenderView::getViewport(int width, int height) {
+    int x = qRound(area.x() * width), y = qRound(area.y() * height);
+    int r = qRound(area.right() * width), t = qRound(area.bottom() * height);
+    return QRect(x, y, qMax(1, r - x), qMax(1, t - y));
+}
+
+/**
+ * @brief RenderView::update
+ *
+ * The camera sits behind lookingFrom on the line from lookingAt, radius times
+ * its size away and rotated up by angle degrees.
+ */
+void RenderView::update(SolarSystem *ss, float angle, float radius, QRect viewport) {
+    Object *from = ss->objects[lookingFrom];
+    QVector3D target = ss->objects[lookingAt]->getLocation();
+    QVector3D dir = target - from->getLocation();
+    if (dir == QVector3D()) dir = QVector3D(0,0,1);
+    QVector3D pos = -dir.normalized() * radius * from->getScale();
+    QVector3D r = QVector3D::crossProduct(dir, QVector3D(0,1,0));
+    QMatrix4x4 rot = QMatrix4x4();
+    rot.rotate(angle, r);
+    camera.setPosition(rot * pos + from->getLocation());
+
+    viewTransform.setToIdentity();
+    viewTransform.lookAt(camera.getPosition(), target, QVector3D(0,1,0));
+
+    aspectRatio = static_cast<float>(viewport.width()) / static_cast<float>(viewport.height());
+    projectionTransform.setToIdentity();
+    projectionTransform.perspective(camera.getFOV(), aspectRatio, camera.getNearPlane(), camera.getFarPlane());
+
+    // Planes of the frustum from the rows of the view projection matrix.
+    QMatrix4x4 m = projectionTransform * viewTransform;
+    for (int i = 0; i != 3; ++i) {
+        frustum[2 * i] = m.row(3) + m.row(i);
+        frustum[2 * i + 1] = m.row(3) - m.row(i);
+    }
+    for (QVector4D &plane : frustum) {
+        plane /= plane.toVector3D().length();
+    }
+}
+
+bool RenderView::isInFrustum(QVector3D center, float radius) {
+    for (const QVector4D &plane : frustum) {
+        if (QVector3D::dotProduct(plane.toVector3D(), center) + plane.w() < -radius) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief RenderView::updateLightClusters
+ *
+ * Buffers are never left empty, a buffer texture of size zero is not valid on
+ * all drivers.
+ */
+void RenderView::updateLightClusters(const QVector<PointLight> &lights) {
+    lightClusters.build(lights, viewTransform, camera.getFOV(), aspectRatio,
+                        camera.getNearPlane(), camera.getFarPlane(), ThreadPool::instance());
+    statistics.lights = lightClusters.getVisibleLights();
+
+    const void *data[3] = {
+        lightClusters.getLightData().constData(),
+        lightClusters.getClusterData().constData(),
+        lightClusters.getLightIndices().constData()
+    };
+    GLsizeiptr sizes[3] = {
+        lightClusters.getLightData().size() * GLsizeiptr(sizeof(float)),
+        lightClusters.getClusterData().size() * GLsizeiptr(sizeof(quint32)),
+        lightClusters.getLightIndices().size() * GLsizeiptr(sizeof(quint32))
+    };
+    for (int i = 0; i != 3; ++i) {
+        glBindBuffer(GL_TEXTURE_BUFFER, clusterBuffers[i]);
+        if (sizes[i] > 0) {
+            glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+        } else {
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        }
+        clusterBufferBytes[i] = qMax<GLsizeiptr>(sizes[i], 16);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
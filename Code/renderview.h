@@ -0,0 +1,92 @@
+#ifndef RENDERVIEW_H
+#define RENDERVIEW_H
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QRect>
+#include <QRectF>
+#include <QVector>
+#include <QVector3D>
+#include <QVector4D>
+
+#include "camera.h"
+#include "lightclusters.h"
+#include "occlusionculler.h"
+#include "shadercache.h"
+#include "solarsystem.h"
+
+/**
+ * @brief The RenderView class
+ *
+ * One camera looking from one body at another, drawn into its own part of the
+ * widget. Everything that depends on the camera lives here: the transforms, a
+ * frustum for culling, the light clusters with their buffer textures and the
+ * occlusion queries. The simulation, the model transforms, the gathered lights
+ * and the sun's shadow map are shared by all views of a frame.
+ */
+class RenderView : protected QOpenGLFunctions_3_3_Core {
+public:
+    struct Statistics {
+        int drawn = 0;      // Objects drawn.
+        int outside = 0;    // Skipped by the frustum test.
+        int occluded = 0;   // Skipped by the occlusion queries.
+        int lights = 0;     // Point lights in the frustum.
+    };
+
+    RenderView() {}
+    ~RenderView();
+
+    // Requires a current context.
+    void initialize(ShaderCache *cache);
+
+    // Indices in SolarSystem::objects.
+    void setLookingFrom(int object) {lookingFrom = object;}
+    void setLookingAt(int object) {lookingAt = object;}
+    int getLookingFrom() {return lookingFrom;}
+    int getLookingAt() {return lookingAt;}
+
+    // Part of the widget in fractions of its size, from the bottom left like glViewport.
+    void setArea(QRectF a) {area = a;}
+    QRectF getArea() {return area;}
+    // The area in pixels of a framebuffer of width by height.
+    QRect getViewport(int width, int height);
+
+    // Places the camera for this frame, angle and radius as set by the sliders.
+    void update(SolarSystem *ss, float angle, float radius, QRect viewport);
+    bool isInFrustum(QVector3D center, float radius);
+
+    // Bins the lights for this camera and streams them to the buffer textures.
+    void updateLightClusters(const QVector<PointLight> &lights);
+    GLuint getClusterTexture(int i) {return clusterTextures[i];}
+    LightClusters &getLightClusters() {return lightClusters;}
+    qint64 getClusterBufferBytes(int i) {return clusterBufferBytes[i];}
+
+    Camera &getCamera() {return camera;}
+    const QMatrix4x4 &getViewTransform() {return viewTransform;}
+    const QMatrix4x4 &getProjectionTransform() {return projectionTransform;}
+    OcclusionCuller &getOcclusionCuller() {return occlusionCuller;}
+    Statistics &getStatistics() {return statistics;}
+
+private:
+    int lookingFrom = 0, lookingAt = 0;
+    QRectF area = QRectF(0, 0, 1, 1);
+    float aspectRatio = 1.0f;
+
+    Camera camera;
+    QMatrix4x4 viewTransform;
+    QMatrix4x4 projectionTransform;
+    // Inward facing planes, xyz normalized so w is the distance.
+    QVector4D frustum[6];
+
+    // Light data, cluster ranges and light indices, see MainView::updateViewUniforms.
+    LightClusters lightClusters;
+    GLuint clusterBuffers[3];
+    GLuint clusterTextures[3];
+    GLsizeiptr clusterBufferBytes[3] = {0, 0, 0};
+    bool initialized = false;
+
+    OcclusionCuller occlusionCuller;
+    Statistics statistics;
+};
+
+#endif // RENDERVIEW_H
@@ -0,0 +1,217 @@
+#include "replay.h"
+#include "log.h"
+
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+static const quint32 replayMagic = 0x594c5052;  // "RPLY"
+static const quint32 replayVersion = 1;
+static const int headerSize = 16;
+static const int recordSize = 12;
+// Records are written to the file in blocks of about this size.
+static const int blockSize = 65536;
+
+QString Replay::defaultRecordFile;
+QString Replay::defaultPlayFile;
+QString Replay::defaultTimingFile;
+quint32 Replay::defaultSeed = 0;
+
+Replay::~Replay() {
+    stop();
+}
+
+void Replay::setDefaults(QString recordFile, QString playFile, QString timingFile, quint32 seed) {
+    defaultRecordFile = recordFile;
+    defaultPlayFile = playFile;
+    defaultTimingFile = timingFile;
+    defaultSeed = seed;
+}
+
+bool Replay::startDefault() {
+    bool ok = true;
+    if (!defaultPlayFile.isEmpty()) {
+        ok = play(defaultPlayFile);
+    } else if (!defaultRecordFile.isEmpty()) {
+        ok = record(defaultRecordFile, defaultSeed);
+    }
+    if (!ok) {
+        LOG(Log::GENERAL, Log::CRITICAL) << error;
+        return false;
+    }
+    return defaultTimingFile.isEmpty() || writeTimings(defaultTimingFile);
+}
+
+bool Replay::readSeed(QString name, quint32 &seed, QString *error) {
+    QFile in(name);
+    uchar header[headerSize];
+    if (!in.open(QIODevice::ReadOnly) || in.read(reinterpret_cast<char*>(header), headerSize) != headerSize ||
+            qFromLittleEndian<quint32>(header) != replayMagic ||
+            qFromLittleEndian<quint32>(header + 4) != replayVersion) {
+        if (error) *error = QString("%1 is not a version %2 replay").arg(name).arg(replayVersion);
+        return false;
+    }
+    seed = qFromLittleEndian<quint32>(header + 8);
+    return true;
+}
+
+bool Replay::record(QString name, quint32 seed) {
+    stop();
+    file.setFileName(name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = QString("Cannot write %1: %2").arg(name, file.errorString());
+        return false;
+    }
+    uchar header[headerSize] = {};
+    qToLittleEndian<quint32>(replayMagic, header);
+    qToLittleEndian<quint32>(replayVersion, header + 4);
+    qToLittleEndian<quint32>(seed, header + 8);
+    file.write(reinterpret_cast<const char*>(header), headerSize);
+
+    mode = RECORD;
+    frame = 0;
+    LOG(Log::GENERAL, Log::INFO) << "Recording to" << name << "with seed" << seed;
+    return true;
+}
+
+bool Replay::play(QString name) {
+    stop();
+    quint32 seed;
+    if (!readSeed(name, seed, &error)) return false;
+    QFile in(name);
+    if (!in.open(QIODevice::ReadOnly)) {
+        error = QString("Cannot open %1: %2").arg(name, in.errorString());
+        return false;
+    }
+    // Even an hour is under a megabyte, read it in one go.
+    data = in.readAll();
+    offset = headerSize;
+
+    mode = PLAY;
+    frame = 0;
+    LOG(Log::GENERAL, Log::INFO) << "Replaying" << name << ":" << (data.size() - headerSize) / recordSize << "records";
+    return true;
+}
+
+void Replay::stop() {
+    if (mode == RECORD) {
+        flush();
+        file.close();
+        LOG(Log::GENERAL, Log::INFO) << "Recorded" << frame << "frames";
+    }
+    if (mode != OFF || timingFile.isOpen()) logSummary();
+    if (timingFile.isOpen()) {
+        timings.flush();
+        timingFile.close();
+    }
+    mode = OFF;
+    data.clear();
+    paintTimes.clear();
+}
+
+bool Replay::writeTimings(QString name) {
+    timingFile.setFileName(name);
+    if (!timingFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        LOG(Log::GENERAL, Log::WARNING) << "Cannot write timings" << name;
+        return false;
+    }
+    timings.setDevice(&timingFile);
+    timings << "frame,time_step,paint_ms,gpu_ms,drawn\n";
+    return true;
+}
+
+void Replay::add(ReplayEvent::Type type, float number) {
+    if (mode != RECORD) return;
+    ReplayEvent event;
+    event.type = type;
+    event.frame = frame;
+    event.number = number;
+    write(event);
+}
+
+void Replay::add(ReplayEvent::Type type, qint32 integer) {
+    if (mode != RECORD) return;
+    ReplayEvent event;
+    event.type = type;
+    event.frame = frame;
+    event.integer = integer;
+    write(event);
+}
+
+bool Replay::beginFrame(float &time, QVector<ReplayEvent> &events) {
+    events.clear();
+    if (mode == RECORD) {
+        add(ReplayEvent::FRAME, time);
+    } else if (mode == PLAY) {
+        // Events come before the frame record they belong to.
+        ReplayEvent event;
+        while (true) {
+            if (!read(event)) return false;
+            if (event.type == ReplayEvent::FRAME) break;
+            events.push_back(event);
+        }
+        time = event.number;
+    }
+    frameTime = time;
+    return true;
+}
+
+void Replay::endFrame(double paintTime, double gpuTime, int drawn) {
+    if (timingFile.isOpen()) {
+        timings << frame << ',' << frameTime << ',' << paintTime << ',' << gpuTime << ',' << drawn << '\n';
+    }
+    if (mode != OFF || timingFile.isOpen()) paintTimes.push_back(static_cast<float>(paintTime));
+    frame++;
+}
+
+void Replay::write(const ReplayEvent &event) {
+    uchar r[recordSize] = {};
+    r[0] = event.type;
+    qToLittleEndian<quint32>(event.frame, r + 4);
+    quint32 bits;
+    if (event.isInteger()) {
+        bits = static_cast<quint32>(event.integer);
+    } else {
+        std::memcpy(&bits, &event.number, sizeof(bits));
+    }
+    qToLittleEndian<quint32>(bits, r + 8);
+    buffer.append(reinterpret_cast<const char*>(r), recordSize);
+    if (buffer.size() >= blockSize) flush();
+}
+
+bool Replay::read(ReplayEvent &event) {
+    if (offset + recordSize > data.size()) return false;
+    const uchar *r = reinterpret_cast<const uchar*>(data.constData()) + offset;
+    offset += recordSize;
+    if (r[0] > ReplayEvent::KEY) {
+        LOG(Log::GENERAL, Log::WARNING) << "Invalid replay record at" << offset - recordSize;
+        return false;
+    }
+    event.type = static_cast<ReplayEvent::Type>(r[0]);
+    event.frame = qFromLittleEndian<quint32>(r + 4);
+    quint32 bits = qFromLittleEndian<quint32>(r + 8);
+    if (event.isInteger()) {
+        event.integer = static_cast<qint32>(bits);
+    } else {
+        std::memcpy(&event.number, &bits, sizeof(bits));
+    }
+    return true;
+}
+
+void Replay::flush() {
+    file.write(buffer);
+    buffer.clear();
+}
+
+// Mean and 95th percentile of the paint times, to compare runs at a glance.
+void Replay::logSummary() {
+    if (paintTimes.isEmpty()) return;
+    QVector<float> sorted = paintTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (float t : sorted) {
+        sum += t;
+    }
+    LOG(Log::GENERAL, Log::INFO) << sorted.size() << "frames painted in" << sum / sorted.size()
+                                 << "ms on average, 95% within" << sorted[(sorted.size() * 95) / 100] << "ms";
+}
@@ -0,0 +1,100 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QTextStream>
+#include <QVector>
+
+struct ReplayEvent {
+    enum Type : quint8 {
+        FRAME = 0, HEIGHT, ANGLE, SPEED, FOV, LOOK_FROM, LOOK_AT, ACTIVE_VIEW, SHADING, KEY
+    };
+
+    Type type = FRAME;
+    quint32 frame = 0;      // The frame the event applies before.
+    float number = 0;       // Frame time in seconds, or a slider value.
+    qint32 integer = 0;     // Object index, view, shading mode or key code.
+
+    bool isInteger() const {return type >= LOOK_FROM;}
+};
+
+/**
+ * @brief The Replay class
+ *
+ * Records a session so it can be played back frame by frame: the random seed,
+ * the simulation time step of every frame and the UI events in between. A
+ * replay applies the events before the frame they were recorded for and steps
+ * the simulation by the recorded time, so it runs the same whatever the frame
+ * rate, on screen or with -platform offscreen.
+ *
+ * The file is a 16 byte header (magic, version, seed, reserved) followed by
+ * 12 byte records (type, 3 bytes padding, frame, value), little endian.
+ *
+ * In any mode, per frame timings can be written as CSV to compare builds.
+ */
+class Replay {
+public:
+    enum Mode {
+        OFF = 0, RECORD, PLAY
+    };
+
+    Replay() {}
+    ~Replay();
+
+    bool record(QString file, quint32 seed);
+    bool play(QString file);
+    // Ends recording or playing, and the timings.
+    void stop();
+    Mode getMode() {return mode;}
+    bool isRecording() {return mode == RECORD;}
+    bool isPlaying() {return mode == PLAY;}
+    QString errorString() {return error;}
+
+    // Adds an event before the frame about to be painted, when recording.
+    void add(ReplayEvent::Type type, float number);
+    void add(ReplayEvent::Type type, qint32 integer);
+
+    // Recording stores frameTime. Playing replaces it by the recorded one and
+    // returns the events to apply first; false when the replay has ended.
+    bool beginFrame(float &frameTime, QVector<ReplayEvent> &events);
+    // Writes the timing line of the frame and moves on to the next.
+    void endFrame(double paintTime, double gpuTime, int drawn);
+    quint32 getFrame() {return frame;}
+
+    bool writeTimings(QString file);
+
+    // Seed of a recording, for the random generator before the scene is built.
+    static bool readSeed(QString file, quint32 &seed, QString *error = nullptr);
+    // Sessions from the command line: --record, --replay and --timings.
+    static void setDefaults(QString recordFile, QString playFile, QString timingFile, quint32 seed);
+    bool startDefault();
+
+private:
+    static QString defaultRecordFile, defaultPlayFile, defaultTimingFile;
+    static quint32 defaultSeed;
+
+    Mode mode = OFF;
+    QString error;
+    quint32 frame = 0;
+    float frameTime = 0;
+
+    // Records, written in blocks while recording.
+    QFile file;
+    QByteArray buffer;
+    // The whole replay while playing.
+    QByteArray data;
+    int offset = 0;
+
+    QFile timingFile;
+    QTextStream timings;
+    QVector<float> paintTimes;
+
+    void write(const ReplayEvent &event);
+    bool read(ReplayEvent &event);
+    void flush();
+    void logSummary();
+};
+
+#endif // REPLAY_H
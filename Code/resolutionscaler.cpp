@@ -0,0 +1,207 @@
+#include "resolutionscaler.h"
+#include "log.h"
+
+#include <cmath>
+
+float ResolutionScaler::defaultScale = 0.0f;
+float ResolutionScaler::defaultMinScale = 0.5f;
+float ResolutionScaler::defaultMaxScale = 1.0f;
+float ResolutionScaler::defaultBudget = 1000.0f / 60.0f;
+ResolutionScaler::Filter ResolutionScaler::defaultFilter = ResolutionScaler::SHARPEN;
+
+// Limits of any scale, set by hand or not.
+static const float lowestScale = 0.25f, highestScale = 2.0f;
+// Scales are multiples of this, so small changes do not move the viewport every frame.
+static const float scaleStep = 1.0f / 32.0f;
+// Frame times from 85% to 105% of the budget leave the scale alone.
+static const float lowLoad = 0.85f, highLoad = 1.05f;
+
+ResolutionScaler::ResolutionScaler() {
+    setBounds(defaultMinScale, defaultMaxScale);
+    budget = defaultBudget;
+    filter = defaultFilter;
+    if (defaultScale > 0.0f) setScale(defaultScale);
+}
+
+ResolutionScaler::~ResolutionScaler() {
+    if (!initialized) return;
+    glDeleteQueries(timerCount, timers);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void ResolutionScaler::initialize(ShaderCache *cache) {
+    initializeOpenGLFunctions();
+
+    glGenQueries(timerCount, timers);
+    glGenFramebuffers(1, &framebuffer);
+    glGenTextures(1, &colorTexture);
+    glGenRenderbuffers(1, &depthBuffer);
+    // The upscale pass has no vertex data, but core profile draws need a VAO.
+    glGenVertexArrays(1, &emptyVAO);
+
+    cache->build(&program, ":/shaders/vertshader_upscale.glsl", ":/shaders/fragshader_upscale.glsl");
+    uniformFrame = program.uniformLocation("frame");
+    uniformSourceScale = program.uniformLocation("sourceScale");
+    uniformCoordBounds = program.uniformLocation("coordBounds");
+    uniformTexelSize = program.uniformLocation("texelSize");
+    uniformSharpness = program.uniformLocation("sharpness");
+    initialized = true;
+}
+
+void ResolutionScaler::setDefaults(float s, float minimum, float maximum, float ms, Filter f) {
+    defaultScale = s;
+    defaultMinScale = minimum;
+    defaultMaxScale = maximum;
+    defaultBudget = ms > 0.0f ? ms : 1000.0f / 60.0f;
+    defaultFilter = f;
+}
+
+QString ResolutionScaler::filterName(Filter f) {
+    return f == SHARPEN ? "sharpen" : "bilinear";
+}
+
+void ResolutionScaler::setScale(float s) {
+    automatic = false;
+    scale = qBound(lowestScale, s, highestScale);
+    LOG(Log::RENDER, Log::INFO) << "Resolution scale" << scale;
+}
+
+void ResolutionScaler::setAutomatic(bool a) {
+    automatic = a;
+    if (automatic) scale = qBound(minScale, scale, maxScale);
+    LOG(Log::RENDER, Log::INFO) << "Resolution scaling" << (automatic ? "automatic" : "fixed at") << scale;
+}
+
+void ResolutionScaler::setBounds(float minimum, float maximum) {
+    minScale = qBound(lowestScale, minimum, highestScale);
+    maxScale = qBound(minScale, maximum, highestScale);
+    if (automatic) scale = qBound(minScale, scale, maxScale);
+}
+
+QSize ResolutionScaler::begin(int w, int h) {
+    float largest = qMax(maxScale, scale);
+    if (w != width || h != height || std::ceil(w * largest) > targetWidth || std::ceil(h * largest) > targetHeight) {
+        resize(w, h);
+    }
+    readTimers();
+
+    renderSize = QSize(qBound(1, qRound(w * scale), targetWidth), qBound(1, qRound(h * scale), targetHeight));
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, renderSize.width(), renderSize.height());
+
+    // Without a free query this frame is not timed on the GPU.
+    currentTimer = timerPending[nextTimer] ? -1 : nextTimer;
+    if (currentTimer >= 0) {
+        glBeginQuery(GL_TIME_ELAPSED, timers[currentTimer]);
+        nextTimer = (nextTimer + 1) % timerCount;
+    }
+    cpuTimer.start();
+    return renderSize;
+}
+
+void ResolutionScaler::end(GLuint fbo) {
+    if (currentTimer >= 0) {
+        glEndQuery(GL_TIME_ELAPSED);
+        timerPending[currentTimer] = true;
+    }
+    cpuTime = cpuTimer.nsecsElapsed() / 1.0e6f;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+
+    program.bind();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glUniform1i(uniformFrame, 0);
+    float tx = 1.0f / targetWidth, ty = 1.0f / targetHeight;
+    glUniform2f(uniformSourceScale, renderSize.width() * tx, renderSize.height() * ty);
+    glUniform4f(uniformCoordBounds, 0.5f * tx, 0.5f * ty, (renderSize.width() - 0.5f) * tx, (renderSize.height() - 0.5f) * ty);
+    glUniform2f(uniformTexelSize, tx, ty);
+    // A frame at full resolution or more is not sharpened.
+    glUniform1f(uniformSharpness, filter == SHARPEN && scale < 1.0f ? 1.0f - scale : 0.0f);
+
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    program.release();
+    glEnable(GL_DEPTH_TEST);
+
+    adjust();
+}
+
+// The target covers the largest scale, so scaling never reallocates it.
+void ResolutionScaler::resize(int w, int h) {
+    width = w;
+    height = h;
+    float largest = qMax(maxScale, scale);
+    targetWidth = qMax(1, static_cast<int>(std::ceil(w * largest)));
+    targetHeight = qMax(1, static_cast<int>(std::ceil(h * largest)));
+
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, targetWidth, targetHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, targetWidth, targetHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG(Log::RENDER, Log::WARNING) << "Incomplete resolution target" << targetWidth << "x" << targetHeight;
+    }
+    LOG(Log::RENDER, Log::DEBUG) << "Resolution target" << targetWidth << "x" << targetHeight;
+}
+
+// Collects finished queries oldest first, so the newest result is kept.
+void ResolutionScaler::readTimers() {
+    for (int i = 0; i != timerCount; ++i) {
+        int t = (nextTimer + i) % timerCount;
+        if (!timerPending[t]) continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(timers[t], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(timers[t], GL_QUERY_RESULT, &nanoseconds);
+        gpuTime = nanoseconds / 1.0e6f;
+        timerPending[t] = false;
+        if (settling > 0) settling--;
+    }
+}
+
+/**
+ * @brief ResolutionScaler::adjust
+ *
+ * After a change the scale waits until the queries in flight, which measured
+ * the old scale, have come back.
+ */
+void ResolutionScaler::adjust() {
+    float frameTime = qMax(gpuTime, cpuTime);
+    if (!automatic || settling > 0 || frameTime <= 0.0f) return;
+
+    float load = frameTime / budget;
+    if (load > lowLoad && load < highLoad) return;
+
+    // Shading cost follows the pixel count, the square of the scale.
+    float ideal = scale / std::sqrt(load);
+    float next;
+    if (ideal < scale) {
+        next = std::floor((scale + (ideal - scale) * 0.5f) / scaleStep) * scaleStep;
+    } else {
+        next = std::ceil((scale + (ideal - scale) * 0.1f) / scaleStep) * scaleStep;
+    }
+    next = qBound(minScale, next, maxScale);
+    if (next != scale) {
+        scale = next;
+        settling = timerCount;
+    }
+}
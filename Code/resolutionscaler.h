@@ -0,0 +1,114 @@
+#ifndef RESOLUTIONSCALER_H
+#define RESOLUTIONSCALER_H
+
+#include <QElapsedTimer>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QSize>
+#include <QString>
+
+#include "shadercache.h"
+
+/**
+ * @brief The ResolutionScaler class
+ *
+ * Renders the scene into an offscreen target at a fraction of the widget's
+ * resolution and scales it up into the widget, bilinear or with a light
+ * sharpening filter.
+ *
+ * In automatic mode the scale follows a frame time budget. The time of each
+ * frame is the larger of the GPU time, from a ring of GL_TIME_ELAPSED queries
+ * read once available, and the CPU time between begin() and end(). Shading
+ * cost grows with the pixel count, so the scale moves toward the one that
+ * would fit the budget, quickly down and slowly up, and only when the frame
+ * time leaves a band around the budget. The target is allocated for the
+ * largest scale; a smaller scale only shrinks the viewport.
+ */
+class ResolutionScaler : protected QOpenGLFunctions_3_3_Core {
+public:
+    enum Filter {
+        BILINEAR = 0, SHARPEN
+    };
+
+    ResolutionScaler();
+    ~ResolutionScaler();
+
+    // Requires a current context.
+    void initialize(ShaderCache *cache);
+
+    // Binds the target for a widget of width by height pixels, returns the size to render at.
+    QSize begin(int width, int height);
+    // Scales the frame up into framebuffer fbo and picks the scale of the next frame.
+    void end(GLuint fbo);
+
+    // Setting a scale turns automatic scaling off.
+    void setScale(float s);
+    float getScale() {return scale;}
+    void setAutomatic(bool a);
+    bool isAutomatic() {return automatic;}
+    void setBounds(float minimum, float maximum);
+    float getMinScale() {return minScale;}
+    float getMaxScale() {return maxScale;}
+    // Frame time to aim for, in milliseconds.
+    void setBudget(float ms) {budget = ms;}
+    float getBudget() {return budget;}
+    void setFilter(Filter f) {filter = f;}
+    Filter getFilter() {return filter;}
+
+    // Last measured times in milliseconds, the GPU time lags a few frames.
+    float getGpuTime() {return gpuTime;}
+    float getCpuTime() {return cpuTime;}
+    // Bytes of the color texture and depth buffer.
+    qint64 getMemoryUsage() {return qint64(targetWidth) * targetHeight * 8;}
+
+    // A scale of 0 or less is automatic.
+    static void setDefaults(float scale, float minimum, float maximum, float budget, Filter filter);
+    static QString filterName(Filter f);
+
+private:
+    static const int timerCount = 4;
+
+    static float defaultScale;
+    static float defaultMinScale, defaultMaxScale;
+    static float defaultBudget;
+    static Filter defaultFilter;
+
+    bool automatic = true;
+    float scale = 1.0f;
+    float minScale = 0.5f, maxScale = 1.0f;
+    float budget = 1000.0f / 60.0f;
+    Filter filter = SHARPEN;
+
+    // Of the widget, of the allocated target and of the current frame.
+    int width = 0, height = 0;
+    int targetWidth = 0, targetHeight = 0;
+    QSize renderSize;
+
+    float gpuTime = 0.0f, cpuTime = 0.0f;
+    QElapsedTimer cpuTimer;
+    GLuint timers[timerCount];
+    bool timerPending[timerCount] = {};
+    int nextTimer = 0;
+    int currentTimer = -1;
+    // Timer results to wait for after a change of scale.
+    int settling = 0;
+
+    bool initialized = false;
+    GLuint framebuffer;
+    GLuint colorTexture;
+    GLuint depthBuffer;
+    GLuint emptyVAO;
+
+    QOpenGLShaderProgram program;
+    GLint uniformFrame;
+    GLint uniformSourceScale;
+    GLint uniformCoordBounds;
+    GLint uniformTexelSize;
+    GLint uniformSharpness;
+
+    void resize(int w, int h);
+    void readTimers();
+    void adjust();
+};
+
+#endif // RESOLUTIONSCALER_H
@@ -0,0 +1,360 @@
+#include "scenefile.h"
+#include "assetpack.h"
+
+#include <QBuffer>
+#include <QSaveFile>
+#include <QStringList>
+#include <QtEndian>
+#include <cstring>
+
+static const quint32 binaryMagic = 0x424e4353;  // "SCNB"
+static const quint32 binaryVersion = 2;
+static const int headerSize = 16;
+static const int recordSize = 76;
+// Version 1 records end after the position.
+static const int recordSizeV1 = 56;
+static const quint32 noString = 0xffffffff;
+
+// Splits a line on whitespace, "quoted text" is one token.
+static QStringList tokenize(const QString &text, bool &ok) {
+    QStringList tokens;
+    ok = true;
+    int i = 0, n = text.size();
+    while (i != n) {
+        if (text[i].isSpace()) {
+            i++;
+        } else if (text[i] == '#') {
+            break;
+        } else if (text[i] == '"') {
+            int end = text.indexOf('"', i + 1);
+            if (end < 0) {
+                ok = false;
+                break;
+            }
+            tokens << text.mid(i + 1, end - i - 1);
+            i = end + 1;
+        } else {
+            int start = i;
+            while (i != n && !text[i].isSpace()) i++;
+            tokens << text.mid(start, i - start);
+        }
+    }
+    return tokens;
+}
+
+static float readFloat(const uchar *p) {
+    quint32 bits = qFromLittleEndian<quint32>(p);
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static void writeFloat(uchar *p, float f) {
+    quint32 bits;
+    std::memcpy(&bits, &f, sizeof(f));
+    qToLittleEndian(bits, p);
+}
+
+SceneReader::~SceneReader() {
+    QFile *f = qobject_cast<QFile*>(file.get());
+    if (data && mapped.isEmpty() && f) f->unmap(const_cast<uchar*>(data));
+}
+
+bool SceneReader::open(QString name) {
+    file = AssetPack::openAsset(name, &error);
+    if (!file) return false;
+
+    char magic[4];
+    binary = file->peek(magic, 4) == 4 && qFromLittleEndian<quint32>(magic) == binaryMagic;
+    if (!binary) {
+        stream.setDevice(file.get());
+        stream.setCodec("UTF-8");
+        return true;
+    }
+
+    // Resources and packed entries are already in memory, map() only works
+    // for real files. A packed entry's bytes are shared, not copied.
+    size = file->size();
+    QFile *f = qobject_cast<QFile*>(file.get());
+    QBuffer *packed = qobject_cast<QBuffer*>(file.get());
+    data = f ? f->map(0, size) : nullptr;
+    if (!data) {
+        mapped = packed ? packed->data() : file->readAll();
+        data = reinterpret_cast<const uchar*>(mapped.constData());
+    }
+    quint32 version = size < headerSize ? 0 : qFromLittleEndian<quint32>(data + 4);
+    if (version != 1 && version != binaryVersion) {
+        error = QString("%1 is not a version 1 or %2 scene").arg(name).arg(binaryVersion);
+        return false;
+    }
+    recordBytes = version == 1 ? recordSizeV1 : recordSize;
+    bodyCount = qFromLittleEndian<qint32>(data + 8);
+    stringCount = qFromLittleEndian<qint32>(data + 12);
+    if (bodyCount < 0 || stringCount < 0 ||
+            headerSize + 8 * qint64(stringCount) + recordBytes * qint64(bodyCount) > size) {
+        error = QString("%1 is truncated").arg(name);
+        return false;
+    }
+    strings.resize(stringCount);
+    return true;
+}
+
+int SceneReader::read(int max, QVector<SceneBody> &out) {
+    if (hasError() || !file || !file->isOpen()) return 0;
+
+    int count = 0;
+    if (binary) {
+        out.reserve(out.size() + qMin(max, bodyCount - next));
+        while (count != max && next != bodyCount) {
+            SceneBody body;
+            if (!readRecord(next, body)) return 0;
+            out.push_back(body);
+            next++;
+            count++;
+        }
+        return count;
+    }
+
+    while (count != max && !stream.atEnd()) {
+        line++;
+        SceneBody body;
+        QString text = stream.readLine();
+        if (!readLine(text, body)) {
+            if (hasError()) return 0;
+            continue;
+        }
+        names[body.name] = next;
+        out.push_back(body);
+        next++;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief SceneReader::readLine
+ *
+ * Returns false for lines without a body, sets error when the line is invalid.
+ */
+bool SceneReader::readLine(QString text, SceneBody &body) {
+    bool ok;
+    QStringList tokens = tokenize(text, ok);
+    if (!ok) {
+        error = QString("Line %1: unterminated quote").arg(line);
+        return false;
+    }
+    if (tokens.isEmpty()) return false;
+
+    QString kind = tokens[0];
+    int i = 1;
+    auto fail = [&](QString message) {
+        error = QString("Line %1: %2").arg(line).arg(message);
+        return false;
+    };
+    auto number = [&](float &value) {
+        if (i == tokens.size()) return fail("missing number after " + tokens[i - 1]);
+        value = tokens[i++].toFloat(&ok);
+        return ok || fail("invalid number " + tokens[i - 1]);
+    };
+
+    if (kind == "scale") {
+        while (i != tokens.size()) {
+            QString key = tokens[i++];
+            float *value = key == "radius" ? &radiusScale : key == "rotation" ? &rotationScale :
+                           key == "distance" ? &distanceScale : key == "period" ? &periodScale : nullptr;
+            if (!value) return fail("unknown scale " + key);
+            if (!number(*value)) return false;
+        }
+        return false;
+    }
+
+    if (kind == "eye") body.kind = SceneBody::EYE;
+    else if (kind == "sun") body.kind = SceneBody::SUN;
+    else if (kind == "planet") body.kind = SceneBody::PLANET;
+    else if (kind == "ship") body.kind = SceneBody::SHIP;
+    else return fail("unknown body " + kind);
+
+    if (i == tokens.size()) return fail("missing name");
+    body.name = tokens[i++];
+
+    bool hasPosition = false;
+    while (i != tokens.size()) {
+        QString key = tokens[i++];
+        if (key == "unlisted") {
+            body.listed = false;
+        } else if (key == "orbits" || key == "from") {
+            if (i == tokens.size()) return fail("missing name after " + key);
+            body.parent = names.value(tokens[i], -1);
+            if (body.parent < 0) return fail(QString("%1 is not defined before %2").arg(tokens[i], body.name));
+            i++;
+        } else if (key == "model" || key == "texture") {
+            if (i == tokens.size()) return fail("missing file after " + key);
+            (key == "model" ? body.model : body.texture) = tokens[i++];
+        } else if (key == "position") {
+            float x, y, z;
+            if (!number(x) || !number(y) || !number(z)) return false;
+            body.position = QVector3D(x, y, z);
+            hasPosition = true;
+        } else if (key == "radius") {
+            if (!number(body.radius)) return false;
+            body.radius *= radiusScale;
+        } else if (key == "rotation") {
+            if (!number(body.rotation)) return false;
+            body.rotation *= rotationScale;
+        } else if (key == "distance") {
+            if (!number(body.distance)) return false;
+            body.distance *= distanceScale;
+        } else if (key == "period") {
+            if (!number(body.period)) return false;
+            body.period *= periodScale;
+        } else if (key == "speed") {
+            if (!number(body.speed)) return false;
+        } else if (key == "eccentricity") {
+            if (!number(body.eccentricity)) return false;
+            if (body.eccentricity < 0 || body.eccentricity >= 1) return fail("eccentricity must be from 0 to below 1");
+        } else if (key == "inclination" || key == "node" || key == "periapsis" || key == "anomaly") {
+            float *angle = key == "inclination" ? &body.inclination : key == "node" ? &body.node :
+                           key == "periapsis" ? &body.periapsis : &body.anomaly;
+            if (!number(*angle)) return false;
+        } else {
+            return fail("unknown keyword " + key);
+        }
+    }
+
+    if (body.kind == SceneBody::EYE && !hasPosition) return fail(body.name + " needs a position");
+    if (body.kind == SceneBody::PLANET && body.parent < 0) return fail(body.name + " needs orbits");
+    if (body.kind == SceneBody::SHIP && body.parent < 0) return fail(body.name + " needs from");
+    return true;
+}
+
+bool SceneReader::readRecord(int index, SceneBody &body) {
+    const uchar *r = data + headerSize + 8 * qint64(stringCount) + recordBytes * qint64(index);
+
+    quint8 kind = r[0];
+    body.listed = r[1] != 0;
+    body.parent = qFromLittleEndian<qint32>(r + 4);
+    bool needsParent = kind == SceneBody::PLANET || kind == SceneBody::SHIP;
+    if (kind > SceneBody::SHIP || body.parent >= index || (needsParent && body.parent < 0)) {
+        error = QString("Body %1 is invalid").arg(index);
+        return false;
+    }
+    body.kind = static_cast<SceneBody::Kind>(kind);
+    if (!string(qFromLittleEndian<quint32>(r + 8), body.name) ||
+            !string(qFromLittleEndian<quint32>(r + 12), body.model) ||
+            !string(qFromLittleEndian<quint32>(r + 16), body.texture)) {
+        error = QString("Body %1 has an invalid string").arg(index);
+        return false;
+    }
+    body.radius = readFloat(r + 20);
+    body.rotation = readFloat(r + 24);
+    body.distance = readFloat(r + 28);
+    body.period = readFloat(r + 32);
+    body.speed = readFloat(r + 36);
+    body.position = QVector3D(readFloat(r + 40), readFloat(r + 44), readFloat(r + 48));
+    if (recordBytes >= recordSize) {
+        body.eccentricity = readFloat(r + 52);
+        body.inclination = readFloat(r + 56);
+        body.node = readFloat(r + 60);
+        body.periapsis = readFloat(r + 64);
+        body.anomaly = readFloat(r + 68);
+        if (!(body.eccentricity >= 0 && body.eccentricity < 1)) {
+            error = QString("Body %1 has an invalid eccentricity").arg(index);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Decodes each string once, bodies sharing a texture share the QString.
+bool SceneReader::string(quint32 index, QString &out) {
+    if (index == noString) {
+        out.clear();
+        return true;
+    }
+    if (index >= quint32(stringCount)) return false;
+    if (strings[index].isNull()) {
+        const uchar *entry = data + headerSize + 8 * qint64(index);
+        quint32 offset = qFromLittleEndian<quint32>(entry);
+        quint32 length = qFromLittleEndian<quint32>(entry + 4);
+        if (qint64(offset) + length > size) return false;
+        strings[index] = QString::fromUtf8(reinterpret_cast<const char*>(data + offset), length);
+        // Empty strings are not null, so they are not decoded again either.
+        if (strings[index].isNull()) strings[index] = QString("");
+    }
+    out = strings[index];
+    return true;
+}
+
+/**
+ * @brief SceneWriter::writeBinary
+ *
+ * Equal strings are written once. The records are built in memory and written
+ * in one go; QSaveFile leaves an existing scene alone if that fails.
+ */
+bool SceneWriter::writeBinary(QString name, const QVector<SceneBody> &bodies, QString *error) {
+    QHash<QString, quint32> indices;
+    QVector<QByteArray> strings;
+    auto intern = [&](const QString &s) {
+        if (s.isEmpty()) return noString;
+        auto it = indices.constFind(s);
+        if (it != indices.constEnd()) return it.value();
+        quint32 index = strings.size();
+        strings.push_back(s.toUtf8());
+        indices.insert(s, index);
+        return index;
+    };
+
+    QByteArray records(recordSize * bodies.size(), 0);
+    for (int b = 0; b != bodies.size(); ++b) {
+        const SceneBody &body = bodies[b];
+        uchar *r = reinterpret_cast<uchar*>(records.data()) + recordSize * b;
+        r[0] = static_cast<quint8>(body.kind);
+        r[1] = body.listed ? 1 : 0;
+        qToLittleEndian<qint32>(body.parent, r + 4);
+        qToLittleEndian<quint32>(intern(body.name), r + 8);
+        qToLittleEndian<quint32>(intern(body.model), r + 12);
+        qToLittleEndian<quint32>(intern(body.texture), r + 16);
+        writeFloat(r + 20, body.radius);
+        writeFloat(r + 24, body.rotation);
+        writeFloat(r + 28, body.distance);
+        writeFloat(r + 32, body.period);
+        writeFloat(r + 36, body.speed);
+        writeFloat(r + 40, body.position.x());
+        writeFloat(r + 44, body.position.y());
+        writeFloat(r + 48, body.position.z());
+        writeFloat(r + 52, body.eccentricity);
+        writeFloat(r + 56, body.inclination);
+        writeFloat(r + 60, body.node);
+        writeFloat(r + 64, body.periapsis);
+        writeFloat(r + 68, body.anomaly);
+    }
+
+    QByteArray header(headerSize + 8 * strings.size(), 0);
+    uchar *h = reinterpret_cast<uchar*>(header.data());
+    qToLittleEndian<quint32>(binaryMagic, h);
+    qToLittleEndian<quint32>(binaryVersion, h + 4);
+    qToLittleEndian<qint32>(bodies.size(), h + 8);
+    qToLittleEndian<qint32>(strings.size(), h + 12);
+    quint32 offset = header.size() + records.size();
+    for (int s = 0; s != strings.size(); ++s) {
+        qToLittleEndian<quint32>(offset, h + headerSize + 8 * s);
+        qToLittleEndian<quint32>(strings[s].size(), h + headerSize + 8 * s + 4);
+        offset += strings[s].size();
+    }
+
+    QSaveFile file(name);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) *error = file.errorString();
+        return false;
+    }
+    file.write(header);
+    file.write(records);
+    for (const QByteArray &s : strings) {
+        file.write(s);
+    }
+    if (!file.commit()) {
+        if (error) *error = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+#include <QFile>
+#include <QHash>
+#include <QIODevice>
+#include <QString>
+#include <QTextStream>
+#include <QVector>
+#include <QVector3D>
+
+#include <memory>
+
+/**
+ * @brief The SceneBody struct
+ *
+ * One body of a scene, with the scale of the scene already applied.
+ * parent is the index of an earlier body: the body a planet orbits or the body
+ * a ship starts from.
+ */
+struct SceneBody {
+    enum Kind {
+        EYE = 0, SUN, PLANET, SHIP
+    };
+
+    Kind kind = PLANET;
+    bool listed = true;     // Offered as a viewpoint in the interface.
+    int parent = -1;
+    QString name;
+    QString model;          // Empty for the default model of the kind.
+    QString texture;
+    float radius = 0;
+    float rotation = 0;     // Rotation period.
+    float distance = 0;     // Orbit distance between the surfaces.
+    float period = 0;       // Orbital period.
+    float speed = 0;        // Ships only.
+    QVector3D position;     // Eyes only.
+    // Shape and orientation of a planet's orbit in degrees, see OrbitalElements.
+    float eccentricity = 0;
+    float inclination = 0;
+    float node = 0;
+    float periapsis = 0;
+    float anomaly = 0;
+};
+
+/**
+ * @brief The SceneReader class
+ *
+ * Reads a scene in chunks, from the text form used for authoring or from the
+ * compiled binary form; open() tells them apart by the magic number.
+ *
+ * The text form has one body per line, # starts a comment:
+ *
+ *     scale radius 10 rotation 10 distance 2500 period 5
+ *     sun "Sun" radius 200 rotation 0.0001
+ *     planet "Earth" orbits "Sun" radius 1 rotation 1 distance 1 period 1 texture :/textures/earth2.jpg
+ *     ship "Apollo 13" from "Earth" speed 8 texture :/textures/cat_diff.png
+ *
+ * Any line can add "model <file>" and "unlisted". A scale line multiplies the
+ * values of the bodies after it. Planets can leave the circle with
+ * "eccentricity", "inclination", "node", "periapsis" and "anomaly" (the mean
+ * anomaly at time 0), angles in degrees.
+ *
+ * The binary form is memory mapped. After a 16 byte header (magic, version,
+ * body count, string count) follow the string table as (offset, length) pairs,
+ * the fixed size body records and the UTF-8 string data. Version 1 records
+ * lack the orbital elements. Names, models and
+ * textures are indices into the string table, so a texture shared by a
+ * thousand bodies is stored and decoded once.
+ */
+class SceneReader {
+public:
+    SceneReader() {}
+    ~SceneReader();
+
+    bool open(QString file);
+    // Appends up to max bodies to out, returns how many; 0 at the end or on an error.
+    int read(int max, QVector<SceneBody> &out);
+
+    bool isBinary() {return binary;}
+    // Bodies in a binary scene, -1 for text.
+    int getBodyCount() {return binary ? bodyCount : -1;}
+    bool hasError() {return !error.isEmpty();}
+    QString errorString() {return error;}
+
+private:
+    // A file, or an entry of a mounted AssetPack.
+    std::unique_ptr<QIODevice> file;
+    QString error;
+    int next = 0;
+
+    // Text
+    QTextStream stream;
+    int line = 0;
+    float radiusScale = 1, rotationScale = 1, distanceScale = 1, periodScale = 1;
+    QHash<QString, int> names;
+
+    // Binary
+    bool binary = false;
+    const uchar *data = nullptr;
+    QByteArray mapped;      // Holds the data when the file cannot be mapped.
+    qint64 size = 0;
+    int bodyCount = 0;
+    int stringCount = 0;
+    int recordBytes = 0;
+    QVector<QString> strings;
+
+    bool readLine(QString text, SceneBody &body);
+    bool readRecord(int index, SceneBody &body);
+    bool string(quint32 index, QString &out);
+};
+
+/**
+ * @brief The SceneWriter class
+ *
+ * Compiles bodies into the binary form read by SceneReader.
+ */
+class SceneWriter {
+public:
+    static bool writeBinary(QString file, const QVector<SceneBody> &bodies, QString *error = nullptr);
+};
+
+#endif // SCENEFILE_H
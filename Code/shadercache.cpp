@@ -0,0 +1,161 @@
+#include "shadercache.h"
+#include "assetpack.h"
+#include "log.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QOpenGLContext>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// Identifies the layout of a cache file, bump when it changes.
+static const quint32 cacheMagic = 0x53484331; // "SHC1"
+
+void ShaderCache::initialize() {
+    initializeOpenGLFunctions();
+
+    directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shaders";
+
+    driverKey.append(reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+    driverKey.append('\n');
+    driverKey.append(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    driverKey.append('\n');
+    driverKey.append(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+
+    // Program binaries are core in 4.1, older contexts need the ARB extension.
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    QSurfaceFormat format = context->format();
+    bool available = format.version() >= qMakePair(4, 1) ||
+                     context->hasExtension("GL_ARB_get_program_binary");
+
+    GLint numFormats = 0;
+    if (available) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    }
+    supported = numFormats > 0 && QDir().mkpath(directory);
+
+    LOG(Log::GL, Log::INFO) << ":: Shader cache" << (supported ? qPrintable(directory) : "unavailable");
+}
+
+/**
+ * @brief ShaderCache::build
+ *
+ * Links program from the given sources, loading a cached binary when one exists
+ * for the current driver. Falls back to compiling from source when there is no
+ * binary or the driver rejects it, and stores the freshly linked result.
+ *
+ * @param program Program to link, it must not have been created yet.
+ * @param defines Preprocessor defines inserted after the #version line, as "NAME" or "NAME VALUE".
+ * @return whether the program linked.
+ */
+bool ShaderCache::build(QOpenGLShaderProgram *program, QString vertexFile, QString fragmentFile, QStringList defines) {
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray vertexSource = readSource(vertexFile, defines);
+    QByteArray fragmentSource = readSource(fragmentFile, defines);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(driverKey);
+    hash.addData(defines.join('\n').toUtf8());
+    hash.addData(vertexSource);
+    hash.addData(fragmentSource);
+    QString file = cacheFile(hash.result().toHex());
+
+    program->create();
+
+    if (supported && loadBinary(program, file)) {
+        warmCount++;
+        warmTime += timer.nsecsElapsed() / 1.0e6;
+        return true;
+    }
+
+    if (supported) {
+        glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentSource);
+    bool linked = program->link();
+
+    if (linked && supported) {
+        storeBinary(program, file);
+    }
+
+    coldCount++;
+    coldTime += timer.nsecsElapsed() / 1.0e6;
+    return linked;
+}
+
+QByteArray ShaderCache::readSource(QString file, QStringList defines) {
+    QByteArray source;
+    if (!AssetPack::readAsset(file, source)) {
+        LOG(Log::GL, Log::WARNING) << ":: Could not open shader" << file;
+        return QByteArray();
+    }
+    if (defines.isEmpty()) return source;
+
+    QByteArray block;
+    for (QString define : defines) {
+        block.append("#define " + define.toUtf8() + "\n");
+    }
+
+    // #version must stay the first statement, so the defines go right after it.
+    int at = 0;
+    if (source.startsWith("#version")) {
+        at = source.indexOf('\n') + 1;
+        if (at == 0) {
+            source.append('\n');
+            at = source.size();
+        }
+    }
+    source.insert(at, block);
+    return source;
+}
+
+QString ShaderCache::cacheFile(QByteArray key) {
+    return directory + "/" + QString::fromLatin1(key) + ".bin";
+}
+
+bool ShaderCache::loadBinary(QOpenGLShaderProgram *program, QString file) {
+    QFile in(file);
+    if (!in.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream stream(&in);
+    quint32 magic, binaryFormat;
+    QByteArray binary;
+    stream >> magic >> binaryFormat >> binary;
+    if (stream.status() != QDataStream::Ok || magic != cacheMagic || binary.isEmpty()) {
+        return false;
+    }
+
+    glProgramBinary(program->programId(), binaryFormat, binary.constData(), binary.size());
+
+    // Without attached shaders, link() only checks GL_LINK_STATUS of the binary.
+    if (program->link()) return true;
+
+    LOG(Log::GL, Log::INFO) << ":: Cached shader binary rejected, recompiling" << file;
+    in.close();
+    QFile::remove(file);
+    return false;
+}
+
+void ShaderCache::storeBinary(QOpenGLShaderProgram *program, QString file) {
+    GLint length = 0;
+    glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    QByteArray binary(length, Qt::Uninitialized);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(program->programId(), length, nullptr, &binaryFormat, binary.data());
+
+    // QSaveFile so a crash never leaves a truncated binary behind.
+    QSaveFile out(file);
+    if (!out.open(QIODevice::WriteOnly)) return;
+    QDataStream stream(&out);
+    stream << cacheMagic << quint32(binaryFormat) << binary;
+    out.commit();
+}
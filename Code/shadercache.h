@@ -0,0 +1,49 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <QByteArray>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief The ShaderCache class
+ *
+ * Stores linked program binaries (glGetProgramBinary) on disk so later launches
+ * can skip compiling and linking the GLSL sources. Binaries are keyed by a hash
+ * of the sources, the preprocessor defines and the GL vendor/renderer/version,
+ * so editing a shader or updating the driver simply misses the cache.
+ */
+class ShaderCache : protected QOpenGLExtraFunctions {
+public:
+    ShaderCache() {}
+
+    // Requires a current context.
+    void initialize();
+
+    bool build(QOpenGLShaderProgram *program, QString vertexFile, QString fragmentFile,
+               QStringList defines = QStringList());
+
+    bool isSupported() {return supported;}
+    int getWarmCount() {return warmCount;}
+    int getColdCount() {return coldCount;}
+    double getWarmTime() {return warmTime;}
+    double getColdTime() {return coldTime;}
+
+private:
+    QString directory;
+    QByteArray driverKey;
+    bool supported = false;
+
+    // Startup statistics, split by whether the binary came from disk.
+    int warmCount = 0, coldCount = 0;
+    double warmTime = 0, coldTime = 0;
+
+    QByteArray readSource(QString file, QStringList defines);
+    QString cacheFile(QByteArray key);
+    bool loadBinary(QOpenGLShaderProgram *program, QString file);
+    void storeBinary(QOpenGLShaderProgram *program, QString file);
+};
+
+#endif // SHADERCACHE_H
@@ -0,0 +1,6 @@
+#version 330 core
+
+// Occlusion queries only count samples, color writes are masked off.
+void main()
+{
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+// The input from the Phong vertex shader, only the texture coordinates are used.
+in vec2 texCoords;
+
+uniform vec3 virtualPages;  // Pages across and down at level 0, levels.
+uniform uint textureId;     // Id of the virtual texture + 1, 0 is cleared.
+uniform float pageTexels;   // Texels across a page.
+uniform float lodBias;      // log2 of how much larger the feedback pixels are.
+
+// Page x, page y, level and texture, see VirtualTextureCache::readFeedback.
+out uvec4 feedback;
+
+void main()
+{
+    // The same level the Phong shader picks, see virtualTexture there.
+    vec2 uv     = vec2(texCoords.x, 1.0F - texCoords.y);
+    vec2 texels = uv * virtualPages.xy * pageTexels;
+    vec2 dx = dFdx(texels), dy = dFdy(texels);
+    float lod = 0.5F * log2(max(dot(dx, dx), dot(dy, dy))) - lodBias;
+    int level = clamp(int(floor(lod)), 0, int(virtualPages.z) - 1);
+
+    ivec2 pages = max(ivec2(virtualPages.xy) >> level, ivec2(1));
+    ivec2 page  = clamp(ivec2(uv * vec2(pages)), ivec2(0), pages - 1);
+    feedback = uvec4(uvec2(page), uint(level), textureId);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+
+// The lighting of the vertices, see GOURAUD in vertshader_phong.glsl.
+in vec3 diffuseLight;
+in vec3 specularLight;
+in vec2 texCoords;
+
+// Texture sampler.
+uniform sampler2D textureSampler;
+
+// Specify the output of the fragment shader.
+out vec4 vertColor;
+
+void main()
+{
+    vertColor = vec4(texture(textureSampler, texCoords).rgb * diffuseLight + specularLight, 1.0F);
+}
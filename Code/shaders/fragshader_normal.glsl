@@ -0,0 +1,13 @@
+#version 330 core
+
+// The input from the vertex shader.
+in vec3 vertNormal;
+
+// Specify the output of the fragment shader.
+out vec4 vertColor;
+
+void main()
+{
+    // World space normals mapped from [-1, 1] to colors.
+    vertColor = vec4(normalize(vertNormal) * 0.5F + 0.5F, 1.0F);
+}
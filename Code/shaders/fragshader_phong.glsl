@@ -9,6 +9,7 @@ in vec3 vertPosition;
 in vec3 relativeLightPosition;
 in vec3 relativeCameraPosition;
 in vec2 texCoords;
+in float viewDepth;
 
 // Illumination model constants.
 uniform vec4 material;
@@ -19,28 +20,134 @@ uniform vec3 cameraPosition;
 // Texture sampler.
 uniform sampler2D textureSampler;
 
+// Virtual texture, see VirtualTextureCache. The indirection texture has a texel
+// per page and a mip level per page level, pointing at a slot of the page cache.
+uniform sampler2D indirection;
+uniform sampler2D pageCache;
+uniform vec4 virtualPages;              // Pages across and down at level 0, levels, 1 when textured virtually.
+uniform vec4 pageSlot;                  // Slot size, border and page size in cache coordinates, texels per page.
+
+// Clustered point lights, binned per frame by LightClusters. The cluster counts
+// CLUSTER_X, CLUSTER_Y and CLUSTER_Z are defined when the program is built.
+uniform samplerBuffer lightData;        // Two texels per light: position, radius and color.
+uniform usamplerBuffer clusterData;     // Offset and count into lightIndices per cluster.
+uniform usamplerBuffer lightIndices;
+uniform vec4 clusterViewport;           // Viewport origin and size in pixels.
+uniform vec2 clusterSlice;              // slice = log(depth) * x + y
+
+// Cube shadow map of the sun, see ShadowCubeMap.
+uniform samplerCubeShadow shadowMap;
+uniform vec3 shadowParams;              // Near and far plane, texel size at unit distance.
+
 // Specify the output of the fragment shader.
 out vec4 vertColor;
 
+// Directions around the lookup for percentage closer filtering.
+const vec3 pcfOffsets[20] = vec3[](
+    vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1),
+    vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
+    vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
+    vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
+    vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
+);
+
+float majorAxis(vec3 v)
+{
+    vec3 a = abs(v);
+    return max(a.x, max(a.y, a.z));
+}
+
+// Fraction of the sun that reaches the fragment.
+float sunShadow(vec3 normal)
+{
+    vec3 toFragment = vertPosition - lightPosition;
+    float texel = shadowParams.z * majorAxis(toFragment);
+
+    // Move the lookup out along the normal against shadow acne.
+    toFragment += normal * texel * 1.5F;
+
+    // Depth the face of the cube map stored for this distance along its axis.
+    float n = shadowParams.x, f = shadowParams.y;
+    float depth = ((f + n) / (f - n) - 2.0F * f * n / ((f - n) * majorAxis(toFragment))) * 0.5F + 0.5F;
+
+    float lit = 0.0F;
+    for (int i = 0; i < 20; ++i) {
+        lit += texture(shadowMap, vec4(toFragment + pcfOffsets[i] * texel * 1.5F, depth));
+    }
+    return lit / 20.0F;
+}
+
+// Samples the finest resident page at or above the level the footprint needs.
+vec3 virtualTexture(vec2 coords)
+{
+    // Pages are stored top row first.
+    vec2 uv     = vec2(coords.x, 1.0F - coords.y);
+    vec2 texels = uv * virtualPages.xy * pageSlot.w;
+    vec2 dx = dFdx(texels), dy = dFdy(texels);
+    float lod = 0.5F * log2(max(dot(dx, dx), dot(dy, dy)));
+    int level = clamp(int(floor(lod)), 0, int(virtualPages.z) - 1);
+
+    ivec2 pages = max(ivec2(virtualPages.xy) >> level, ivec2(1));
+    vec4 entry  = texelFetch(indirection, clamp(ivec2(uv * vec2(pages)), ivec2(0), pages - 1), level);
+    ivec3 resident = ivec3(entry.xyz * 255.0F + 0.5F);
+
+    // Position inside the resident page, which may be coarser than asked for.
+    vec2 residentPages = vec2(max(ivec2(virtualPages.xy) >> resident.z, ivec2(1)));
+    vec2 inPages = uv * residentPages;
+    vec2 inPage  = inPages - clamp(floor(inPages), vec2(0.0F), residentPages - 1.0F);
+    vec2 cache   = vec2(resident.xy) * pageSlot.x + pageSlot.y + inPage * pageSlot.z;
+    return textureLod(pageCache, cache, 0.0F).rgb;
+}
+
+vec3 pointLights(vec3 normal, vec3 viewDirection, vec3 texColor)
+{
+    vec2 tile = (gl_FragCoord.xy - clusterViewport.xy) / clusterViewport.zw * vec2(CLUSTER_X, CLUSTER_Y);
+    int slice = int(floor(log(viewDepth) * clusterSlice.x + clusterSlice.y));
+    ivec3 c = clamp(ivec3(ivec2(tile), slice), ivec3(0), ivec3(CLUSTER_X, CLUSTER_Y, CLUSTER_Z) - 1);
+    uvec2 range = texelFetch(clusterData, (c.z * CLUSTER_Y + c.y) * CLUSTER_X + c.x).xy;
+
+    vec3 color = vec3(0.0F);
+    for (uint i = 0u; i < range.y; ++i) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).x);
+        vec4 positionRadius = texelFetch(lightData, 2 * light);
+        vec3 pointColor     = texelFetch(lightData, 2 * light + 1).rgb;
+
+        vec3 toLight = positionRadius.xyz - vertPosition;
+        float distanceRatio = dot(toLight, toLight) / (positionRadius.w * positionRadius.w);
+        float falloff = clamp(1.0F - distanceRatio, 0.0F, 1.0F);
+        vec3 direction = normalize(toLight);
+
+        float diffuse  = max(dot(normal, direction), 0.0F);
+        float specular = max(dot(reflect(-direction, normal), viewDirection), 0.0F);
+        color += falloff * falloff * pointColor *
+                 (texColor * material.y * diffuse + material.z * pow(specular, material.w));
+    }
+    return color;
+}
+
 void main()
 {
     // Ambient color does not depend on any vectors.
-    vec3 texColor = texture(textureSampler, texCoords).xyz;
+    vec3 texColor = virtualPages.w > 0.5F ? virtualTexture(texCoords) : texture(textureSampler, texCoords).xyz;
     vec3 color    = material.x * texColor;
 
     // Calculate light direction vectors in the Phong illumination model.
     vec3 lightDirection    = normalize(lightPosition - vertPosition);
     vec3 normal            = normalize(vertNormal);
 
+    float shadow           = sunShadow(normal);
+
     // Diffuse color.
     float diffuseIntensity = max(dot(normal, lightDirection), 0.0F);
-    color += texColor * material.y * diffuseIntensity;
+    color += shadow * texColor * material.y * diffuseIntensity;
 
     // Specular color.
     vec3 viewDirection      = normalize(cameraPosition-vertPosition);
     vec3 reflectDirection   = reflect(-lightDirection, normal);
     float specularIntensity = max(dot(reflectDirection, viewDirection), 0.0F);
-    color += lightColor * material.z * pow(specularIntensity, material.w);
+    color += shadow * lightColor * material.z * pow(specularIntensity, material.w);
+
+    color += pointLights(normal, viewDirection, texColor);
 
     vertColor = vec4(color, 1.0F);
 }
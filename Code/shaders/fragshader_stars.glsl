@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec3 starColor;
+
+out vec4 fColor;
+
+// Round points that fade towards the edge, blended additively.
+void main()
+{
+    vec2 d = gl_PointCoord * 2.0F - 1.0F;
+    float falloff = max(1.0F - dot(d, d), 0.0F);
+    fColor = vec4(starColor * falloff, 1.0F);
+}
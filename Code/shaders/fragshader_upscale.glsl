@@ -0,0 +1,38 @@
+#version 330 core
+
+in vec2 texCoords;
+
+// The frame, filtered linearly.
+uniform sampler2D frame;
+// Texel centers at the edges of the rendered part, so nothing outside it is sampled.
+uniform vec4 coordBounds;
+uniform vec2 texelSize;
+// 0 is plain bilinear.
+uniform float sharpness;
+
+out vec4 fColor;
+
+vec4 fetch(vec2 coords)
+{
+    return texture(frame, clamp(coords, coordBounds.xy, coordBounds.zw));
+}
+
+void main()
+{
+    vec4 center = fetch(texCoords);
+    if (sharpness <= 0.0F) {
+        fColor = center;
+        return;
+    }
+
+    vec3 n = fetch(texCoords + vec2(0.0F, texelSize.y)).rgb;
+    vec3 s = fetch(texCoords - vec2(0.0F, texelSize.y)).rgb;
+    vec3 e = fetch(texCoords + vec2(texelSize.x, 0.0F)).rgb;
+    vec3 w = fetch(texCoords - vec2(texelSize.x, 0.0F)).rgb;
+
+    // Unsharp mask, kept within the neighbours so edges do not ring.
+    vec3 sharpened = center.rgb + (4.0F * center.rgb - n - s - e - w) * 0.25F * sharpness;
+    vec3 low = min(center.rgb, min(min(n, s), min(e, w)));
+    vec3 high = max(center.rgb, max(max(n, s), max(e, w)));
+    fColor = vec4(clamp(sharpened, low, high), center.a);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+
+// Specify the input locations of attributes.
+layout (location = 0) in vec3 vertCoordinates_in;
+
+// Projection * view * model of the bounding box.
+uniform mat4 boxTransform;
+
+void main()
+{
+    gl_Position = boxTransform * vec4(vertCoordinates_in, 1.0F);
+}
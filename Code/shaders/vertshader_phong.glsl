@@ -16,22 +16,131 @@ uniform vec3 lightPosition;
 uniform vec3 cameraPosition;
 uniform mat3 normalTransform;
 
+// Analytic orbits, see OrbitBuffer: four texels per object and the time since
+// their epoch. orbitBody is 1 + the object to place from them, or 0 to use
+// the matrices above.
+uniform samplerBuffer orbits;
+uniform float orbitTime;
+uniform int orbitBody;
+
 // Specify the output of the vertex stage.
 out vec3 vertNormal;
 out vec3 vertPosition;
 out vec3 relativeLightPosition;
 out vec3 relativeCameraPosition;
 out vec2 texCoords;
+out float viewDepth;
+
+#ifdef GOURAUD
+// Lighting per vertex for fragshader_gouraud.glsl, with the uniforms of the
+// Phong fragment shader. The sun's shadow is a single lookup, the point
+// lights are those of the cluster the vertex falls in.
+uniform vec4 material;
+uniform vec3 lightColor;
+uniform samplerCubeShadow shadowMap;
+uniform vec3 shadowParams;
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterData;
+uniform usamplerBuffer lightIndices;
+uniform vec2 clusterSlice;
+
+out vec3 diffuseLight;      // Multiplies the texture color.
+out vec3 specularLight;     // Added to it.
+
+float sunShadow(vec3 position, vec3 normal)
+{
+    vec3 toVertex = position - lightPosition;
+    vec3 a = abs(toVertex);
+    toVertex += normal * shadowParams.z * max(a.x, max(a.y, a.z)) * 1.5F;
+    a = abs(toVertex);
+    float n = shadowParams.x, f = shadowParams.y;
+    float depth = ((f + n) / (f - n) - 2.0F * f * n / ((f - n) * max(a.x, max(a.y, a.z)))) * 0.5F + 0.5F;
+    return texture(shadowMap, vec4(toVertex, depth));
+}
+
+void gouraud(vec3 position, vec3 normal, vec4 clipPosition, float depth)
+{
+    vec3 lightDirection = normalize(lightPosition - position);
+    vec3 viewDirection  = normalize(cameraPosition - position);
+    float shadow = sunShadow(position, normal);
+
+    diffuseLight  = vec3(material.x + shadow * material.y * max(dot(normal, lightDirection), 0.0F));
+    specularLight = shadow * lightColor * material.z *
+                    pow(max(dot(reflect(-lightDirection, normal), viewDirection), 0.0F), material.w);
+
+    vec2 tile = (clipPosition.xy / max(clipPosition.w, 1e-6F) * 0.5F + 0.5F) * vec2(CLUSTER_X, CLUSTER_Y);
+    int slice = int(floor(log(max(depth, 1e-6F)) * clusterSlice.x + clusterSlice.y));
+    ivec3 c = clamp(ivec3(ivec2(tile), slice), ivec3(0), ivec3(CLUSTER_X, CLUSTER_Y, CLUSTER_Z) - 1);
+    uvec2 range = texelFetch(clusterData, (c.z * CLUSTER_Y + c.y) * CLUSTER_X + c.x).xy;
+    for (uint i = 0u; i < range.y; ++i) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).x);
+        vec4 positionRadius = texelFetch(lightData, 2 * light);
+        vec3 pointColor     = texelFetch(lightData, 2 * light + 1).rgb;
+
+        vec3 toLight = positionRadius.xyz - position;
+        float falloff = clamp(1.0F - dot(toLight, toLight) / (positionRadius.w * positionRadius.w), 0.0F, 1.0F);
+        vec3 direction = normalize(toLight);
+        float specular = max(dot(reflect(-direction, normal), viewDirection), 0.0F);
+        diffuseLight  += falloff * falloff * pointColor * material.y * max(dot(normal, direction), 0.0F);
+        specularLight += falloff * falloff * pointColor * material.z * pow(specular, material.w);
+    }
+}
+#endif
+
+// Moons of moons are as deep as the scenes go.
+#define MAX_ORBIT_DEPTH 4
+
+// Eccentric anomaly E for mean anomaly M, E - e sin E = M, as Orbit::solveKepler.
+float solveKepler(float M, float e)
+{
+    M -= 2.0F * M_PI * floor(M / (2.0F * M_PI) + 0.5F);
+    float E = e < 0.8F ? M + e * sin(M) : M_PI;
+    for (int i = 0; i != 10; ++i) {
+        E -= (E - e * sin(E) - M) / (1.0F - e * cos(E));
+    }
+    return E;
+}
+
+// The orbit offsets of body and its parents, up to a body that does not orbit.
+vec3 orbitPosition(int body)
+{
+    vec3 position = vec3(0.0F);
+    for (int depth = 0; depth <= MAX_ORBIT_DEPTH && body >= 0; ++depth) {
+        vec4 elements = texelFetch(orbits, 4 * body);
+        vec4 p        = texelFetch(orbits, 4 * body + 1);
+        vec4 q        = texelFetch(orbits, 4 * body + 2);
+        float E = solveKepler(elements.z + elements.w * orbitTime, elements.y);
+        position += p.xyz * (elements.x * (cos(E) - elements.y)) + q.xyz * (p.w * sin(E));
+        body = int(q.w);
+    }
+    return position;
+}
 
 void main()
 {
-    gl_Position  = projectionTransform * viewTransform * modelTransform * vec4(vertCoordinates_in, 1.0F);
+    mat4 model = modelTransform;
+    mat3 normalModel = normalTransform;
+    if (orbitBody > 0) {
+        // Spun around y and scaled like TransformHierarchy.
+        vec4 spin = texelFetch(orbits, 4 * (orbitBody - 1) + 3);
+        mat3 rotation = mat3(spin.x, 0.0F, -spin.y, 0.0F, 1.0F, 0.0F, spin.y, 0.0F, spin.x);
+        model = mat4(vec4(rotation[0] * spin.z, 0.0F), vec4(rotation[1] * spin.z, 0.0F),
+                     vec4(rotation[2] * spin.z, 0.0F), vec4(orbitPosition(orbitBody - 1), 1.0F));
+        normalModel = rotation / (spin.z != 0.0F ? spin.z : 1.0F);
+    }
+
+    vec4 viewPosition = viewTransform * model * vec4(vertCoordinates_in, 1.0F);
+    gl_Position  = projectionTransform * viewPosition;
+    viewDepth    = -viewPosition.z;
 
     // Pass the required information to the fragment shader stage.
 //    relativeLightPosition = vec3(viewTransform * modelTransform * vec4(lightPosition, 1.0F));
-    vertPosition = vec3(modelTransform  * vec4(vertCoordinates_in, 1.0F));
+    vertPosition = vec3(model * vec4(vertCoordinates_in, 1.0F));
 //    relativeCameraPosition = vec3(viewTransform * modelTransform * vec4(cameraPosition, 1.0F));
 //    vertNormal   = normalize(normalTransform * normalize(texture(normalSampler, texCoords_in).rgb * 2.0 - 1.0));
-    vertNormal   = normalize(normalTransform * vertNormals_in);
+    vertNormal   = normalize(normalModel * vertNormals_in);
     texCoords    = texCoords_in;
+#ifdef GOURAUD
+    gouraud(vertPosition, vertNormal, gl_Position, viewDepth);
+#endif
 }
@@ -0,0 +1,13 @@
+#version 330 core
+
+// Specify the input locations of attributes.
+layout (location = 0) in vec3 vertCoordinates_in;
+
+// Model transform of the caster and projection * view of the cube face.
+uniform mat4 modelTransform;
+uniform mat4 faceTransform;
+
+void main()
+{
+    gl_Position = faceTransform * modelTransform * vec4(vertCoordinates_in, 1.0F);
+}
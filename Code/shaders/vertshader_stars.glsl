@@ -0,0 +1,37 @@
+#version 330 core
+
+// Specify the input locations of attributes.
+layout (location = 0) in vec3 direction_in;
+// Magnitude in tenths and B-V color index in fiftieths, see StarCatalog.
+layout (location = 1) in vec2 magnitudeColor_in;
+
+// Projection * rotation of the view, stars are infinitely far away.
+uniform mat4 skyTransform;
+uniform float pointScale;
+
+out vec3 starColor;
+
+vec3 starTint(float colorIndex)
+{
+    vec3 blue = vec3(0.64F, 0.73F, 1.0F);
+    vec3 white = vec3(1.0F, 0.97F, 0.92F);
+    vec3 red = vec3(1.0F, 0.62F, 0.38F);
+    if (colorIndex < 0.4F) return mix(blue, white, smoothstep(-0.4F, 0.4F, colorIndex));
+    return mix(white, red, smoothstep(0.4F, 1.8F, colorIndex));
+}
+
+void main()
+{
+    // z = w puts the star on the far plane.
+    vec4 position = skyTransform * vec4(direction_in, 1.0F);
+    gl_Position = position.xyww;
+
+    // Flux relative to a star of magnitude 1, bright stars grow instead of saturating.
+    float magnitude = magnitudeColor_in.x * 0.1F;
+    float flux = pow(10.0F, -0.4F * (magnitude - 1.0F));
+    float size = clamp(2.0F * sqrt(flux), 1.5F, 6.0F);
+    gl_PointSize = size * pointScale;
+
+    float brightness = min(flux * 12.0F / (size * size), 1.0F);
+    starColor = starTint(magnitudeColor_in.y * 0.02F) * brightness;
+}
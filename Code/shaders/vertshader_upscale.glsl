@@ -0,0 +1,14 @@
+#version 330 core
+
+// Part of the source texture that holds the frame.
+uniform vec2 sourceScale;
+
+out vec2 texCoords;
+
+void main()
+{
+    // A triangle covering the screen, from the vertex index alone.
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    texCoords = corner * sourceScale;
+    gl_Position = vec4(corner * 2.0F - 1.0F, 0.0F, 1.0F);
+}
@@ -0,0 +1,135 @@
+#include "shadinggovernor.h"
+#include "log.h"
+
+#include <cmath>
+
+float ShadingGovernor::defaultRadius = 24.0f;
+
+// Limits of the radius; above the largest every body is lit per vertex.
+static const float minRadius = 8.0f, maxRadius = 8192.0f;
+// Frame times from 80% to 105% of the budget leave the radius alone. The low
+// end is below the ResolutionScaler's, so the resolution recovers first.
+static const float lowLoad = 0.8f, highLoad = 1.05f;
+
+ShadingGovernor::ShadingGovernor() {
+    gouraudRadius = qBound(minRadius, defaultRadius, maxRadius);
+}
+
+ShadingGovernor::~ShadingGovernor() {
+    if (!initialized) return;
+    for (Frame &frame : frames) {
+        glDeleteQueries(2 * maxPasses, frame.queries);
+    }
+}
+
+void ShadingGovernor::initialize() {
+    initializeOpenGLFunctions();
+    for (Frame &frame : frames) {
+        glGenQueries(2 * maxPasses, frame.queries);
+    }
+    initialized = true;
+}
+
+QString ShadingGovernor::tierName(Tier tier) {
+    switch (tier) {
+    case NORMAL: return "normal";
+    case GOURAUD: return "Gouraud";
+    default: return "Phong";
+    }
+}
+
+float ShadingGovernor::pixelRadius(float radius, float distance, float focal, int height) {
+    // With the camera inside the sphere it covers the view.
+    if (distance <= radius) return maxRadius;
+    return radius / std::sqrt(distance * distance - radius * radius) * focal * height * 0.5f;
+}
+
+/**
+ * @brief ShadingGovernor::adjust
+ *
+ * The radius moves by a factor of 1.5 at a time, then waits for the frames in
+ * flight to come back measured with it.
+ */
+void ShadingGovernor::adjust(float frameTime, float budget, bool resolutionAtMinimum) {
+    if (settling > 0) {
+        settling--;
+        return;
+    }
+    if (frameTime <= 0.0f || budget <= 0.0f) return;
+
+    float load = frameTime / budget;
+    float next = gouraudRadius;
+    if (load > highLoad && resolutionAtMinimum) {
+        next = qMin(gouraudRadius * 1.5f, maxRadius);
+    } else if (load < lowLoad) {
+        next = qMax(gouraudRadius / 1.5f, minRadius);
+    }
+    if (next != gouraudRadius) {
+        gouraudRadius = next;
+        settling = frameCount;
+        LOG(Log::RENDER, Log::DEBUG) << "Gouraud shading below" << gouraudRadius << "pixels";
+    }
+}
+
+// Without free queries this frame is not timed.
+void ShadingGovernor::beginFrame() {
+    if (!initialized) return;
+    readFrames();
+    currentFrame = frames[nextFrame].pending ? -1 : nextFrame;
+    if (currentFrame < 0) return;
+    Frame &frame = frames[currentFrame];
+    frame.passes = 0;
+    for (int t = 0; t != tierCount; ++t) {
+        frame.objects[t] = 0;
+        frame.pixels[t] = 0.0f;
+    }
+    nextFrame = (nextFrame + 1) % frameCount;
+}
+
+void ShadingGovernor::beginPass(Tier tier, int objects, float pixels) {
+    if (currentFrame < 0 || frames[currentFrame].passes == maxPasses) return;
+    Frame &frame = frames[currentFrame];
+    glQueryCounter(frame.queries[2 * frame.passes], GL_TIMESTAMP);
+    frame.tiers[frame.passes] = tier;
+    frame.objects[tier] += objects;
+    frame.pixels[tier] += pixels;
+}
+
+void ShadingGovernor::endPass() {
+    if (currentFrame < 0 || frames[currentFrame].passes == maxPasses) return;
+    Frame &frame = frames[currentFrame];
+    glQueryCounter(frame.queries[2 * frame.passes + 1], GL_TIMESTAMP);
+    frame.passes++;
+}
+
+void ShadingGovernor::endFrame() {
+    if (currentFrame < 0) return;
+    frames[currentFrame].pending = frames[currentFrame].passes > 0;
+    currentFrame = -1;
+}
+
+// Oldest first, so the newest finished frame is kept. Timestamps complete in
+// order, the last one of a frame stands for all of them.
+void ShadingGovernor::readFrames() {
+    for (int i = 0; i != frameCount; ++i) {
+        Frame &frame = frames[(nextFrame + i) % frameCount];
+        if (!frame.pending) continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(frame.queries[2 * frame.passes - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+
+        float measured[tierCount] = {};
+        for (int p = 0; p != frame.passes; ++p) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.queries[2 * p], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[2 * p + 1], GL_QUERY_RESULT, &end);
+            measured[frame.tiers[p]] += (end - begin) / 1.0e6f;
+        }
+        for (int t = 0; t != tierCount; ++t) {
+            times[t] = measured[t];
+            objectCounts[t] = frame.objects[t];
+            pixelCounts[t] = frame.pixels[t];
+        }
+        frame.pending = false;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef SHADINGGOVERNOR_H
+#define SHADINGGOVERNOR_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QString>
+
+/**
+ * @brief The ShadingGovernor class
+ *
+ * Picks the shading tier of each object in automatic mode and measures what
+ * the tiers cost.
+ *
+ * An object whose bounding sphere is smaller on screen than a radius in pixels
+ * is lit per vertex; larger ones per fragment. The sphere mesh has more
+ * vertices than a small body has pixels, so nothing is lost there. When the
+ * frame time stays over the budget after the ResolutionScaler reached its
+ * lowest scale, the radius grows until screen-covering bodies are lit per
+ * vertex too. Under the budget it shrinks back.
+ *
+ * Each view draws the objects of a tier in one pass between two GL_TIMESTAMP
+ * queries. The results are read once available, a few frames later, so the
+ * CPU never waits. Passes overlap in the pipeline, so the times are estimates.
+ */
+class ShadingGovernor : protected QOpenGLFunctions_3_3_Core {
+public:
+    // In the order of MainView::ShadingMode.
+    enum Tier {
+        PHONG = 0, NORMAL, GOURAUD
+    };
+    static const int tierCount = 3;
+    // Passes per frame, every tier in every view.
+    static const int maxPasses = 16;
+
+    ShadingGovernor();
+    ~ShadingGovernor();
+
+    // Requires a current context.
+    void initialize();
+
+    // Radius on screen in pixels of a sphere at distance, for a projection
+    // whose (1, 1) element is focal and a viewport height pixels high.
+    static float pixelRadius(float radius, float distance, float focal, int height);
+    Tier choose(float radius) {return radius < gouraudRadius ? GOURAUD : PHONG;}
+    float getGouraudRadius() {return gouraudRadius;}
+
+    // Follows the budget, in milliseconds. The shading only gets cheaper when
+    // the resolution cannot, see the class comment.
+    void adjust(float frameTime, float budget, bool resolutionAtMinimum);
+
+    void beginFrame();
+    // pixels is the estimated screen area of the objects.
+    void beginPass(Tier tier, int objects, float pixels);
+    void endPass();
+    void endFrame();
+
+    // Of the last measured frame: GPU milliseconds, objects and pixels per tier.
+    float getTime(Tier tier) {return times[tier];}
+    int getObjects(Tier tier) {return objectCounts[tier];}
+    float getPixels(Tier tier) {return pixelCounts[tier];}
+
+    static void setDefaultRadius(float pixels) {defaultRadius = pixels;}
+    static QString tierName(Tier tier);
+
+private:
+    static const int frameCount = 4;
+    static float defaultRadius;
+
+    struct Frame {
+        GLuint queries[2 * maxPasses];
+        Tier tiers[maxPasses];
+        int passes = 0;
+        bool pending = false;
+        int objects[tierCount] = {};
+        float pixels[tierCount] = {};
+    };
+
+    bool initialized = false;
+    Frame frames[frameCount];
+    int nextFrame = 0;
+    int currentFrame = -1;
+
+    float gouraudRadius;
+    // Frames to wait after a change, the GPU time lags behind.
+    int settling = 0;
+
+    float times[tierCount] = {};
+    int objectCounts[tierCount] = {};
+    float pixelCounts[tierCount] = {};
+
+    void readFrames();
+};
+
+#endif // SHADINGGOVERNOR_H
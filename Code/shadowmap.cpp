@@ -0,0 +1,192 @@
+#include "shadowmap.h"
+
+#include "log.h"
+#include <QtMath>
+#include <cmath>
+
+// Cube map face order, each looks along an axis with the up vector GL expects.
+static const QVector3D faceDirections[6] = {
+    {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+};
+static const QVector3D faceUps[6] = {
+    {0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0}
+};
+
+int ShadowCubeMap::defaultIntervals[6] = {1, 1, 1, 1, 1, 1};
+
+ShadowCubeMap::ShadowCubeMap(int size) : size(size) {
+    for (int face = 0; face != 6; ++face) {
+        faces[face].interval = defaultIntervals[face];
+    }
+}
+
+ShadowCubeMap::~ShadowCubeMap() {
+    if (texture == 0) return;
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &texture);
+}
+
+void ShadowCubeMap::initialize(ShaderCache *cache) {
+    initializeOpenGLFunctions();
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    for (int face = 0; face != 6; ++face) {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size,
+                     0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    }
+    // Linear filtering with depth comparison gives 2x2 PCF per lookup.
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG(Log::GL, Log::WARNING) << ":: Shadow framebuffer incomplete";
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    cache->build(&program, ":/shaders/vertshader_shadow.glsl", ":/shaders/fragshader_shadow.glsl");
+    uniformModelTransform = program.uniformLocation("modelTransform");
+    uniformFaceTransform  = program.uniformLocation("faceTransform");
+}
+
+void ShadowCubeMap::setRange(float n, float f) {
+    nearPlane = n;
+    farPlane = f;
+    invalidate();
+}
+
+void ShadowCubeMap::invalidate() {
+    for (Face &face : faces) {
+        face.dirty = true;
+    }
+}
+
+/**
+ * @brief ShadowCubeMap::update
+ *
+ * Culls the casters of every face and compares them with the casters the face
+ * was last rendered with. Faces that changed are rendered once their update
+ * interval has passed, until then they keep the old shadows.
+ */
+void ShadowCubeMap::update(SolarSystem *ss, QVector3D light, Object *exclude) {
+    if (light != lightPosition) {
+        lightPosition = light;
+        invalidate();
+    }
+
+    facesRendered = 0;
+    for (int f = 0; f != 6; ++f) {
+        Face &face = faces[f];
+        face.age++;
+
+        cullFace(f, ss->objects, exclude);
+        if (castersChanged(face.casters, visible)) {
+            face.dirty = true;
+        }
+        if (!face.dirty || face.age < face.interval) continue;
+
+        if (facesRendered == 0) {
+            glViewport(0, 0, size, size);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(2.0F, 4.0F);
+            program.bind();
+        }
+        face.casters = visible;
+        renderFace(f, ss);
+        face.dirty = false;
+        face.age = 0;
+        facesRendered++;
+    }
+
+    if (facesRendered > 0) {
+        program.release();
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+}
+
+QMatrix4x4 ShadowCubeMap::faceTransform(int face) {
+    QMatrix4x4 transform;
+    transform.perspective(90.0f, 1.0f, nearPlane, farPlane);
+    transform.lookAt(lightPosition, lightPosition + faceDirections[face], faceUps[face]);
+    return transform;
+}
+
+/**
+ * @brief ShadowCubeMap::cullFace
+ *
+ * Fills visible with the objects whose bounding sphere touches the frustum of
+ * the face. The side planes of a 90 degree face are at 45 degrees, so a sphere
+ * is outside one when its offset across the axis exceeds its distance along the
+ * axis by more than radius * sqrt(2).
+ */
+void ShadowCubeMap::cullFace(int face, const QVector<Object*> &objects, Object *exclude) {
+    int axis = face / 2;
+    float sign = face % 2 ? -1.0f : 1.0f;
+    const float sqrt2 = 1.41421356f;
+
+    visible.clear();
+    for (int i = 0; i != objects.size(); ++i) {
+        Object *o = objects[i];
+        float r = o->getBoundingRadius();
+        if (o == exclude || r <= 0.0f) continue;
+
+        QVector3D relative = o->getLocation() - lightPosition;
+        float along = sign * relative[axis];
+        float u = relative[(axis + 1) % 3], v = relative[(axis + 2) % 3];
+        if (along + r < nearPlane || along - r > farPlane) continue;
+        if (u - along > r * sqrt2 || -u - along > r * sqrt2) continue;
+        if (v - along > r * sqrt2 || -v - along > r * sqrt2) continue;
+
+        // Spinning spheres cast the same shadow, only other meshes track rotation.
+        float angle = dynamic_cast<Sphere*>(o) ? 0.0f : o->getAngle();
+        Caster caster = {i, o->getLocation(), r, angle};
+        visible.push_back(caster);
+    }
+}
+
+/**
+ * @brief ShadowCubeMap::castersChanged
+ *
+ * A texel of a face covers 2 * distance / size at the distance of a caster,
+ * changes below half of that do not show in the map.
+ */
+bool ShadowCubeMap::castersChanged(const QVector<Caster> &before, const QVector<Caster> &after) {
+    if (before.size() != after.size()) return true;
+    for (int i = 0; i != before.size(); ++i) {
+        const Caster &a = before[i], &b = after[i];
+        if (a.object != b.object) return true;
+
+        float tolerance = (b.center - lightPosition).length() / size;
+        float spin = qDegreesToRadians(std::abs(a.angle - b.angle)) * b.radius;
+        if ((a.center - b.center).length() > tolerance || std::abs(a.radius - b.radius) > tolerance ||
+                spin > tolerance) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShadowCubeMap::renderFace(int face, SolarSystem *ss) {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, texture, 0);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    QMatrix4x4 transform = faceTransform(face);
+    glUniformMatrix4fv(uniformFaceTransform, 1, GL_FALSE, transform.data());
+    for (const Caster &caster : faces[face].casters) {
+        glUniformMatrix4fv(uniformModelTransform, 1, GL_FALSE, ss->getModelTransform(caster.object).constData());
+        ss->objects[caster.object]->draw();
+    }
+}
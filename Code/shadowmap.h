@@ -0,0 +1,92 @@
+#ifndef SHADOWMAP_H
+#define SHADOWMAP_H
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QVector>
+#include <QVector3D>
+
+#include "shadercache.h"
+#include "solarsystem.h"
+
+/**
+ * @brief The ShadowCubeMap class
+ *
+ * Depth cube map of a point light, rendered one face at a time. A face is only
+ * rendered again when the casters inside its frustum changed: one entered or
+ * left, or moved or rotated by more than half a shadow texel. Casters are
+ * culled per face with their bounding spheres. Each face can also be limited
+ * to one update every so many frames, so distant or busy faces can trade
+ * shadow latency for draw calls.
+ *
+ * The map stores regular perspective depth per face, the Phong shader turns
+ * the largest component of the light-to-fragment vector into the same depth
+ * and compares with samplerCubeShadow.
+ */
+class ShadowCubeMap : protected QOpenGLFunctions_3_3_Core {
+public:
+    ShadowCubeMap(int size = 1024);
+    ~ShadowCubeMap();
+
+    // Requires a current context.
+    void initialize(ShaderCache *cache);
+
+    // Renders the faces that need it, leaves the framebuffer unbound.
+    // The object at the light itself is not a caster.
+    void update(SolarSystem *ss, QVector3D light, Object *exclude);
+
+    // Render a face at most once every given number of frames, default 1.
+    void setUpdateInterval(int face, int frames) {faces[face].interval = qMax(1, frames);}
+    // Intervals of new maps, per face in GL order +X, -X, +Y, -Y, +Z, -Z,
+    // --shadow-interval.
+    static void setDefaultUpdateInterval(int face, int frames) {defaultIntervals[face] = qMax(1, frames);}
+    void setRange(float nearPlane, float farPlane);
+    // Marks all faces for rendering on the next update.
+    void invalidate();
+
+    GLuint getTexture() {return texture;}
+    int getSize() {return size;}
+    float getNearPlane() {return nearPlane;}
+    float getFarPlane() {return farPlane;}
+    // Faces rendered by the last update.
+    int getFacesRendered() {return facesRendered;}
+
+private:
+    struct Caster {
+        int object;         // Index in SolarSystem::objects.
+        QVector3D center;
+        float radius;
+        float angle;
+    };
+
+    struct Face {
+        QVector<Caster> casters;
+        bool dirty = true;
+        int interval = 1;
+        int age = 0;        // Frames since the face was rendered.
+    };
+
+    static int defaultIntervals[6];
+
+    int size;
+    float nearPlane = 1.0f, farPlane = 100000.0f;
+    QVector3D lightPosition;
+    int facesRendered = 0;
+
+    GLuint texture = 0;
+    GLuint framebuffer = 0;
+    QOpenGLShaderProgram program;
+    GLint uniformModelTransform;
+    GLint uniformFaceTransform;
+
+    Face faces[6];
+    QVector<Caster> visible;
+
+    QMatrix4x4 faceTransform(int face);
+    void cullFace(int face, const QVector<Object*> &objects, Object *exclude);
+    bool castersChanged(const QVector<Caster> &before, const QVector<Caster> &after);
+    void renderFace(int face, SolarSystem *ss);
+};
+
+#endif // SHADOWMAP_H
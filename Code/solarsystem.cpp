@@ -1,70 +1,510 @@
 #include "solarsystem.h"
-#include <QDebug>
+#include "log.h"
+#include <QHash>
+#include <cmath>
 
-#define rScale 10
-#define rotScale 10
-#define dfoScale 2500
-#define orbScale 5
+int SolarSystem::defaultFleetSize = 0;
+QString SolarSystem::defaultScene = ":/scenes/solarsystem.scene";
+SolarSystem::SimulationMode SolarSystem::defaultMode = SolarSystem::ANALYTIC;
+
+// Reach of the engine lights, spaceships have scale 2.
+static const float engineLightRadius = 250.0f;
+static const float fleetLightRadius = 150.0f;
+static const QVector3D engineLightColor(1.0f, 0.55f, 0.2f);
+
+// Bodies created between reads of the scene file.
+static const int sceneChunkSize = 4096;
+
+// Longest integration step in gravity mode, a moon orbit takes ~2.3 time units.
+static const float maxGravityStep = 0.005f;
 
 SolarSystem::SolarSystem()
 {
-    objects.reserve(12);
-
-    Sun *eye = new Sun("Eye", 0, 0);
-    eye->setLocation(QVector3D(0.1f,8000,0.1f));
-    Sun *eye2 = new Sun("Eye 2", 0, 0);
-    eye2->setLocation(QVector3D(0.1f,2200,0.1f));
-    objects.push_back(eye);
-    objects.push_back(eye2);
-
-    Sun *sun = new Sun("Sun", rScale*200, 0.001f);
-    objects.push_back(sun);
-    // Data from https://nssdc.gsfc.nasa.gov/planetary/factsheet/planet_table_ratio.html
-    Planet *mercury = new Planet("Mercury", ":/textures/mercury.jpg",   rScale*0.338f,  rotScale*58.f,      dfoScale*0.387f,    orbScale*0.241f,    sun);
-    Planet *venus = new Planet("Venus", ":/textures/venus.jpg",         rScale*0.949f,  rotScale*-244.0f,   dfoScale*0.723f,    orbScale*0.615f,    sun);
-    Planet *earth = new Planet("Earth", ":/textures/earth2.jpg",        rScale*1.0f,    rotScale*1.0f,      dfoScale*1.0f,      orbScale*1.0f,      sun);
-    Planet *moon = new Planet("Moon Earth", ":/textures/moon.jpg",      rScale*0.2724f, rotScale*27.4f,     dfoScale*0.00257f,  orbScale*0.0748f,   earth);
-    Planet *mars =  new Planet("Mars", ":/textures/mars.jpg",           rScale*0.532f,  rotScale*1.03f,     dfoScale*1.52f,     orbScale*1.88f,     sun);
-    Planet *jupiter = new Planet("Jupiter", ":/textures/jupiter.jpg",   rScale*11.21f,  rotScale*0.415f,    dfoScale*5.20f,     orbScale*11.9f,     sun);
-    Planet *saturn = new Planet("Saturn", ":/textures/saturn.jpg",      rScale*9.45f,   rotScale*0.445f,    dfoScale*9.58f,     orbScale*29.4f,     sun);
-    Planet *uranus = new Planet("Uranus", ":/textures/uranus.jpg",      rScale*4.01f,   rotScale*-0.72f,    dfoScale*19.20f,    orbScale*163.7f,    sun);
-    Planet *neptune = new Planet("Neptune", ":/textures/neptune.jpg",   rScale*3.88f,   rotScale*0.673f,    dfoScale*30.05f,    orbScale*247.9f,    sun);
-    planets.push_back(mercury);
-    planets.push_back(venus);
-    planets.push_back(earth);
-    planets.push_back(moon);
-    planets.push_back(mars);
-    planets.push_back(jupiter);
-    planets.push_back(saturn);
-    planets.push_back(uranus);
-    planets.push_back(neptune);
-
-    Spaceship *spaceship1 = new Spaceship("Apollo 13", ":/textures/cat_diff.png", 8.0f, earth, randomPlanet());
-    Spaceship *spaceship2 = new Spaceship("Spaceshuttle", ":/textures/cat_diff.png", 9.0f, earth, randomPlanet());
-    spaceships.push_back(spaceship1);
-    spaceships.push_back(spaceship2);
+    if (!loadScene(defaultScene) && defaultScene != ":/scenes/solarsystem.scene") {
+        LOG(Log::ASSETS, Log::WARNING) << "Falling back to the built-in solar system";
+        loadScene(":/scenes/solarsystem.scene");
+    }
 
-    for (Planet *p : planets) {
-        objects.push_back(p);
+    buildHierarchy();
+    addFleet(defaultFleetSize);
+    setSimulationMode(defaultMode);
+    updateTransforms();
+    updateSpatialIndex();
+}
+
+SolarSystem::~SolarSystem()
+{
+    qDeleteAll(objects);
+}
+
+/**
+ * @brief SolarSystem::loadScene
+ *
+ * Streams the scene in chunks, so a large catalog is never held twice. Models
+ * and textures are only named here, the AssetCache resolves them when the
+ * objects are loaded. On an error the objects of this scene are removed again.
+ */
+bool SolarSystem::loadScene(QString file) {
+    SceneReader reader;
+    if (!reader.open(file)) {
+        LOG(Log::ASSETS, Log::CRITICAL) << "Cannot load scene:" << reader.errorString();
+        return false;
     }
-    for (Spaceship *s : spaceships) {
-        objects.push_back(s);
+    int first = objects.size();
+    int firstPlanet = planets.size(), firstShip = spaceships.size();
+    if (reader.getBodyCount() > 0) {
+        objects.reserve(first + reader.getBodyCount());
+        listed.reserve(first + reader.getBodyCount());
+    }
+
+    bool ok = true;
+    QVector<SceneBody> chunk;
+    chunk.reserve(sceneChunkSize);
+    while (ok && reader.read(sceneChunkSize, chunk) > 0) {
+        for (const SceneBody &body : chunk) {
+            SceneBody b = body;
+            if (b.parent >= 0) b.parent += first;
+            Object *o = createObject(b);
+            if (!o) {
+                ok = false;
+                break;
+            }
+            objects.push_back(o);
+            listed.push_back(body.listed);
+        }
+        chunk.clear();
+    }
+    if (reader.hasError()) {
+        LOG(Log::ASSETS, Log::CRITICAL) << "Cannot load scene" << file << ":" << reader.errorString();
+        ok = false;
+    }
+    if (ok && !sun) {
+        LOG(Log::ASSETS, Log::CRITICAL) << "Scene" << file << "has no sun";
+        ok = false;
+    }
+    if (ok && spaceships.size() > firstShip && planets.isEmpty()) {
+        LOG(Log::ASSETS, Log::CRITICAL) << "Scene" << file << "has spaceships but no planets";
+        ok = false;
+    }
+
+    if (!ok) {
+        qDeleteAll(objects.begin() + first, objects.end());
+        objects.resize(first);
+        listed.resize(first);
+        planets.resize(firstPlanet);
+        spaceships.resize(firstShip);
+        if (sun && !objects.contains(sun)) sun = nullptr;
+        return false;
+    }
+
+    for (int i = firstShip; i != spaceships.size(); ++i) {
+        spaceships[i]->setMoveTo(randomPlanet());
+    }
+    LOG(Log::ASSETS, Log::INFO) << "Loaded" << objects.size() - first << "bodies from" << file;
+    return true;
+}
+
+Object *SolarSystem::createObject(const SceneBody &body) {
+    Object *parent = body.parent >= 0 ? objects[body.parent] : nullptr;
+    Object *o = nullptr;
+
+    switch (body.kind) {
+    case SceneBody::EYE:
+        o = new Sun(body.name, 0, 0);
+        o->setLocation(body.position);
+        break;
+    case SceneBody::SUN: {
+        Sun *s = body.texture.isEmpty() ? new Sun(body.name, body.radius, body.rotation)
+                                        : new Sun(body.name, body.radius, body.rotation, body.texture);
+        if (!sun) sun = s;
+        o = s;
+        break;
+    }
+    case SceneBody::PLANET: {
+        Sphere *around = dynamic_cast<Sphere*>(parent);
+        if (!around) {
+            LOG(Log::ASSETS, Log::CRITICAL) << body.name << "cannot orbit" << (parent ? parent->getName() : QString());
+            return nullptr;
+        }
+        Planet *p = new Planet(body.name, body.texture, body.radius, body.rotation, body.distance, body.period, around);
+        if (body.eccentricity != 0 || body.inclination != 0 || body.node != 0 || body.periapsis != 0 || body.anomaly != 0) {
+            OrbitalElements elements = p->getOrbit().getElements();
+            elements.eccentricity = body.eccentricity;
+            elements.inclination = body.inclination;
+            elements.ascendingNode = body.node;
+            elements.periapsis = body.periapsis;
+            elements.meanAnomaly = body.anomaly;
+            p->setOrbit(elements);
+        }
+        planets.push_back(p);
+        o = p;
+        break;
+    }
+    case SceneBody::SHIP: {
+        // The destination is picked once all planets are known.
+        Spaceship *s = new Spaceship(body.name, body.texture, body.speed, parent, parent);
+        // Picked against its triangles, see Picker.
+        s->setKeepModel(true);
+        spaceships.push_back(s);
+        o = s;
+        break;
     }
+    }
+
+    if (!body.model.isEmpty()) o->setModelFile(body.model);
+    return o;
+}
+
+Object *SolarSystem::findObject(QString name) {
+    for (Object *o : objects) {
+        if (o->getName() == name) return o;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief SolarSystem::buildHierarchy
+ *
+ * Adds every object after the object it orbits, whatever their order in objects.
+ */
+void SolarSystem::buildHierarchy() {
+    transforms.clear();
+    hierarchyOrder.clear();
+    QHash<Object*, int> nodes;
+    for (Object *o : objects) {
+        addToHierarchy(o, nodes);
+    }
+    transformNodes.clear();
+    for (Object *o : objects) {
+        transformNodes.push_back(nodes[o]);
+    }
+}
+
+int SolarSystem::addToHierarchy(Object *o, QHash<Object*, int> &nodes) {
+    if (nodes.contains(o)) return nodes[o];
+
+    Planet *planet = dynamic_cast<Planet*>(o);
+    int parent = planet ? addToHierarchy(planet->rotateAround, nodes) : -1;
+    int node = transforms.addNode(parent);
+    hierarchyOrder.push_back(o);
+    nodes[o] = node;
+    return node;
+}
+
+/**
+ * @brief SolarSystem::updateTransforms
+ *
+ * Hands the new locations, relative to the parent, to the hierarchy. Objects
+ * that did not move or spin, like the eye viewpoints, are not rebuilt.
+ */
+void SolarSystem::updateTransforms() {
+    for (int n = 0; n != hierarchyOrder.size(); ++n) {
+        Object *o = hierarchyOrder[n];
+        int parent = transforms.getParent(n);
+        QVector3D origin = parent >= 0 ? hierarchyOrder[parent]->getLocation() : QVector3D();
+        transforms.setLocal(n, o->getLocation() - origin, o->getScale(), o->getAngle());
+    }
+    transformsUpdated = transforms.update();
+}
+
+void SolarSystem::addFleet (int n) {
+    if (n <= 0 || planets.isEmpty()) return;
+    // Traffic leaves from Earth, or the first planet of other scenes.
+    Object *earth = findObject("Earth");
+    if (!earth) earth = planets[0];
+    fleet.setSeed(static_cast<quint32>(qrand()));
+    fleet.addShips(n, earth->getLocation(), earth->getScale(), planets.size(), 4.0f, 12.0f);
 }
 
 Planet *SolarSystem::randomPlanet () {
     return planets[qrand() % planets.size()];
 }
 
-void SolarSystem::simulate(float t, float s) {
-    for (Object *o : objects) {
-        o->update(t, s);
+void SolarSystem::simulate(double t, float s) {
+    steps++;
+    if (mode == GRAVITY) {
+        simulateGravity(t, s);
+    } else {
+        planCourses(t);
+        for (Object *o : hierarchyOrder) {
+            o->update(t, s);
+        }
+    }
+    if (fleet.size() > 0) {
+        QVector<float> radii;
+        radii.reserve(planets.size());
+        for (Planet *p : planets) {
+            radii.push_back(p->getScale());
+        }
+        if (mode == GRAVITY) {
+            // The planets leave their orbits, so the fleet steers.
+            QVector<QVector3D> targets;
+            targets.reserve(planets.size());
+            for (Planet *p : planets) {
+                targets.push_back(p->getLocation());
+            }
+            fleet.update(s, targets, radii, ThreadPool::instance());
+        } else {
+            QVector<Navigator::Ephemeris> targets;
+            targets.reserve(planets.size());
+            for (Planet *p : planets) {
+                targets.push_back([this, p](double at) {return positionAt(p, at);});
+            }
+            fleet.navigate(t, targets, radii, timeStep, ThreadPool::instance());
+        }
     }
     for (Spaceship *s : spaceships) {
         if (s->hasReachedDestination()) {
-            qDebug() << "Spaceship" << s->getName() << "reached planet" << s->getDestination()->getName();
+            LOG(Log::SIMULATION, Log::DEBUG) << "Spaceship" << s->getName() << "reached planet" << s->getDestination()->getName();
             s->setMoveTo(randomPlanet());
-            qDebug() << "Spaceship" << s->getName() << "new destination: " << s->getDestination()->getName();
+            LOG(Log::SIMULATION, Log::DEBUG) << "Spaceship" << s->getName() << "new destination: " << s->getDestination()->getName();
+        }
+    }
+
+    updateTransforms();
+    updateSpatialIndex();
+}
+
+/**
+ * @brief SolarSystem::gatherLights
+ *
+ * Places a light just behind every spaceship, on the side facing away from its
+ * destination.
+ */
+void SolarSystem::gatherLights(QVector<PointLight> &lights) {
+    lights.clear();
+    lights.reserve(spaceships.size() + fleet.size());
+    for (Spaceship *s : spaceships) {
+        QVector3D heading = (s->getDestination()->getLocation() - s->getLocation()).normalized();
+        PointLight light = {s->getLocation() - heading * s->getScale() * 1.5f, engineLightRadius, engineLightColor};
+        lights.push_back(light);
+    }
+    for (int i = 0; i != fleet.size(); ++i) {
+        QVector3D location = fleet.getLocation(i);
+        QVector3D heading = (planets[fleet.getDestination(i)]->getLocation() - location).normalized();
+        PointLight light = {location - heading * 3.0f, fleetLightRadius, engineLightColor * 0.6f};
+        lights.push_back(light);
+    }
+}
+
+/**
+ * @brief SolarSystem::updateSpatialIndex
+ *
+ * Refits the grid to the bounding spheres of all objects. Grid items are
+ * indices into objects.
+ */
+void SolarSystem::updateSpatialIndex() {
+    QVector<QVector3D> centers;
+    QVector<float> radii;
+    centers.reserve(objects.size());
+    radii.reserve(objects.size());
+    for (Object *o : objects) {
+        centers.push_back(o->getLocation());
+        radii.push_back(o->getBoundingRadius());
+    }
+    grid.refit(centers, radii);
+}
+
+QVector<Object*> SolarSystem::objectsNear(QVector3D p, float r) {
+    QVector<Object*> result;
+    for (int i : grid.queryRadius(p, r)) {
+        result.push_back(objects[i]);
+    }
+    return result;
+}
+
+QVector<Object*> SolarSystem::nearestObjects(QVector3D p, int k) {
+    QVector<Object*> result;
+    for (int i : grid.queryNearest(p, k)) {
+        result.push_back(objects[i]);
+    }
+    return result;
+}
+
+QVector<QPair<Object*, Object*>> SolarSystem::overlappingObjects() {
+    QVector<QPair<Object*, Object*>> result;
+    for (QPair<int, int> pair : grid.overlappingPairs()) {
+        result.push_back(qMakePair(objects[pair.first], objects[pair.second]));
+    }
+    return result;
+}
+
+/**
+ * @brief SolarSystem::positionAt
+ *
+ * Where the orbits put o at time t, without simulating up to it: the sum of
+ * the orbit offsets up to a body that does not orbit. Spaceships and bodies
+ * moved by gravity are where the last simulation step left them.
+ */
+QVector3D SolarSystem::positionAt(Object *o, double t) {
+    Planet *p = dynamic_cast<Planet*>(o);
+    if (!p) return o->getLocation();
+    return positionAt(p->rotateAround, t) + p->getOrbit().position(t);
+}
+
+void SolarSystem::resetTime() {
+    // A jump is not integrated, gravity starts again from the orbits at the new time.
+    gravityTime = -1;
+    clearCourses();
+}
+
+/**
+ * @brief SolarSystem::planCourses
+ *
+ * Gives every spaceship without a course an intercept course to its
+ * destination, see Navigator. A course is kept until the ship arrives or gets
+ * a new destination, the time jumps or the simulation mode changes, so most
+ * steps only evaluate it. A course that would start later than t was planned
+ * before the time went back, it is planned again.
+ */
+void SolarSystem::planCourses(double t) {
+    for (Spaceship *ship : spaceships) {
+        const Trajectory &course = ship->getCourse();
+        if (course.isValid() && t >= course.departureTime) continue;
+        Object *target = ship->getDestination();
+        Trajectory planned;
+        Navigator::intercept([this, target](double at) {return positionAt(target, at);}, ship->getLocation(), t,
+                             ship->getSpeed() / timeStep, ship->getArrivalDistance(), planned);
+        ship->setCourse(planned);
+    }
+}
+
+void SolarSystem::clearCourses() {
+    for (Spaceship *ship : spaceships) {
+        ship->clearCourse();
+    }
+    fleet.clearCourses();
+}
+
+void SolarSystem::setSimulationMode(SimulationMode m) {
+    if (m == mode) return;
+    mode = m;
+    // The bodies are seeded on the next simulation step, when the time is known.
+    gravityTime = -1;
+    // Gravity steers, and afterwards the ships are off their courses.
+    clearCourses();
+    LOG(Log::SIMULATION, Log::INFO) << "Simulation mode" << (mode == GRAVITY ? "gravity" : "analytic");
+}
+
+/**
+ * @brief SolarSystem::startGravity
+ *
+ * Seeds the gravity simulation with the analytic state at time t. By Kepler's
+ * third law an orbit with semi-major axis a and period T around a parent of
+ * gravitational parameter mu has mu = a^3 (2 pi / T)^2; parents average this
+ * over their satellites.
+ * Planets without satellites get the mass of their volume at the mean density
+ * of the planets that have them. Spaceships are massless.
+ */
+void SolarSystem::startGravity(double t) {
+    QHash<Object*, float> mu;
+    QHash<Object*, int> satellites;
+    for (Planet *p : planets) {
+        mu[p->rotateAround] += static_cast<float>(p->getOrbit().getParentMu());
+        satellites[p->rotateAround]++;
+    }
+    float density = 0;
+    int densities = 0;
+    for (Object *o : mu.keys()) {
+        mu[o] /= satellites[o];
+        if (dynamic_cast<Planet*>(o) && o->getScale() > 0) {
+            density += mu[o] / std::pow(o->getScale(), 3.0f);
+            densities++;
+        }
+    }
+    if (densities > 0) density /= densities;
+
+    gravity.clear();
+    gravityObjects.clear();
+
+    QHash<Object*, QVector3D> velocity;
+    for (Object *o : mu.keys()) {
+        if (dynamic_cast<Planet*>(o)) continue;
+        velocity[o] = QVector3D();
+        gravity.addBody(o->getLocation(), QVector3D(), mu[o]);
+        gravityObjects.push_back(o);
+    }
+    // Parents come before their satellites in planets.
+    for (Planet *p : planets) {
+        velocity[p] = velocity.value(p->rotateAround) + p->getOrbit().velocity(t);
+        float m = mu.contains(p) ? mu[p] : density * std::pow(p->getScale(), 3.0f);
+        gravity.addBody(p->getLocation(), velocity[p], m);
+        gravityObjects.push_back(p);
+    }
+    for (Spaceship *s : spaceships) {
+        gravity.addBody(s->getLocation(), QVector3D(), 0);
+        gravityObjects.push_back(s);
+    }
+}
+
+/**
+ * @brief SolarSystem::simulateGravity
+ *
+ * Integrates the gravity bodies to time t. Spaceships thrust towards their
+ * destination at their analytic cruise speed: they move s*speed per frame, a
+ * frame being t / s time units apart, so their velocity is speed*s/dt.
+ */
+void SolarSystem::simulateGravity(double t, float s) {
+    if (gravityTime < 0) {
+        for (Object *o : hierarchyOrder) {
+            o->update(t, s);
         }
+        startGravity(t);
+        gravityTime = t;
+        return;
+    }
+
+    // Only rotation remains for objects outside the gravity simulation.
+    for (Object *o : objects) {
+        if (!dynamic_cast<Planet*>(o) && !dynamic_cast<Spaceship*>(o)) {
+            o->update(t, s);
+        }
+    }
+    if (t <= gravityTime) return;
+    float dt = static_cast<float>(t - gravityTime);
+    gravityTime = t;
+
+    // Steer over a few frames so gravity still bends the course.
+    float response = 8.0f * dt;
+    for (int i = 0; i != gravityObjects.size(); ++i) {
+        Spaceship *ship = dynamic_cast<Spaceship*>(gravityObjects[i]);
+        if (!ship) continue;
+        QVector3D direction = (ship->getDestination()->getLocation() - ship->getLocation()).normalized();
+        QVector3D desired = direction * ship->getSpeed() * s / dt;
+        gravity.setThrust(i, (desired - gravity.getVelocity(i)) / response);
+    }
+
+    int steps = static_cast<int>(std::ceil(dt / maxGravityStep));
+    for (int k = 0; k != steps; ++k) {
+        gravity.step(dt / steps, ThreadPool::instance());
+    }
+
+    for (int i = 0; i != gravityObjects.size(); ++i) {
+        gravityObjects[i]->setLocation(gravity.getPosition(i));
+    }
+}
+
+/**
+ * @brief SolarSystem::reportMemory
+ *
+ * Objects are counted by their own size and their strings, the models and
+ * textures they use are reported by the AssetCache.
+ */
+void SolarSystem::reportMemory(MemoryReport &report) {
+    qint64 objectBytes = MemoryReport::bytes(objects) + MemoryReport::bytes(planets) +
+                         MemoryReport::bytes(spaceships) + MemoryReport::bytes(listed);
+    for (Object *o : objects) {
+        if (dynamic_cast<Planet*>(o)) objectBytes += sizeof(Planet);
+        else if (dynamic_cast<Sun*>(o)) objectBytes += sizeof(Sun);
+        else if (dynamic_cast<Spaceship*>(o)) objectBytes += sizeof(Spaceship);
+        else objectBytes += sizeof(Object);
+        objectBytes += o->getStringBytes();
     }
+    report.add(MemoryReport::CPU, "scene", "objects", objectBytes);
+    report.add(MemoryReport::CPU, "scene", "transform hierarchy",
+               transforms.getMemoryUsage() + MemoryReport::bytes(hierarchyOrder) + MemoryReport::bytes(transformNodes));
+    report.add(MemoryReport::CPU, "simulation", "spatial grid", grid.getMemoryUsage());
+    report.add(MemoryReport::CPU, "simulation", "fleet", fleet.getMemoryUsage());
+    report.add(MemoryReport::CPU, "simulation", "gravity",
+               gravity.getMemoryUsage() + MemoryReport::bytes(gravityObjects));
 }
@@ -2,18 +2,108 @@
 #define SOLARSYSTEM_H
 
 #include "object.h"
+#include <QHash>
+#include "fleet.h"
+#include "lightclusters.h"
+#include "memoryreport.h"
+#include "nbody.h"
+#include "scenefile.h"
+#include "spatialgrid.h"
+#include "transformhierarchy.h"
 
 class SolarSystem
 {
 public:
+    // ANALYTIC moves the planets on fixed circular orbits, GRAVITY integrates
+    // the planets and spaceships under their mutual gravity.
+    enum SimulationMode {
+        ANALYTIC = 0, GRAVITY
+    };
+
     SolarSystem();
+    ~SolarSystem();
+    // Objects in the order of the scene file, owned by the solar system.
     QVector<Object*> objects;
     QVector <Planet*> planets;
     QVector<Spaceship*> spaceships;
+    // Traffic simulated without a mesh, destinations index planets.
+    Fleet fleet;
+
+    // The light source of the scene.
+    Sun *getSun () {return sun;}
+    Object *findObject (QString name);
+    // Whether objects[object] is offered as a viewpoint.
+    bool isListed (int object) {return listed[object];}
+
+    // Appends the bodies of a scene file, see SceneReader.
+    bool loadScene (QString file);
+    static void setDefaultScene (QString file) {defaultScene = file;}
+
+    void addFleet (int n);
+    static void setDefaultFleetSize (int n) {defaultFleetSize = n;}
+
+    void setSimulationMode (SimulationMode m);
+    SimulationMode getSimulationMode () {return mode;}
+    static void setDefaultSimulationMode (SimulationMode m) {defaultMode = m;}
+
+    // t is the simulation time, s the step scale passed to Object::update.
+    void simulate (double t, float s);
+    // Ephemeris of o at any time, see Orbit.
+    QVector3D positionAt (Object *o, double t);
+    // Calls to simulate so far, to tell whether anything moved.
+    quint64 getSteps () {return steps;}
+    // Call when the time jumps instead of advancing.
+    void resetTime ();
+    // Simulation time of one unit of s, in which a spaceship covers its speed.
+    void setTimeStep (float step) {timeStep = step;}
 
-    void simulate (float t, float s);
+    // Engine lights of all spaceships, including the fleet, for clustered shading.
+    void gatherLights (QVector<PointLight> &lights);
+
+    // Model and normal matrices of objects[object] after the last simulation step.
+    const QMatrix4x4 &getModelTransform (int object) {return transforms.getWorld(transformNodes[object]);}
+    const QMatrix3x3 &getNormalTransform (int object) {return transforms.getNormal(transformNodes[object]);}
+    int getTransformsUpdated () {return transformsUpdated;}
+
+    // Proximity queries against the bounding spheres of the last simulation step.
+    QVector<Object*> objectsNear (QVector3D p, float r);
+    QVector<Object*> nearestObjects (QVector3D p, int k);
+    QVector<QPair<Object*, Object*>> overlappingObjects ();
+
+    void reportMemory (MemoryReport &report);
 private:
+    Sun *sun = nullptr;
+    QVector<bool> listed;
+    static QString defaultScene;
+    SpatialGrid grid;
+
+    // Planets are children of what they orbit. Objects are updated in node
+    // order, so a parent always moves before its children.
+    TransformHierarchy transforms;
+    QVector<Object*> hierarchyOrder;
+    QVector<int> transformNodes;
+    int transformsUpdated = 0;
+    quint64 steps = 0;
+    static int defaultFleetSize;
+    static SimulationMode defaultMode;
+
+    SimulationMode mode = ANALYTIC;
+    NBody gravity;
+    // The object of each gravity body.
+    QVector<Object*> gravityObjects;
+    double gravityTime = -1;
+    float timeStep = 0.016f/10.0f;
+
     Planet *randomPlanet();
+    Object *createObject(const SceneBody &body);
+    void buildHierarchy();
+    int addToHierarchy(Object *o, QHash<Object*, int> &nodes);
+    void updateTransforms();
+    void updateSpatialIndex();
+    void planCourses(double t);
+    void clearCourses();
+    void startGravity(double t);
+    void simulateGravity(double t, float s);
 };
 
 #endif // SOLARSYSTEM_H
@@ -0,0 +1,302 @@
+#include "spatialgrid.h"
+#include "memoryreport.h"
+
+#include <QSet>
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+// Bucket of the spheres that are too large for the grid.
+static const unsigned noBucket = ~0u;
+
+SpatialGrid::Cell SpatialGrid::cellOf(QVector3D p) {
+    return {static_cast<int>(std::floor(p.x() / cellSize)),
+            static_cast<int>(std::floor(p.y() / cellSize)),
+            static_cast<int>(std::floor(p.z() / cellSize))};
+}
+
+unsigned SpatialGrid::bucketOf(Cell c) {
+    if (dense) {
+        unsigned sizeY = maxCell.y - minCell.y + 1, sizeZ = maxCell.z - minCell.z + 1;
+        return ((c.x - minCell.x) * sizeY + (c.y - minCell.y)) * sizeZ + (c.z - minCell.z);
+    }
+    unsigned h = static_cast<unsigned>(c.x) * 73856093u ^
+                 static_cast<unsigned>(c.y) * 19349663u ^
+                 static_cast<unsigned>(c.z) * 83492791u;
+    return h & bucketMask;
+}
+
+void SpatialGrid::build(const QVector<QVector3D> &c, const QVector<float> &r) {
+    centers = c;
+    radii = r;
+    layout();
+}
+
+/**
+ * @brief SpatialGrid::refit
+ *
+ * Updates the spheres for a new simulation step. Objects move little per step
+ * compared to a cell, so usually every sphere stays in its bucket and only the
+ * centers are replaced; otherwise the layout is rebuilt, which is linear anyway.
+ */
+void SpatialGrid::refit(const QVector<QVector3D> &c, const QVector<float> &r) {
+    bool rebuild = c.size() != centers.size();
+    centers = c;
+    radii = r;
+
+    for (int i = 0; i != centers.size() && !rebuild; ++i) {
+        if (isLarge(i)) {
+            rebuild = itemBucket[i] != noBucket;
+            continue;
+        }
+        Cell cell = cellOf(centers[i]);
+        rebuild = !inBounds(cell) || itemBucket[i] != bucketOf(cell);
+    }
+
+    if (rebuild) {
+        layout();
+    } else {
+        gather();
+    }
+}
+
+void SpatialGrid::layout() {
+    int n = centers.size();
+
+    large.clear();
+    itemBucket.resize(n);
+
+    bool first = true;
+    for (int i = 0; i != n; ++i) {
+        if (isLarge(i)) {
+            large.append(i);
+            itemBucket[i] = noBucket;
+            continue;
+        }
+        Cell c = cellOf(centers[i]);
+        if (first) {
+            minCell = maxCell = c;
+            first = false;
+        }
+        minCell = {std::min(minCell.x, c.x), std::min(minCell.y, c.y), std::min(minCell.z, c.z)};
+        maxCell = {std::max(maxCell.x, c.x), std::max(maxCell.y, c.y), std::max(maxCell.z, c.z)};
+    }
+
+    double cells = double(maxCell.x - minCell.x + 1) * (maxCell.y - minCell.y + 1) * (maxCell.z - minCell.z + 1);
+    dense = cells <= 4.0 * n;
+
+    unsigned buckets = 1;
+    if (dense) {
+        buckets = static_cast<unsigned>(cells);
+    } else {
+        while (buckets < 2u * n) buckets <<= 1;
+    }
+    bucketMask = buckets - 1;
+    bucketStart.fill(0, buckets + 1);
+
+    // Not itemBucket[i] == noBucket, that is stale for spheres that shrank.
+    for (int i = 0; i != n; ++i) {
+        if (isLarge(i)) continue;
+        itemBucket[i] = bucketOf(cellOf(centers[i]));
+        bucketStart[itemBucket[i] + 1]++;
+    }
+
+    for (unsigned b = 0; b != buckets; ++b) {
+        bucketStart[b + 1] += bucketStart[b];
+    }
+
+    cellItems.resize(bucketStart[buckets]);
+    QVector<int> fill = bucketStart;
+    for (int i = 0; i != n; ++i) {
+        if (itemBucket[i] != noBucket) {
+            cellItems[fill[itemBucket[i]]++] = i;
+        }
+    }
+    gather();
+}
+
+void SpatialGrid::gather() {
+    cellCenters.resize(cellItems.size());
+    cellRadii.resize(cellItems.size());
+    for (int k = 0; k != cellItems.size(); ++k) {
+        cellCenters[k] = centers[cellItems[k]];
+        cellRadii[k] = radii[cellItems[k]];
+    }
+}
+
+QVector<int> SpatialGrid::queryRadius(QVector3D p, float radius) {
+    QVector<int> result;
+
+    auto consider = [&](int i, QVector3D c, float r) {
+        float reach = radius + r;
+        if ((c - p).lengthSquared() <= reach * reach) {
+            result.append(i);
+        }
+    };
+
+    for (int i : large) {
+        consider(i, centers[i], radii[i]);
+    }
+    if (cellItems.isEmpty()) return result;
+
+    // Grid spheres are binned by center and at most half a cell in radius.
+    float reach = radius + cellSize * 0.5f;
+    Cell lo = cellOf(p - QVector3D(reach, reach, reach));
+    Cell hi = cellOf(p + QVector3D(reach, reach, reach));
+    lo = {std::max(lo.x, minCell.x), std::max(lo.y, minCell.y), std::max(lo.z, minCell.z)};
+    hi = {std::min(hi.x, maxCell.x), std::min(hi.y, maxCell.y), std::min(hi.z, maxCell.z)};
+    if (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z) return result;
+
+    // A query covering more cells than there are spheres is cheaper as a scan.
+    double cells = double(hi.x - lo.x + 1) * (hi.y - lo.y + 1) * (hi.z - lo.z + 1);
+    if (cells >= cellItems.size()) {
+        for (int k = 0; k != cellItems.size(); ++k) {
+            consider(cellItems[k], cellCenters[k], cellRadii[k]);
+        }
+        return result;
+    }
+
+    // Several cells can hash to one bucket, visit each bucket once.
+    QVector<unsigned> visit;
+    visit.reserve(static_cast<int>(cells));
+    for (int x = lo.x; x <= hi.x; ++x) {
+        for (int y = lo.y; y <= hi.y; ++y) {
+            for (int z = lo.z; z <= hi.z; ++z) {
+                visit.append(bucketOf({x, y, z}));
+            }
+        }
+    }
+    std::sort(visit.begin(), visit.end());
+    visit.erase(std::unique(visit.begin(), visit.end()), visit.end());
+
+    for (unsigned b : visit) {
+        for (int k = bucketStart[b]; k != bucketStart[b + 1]; ++k) {
+            consider(cellItems[k], cellCenters[k], cellRadii[k]);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief SpatialGrid::queryNearest
+ *
+ * Searches rings of cells around p outwards. Every sphere outside ring r is at
+ * least r cells away, so the search stops once the k-th candidate is closer.
+ */
+QVector<int> SpatialGrid::queryNearest(QVector3D p, int k) {
+    QVector<int> result;
+    if (k <= 0 || centers.isEmpty()) return result;
+
+    std::priority_queue<QPair<float, int>> heap;
+    auto consider = [&](int i, QVector3D c) {
+        float d = (c - p).lengthSquared();
+        if (static_cast<int>(heap.size()) < k) {
+            heap.push(qMakePair(d, i));
+        } else if (d < heap.top().first) {
+            heap.pop();
+            heap.push(qMakePair(d, i));
+        }
+    };
+
+    for (int i : large) {
+        consider(i, centers[i]);
+    }
+
+    if (!cellItems.isEmpty()) {
+        Cell c = cellOf(p);
+        int rings = std::max({std::abs(c.x - minCell.x), std::abs(maxCell.x - c.x),
+                              std::abs(c.y - minCell.y), std::abs(maxCell.y - c.y),
+                              std::abs(c.z - minCell.z), std::abs(maxCell.z - c.z)});
+        QSet<unsigned> visited;
+
+        for (int r = 0; r <= rings; ++r) {
+            for (int dx = -r; dx <= r; ++dx) {
+                int x = c.x + dx;
+                if (x < minCell.x || x > maxCell.x) continue;
+                for (int dy = -r; dy <= r; ++dy) {
+                    int y = c.y + dy;
+                    if (y < minCell.y || y > maxCell.y) continue;
+                    // Inside the ring only the two z caps belong to it.
+                    bool edge = std::abs(dx) == r || std::abs(dy) == r;
+                    int step = edge ? 1 : 2 * r;
+                    for (int dz = -r; dz <= r; dz += step) {
+                        int z = c.z + dz;
+                        if (z < minCell.z || z > maxCell.z) continue;
+                        unsigned b = bucketOf({x, y, z});
+                        if (visited.contains(b)) continue;
+                        visited.insert(b);
+                        for (int n = bucketStart[b]; n != bucketStart[b + 1]; ++n) {
+                            consider(cellItems[n], cellCenters[n]);
+                        }
+                    }
+                }
+            }
+
+            float bound = r * cellSize;
+            if (static_cast<int>(heap.size()) == k && heap.top().first <= bound * bound) break;
+        }
+    }
+
+    result.resize(static_cast<int>(heap.size()));
+    for (int i = result.size() - 1; i >= 0; --i) {
+        result[i] = heap.top().second;
+        heap.pop();
+    }
+    return result;
+}
+
+QVector<QPair<int, int>> SpatialGrid::overlappingPairs() {
+    QVector<QPair<int, int>> pairs;
+
+    // Two grid spheres can only touch when their cells are neighbours. Spheres of
+    // one cell are adjacent in cellItems, so the neighbourhood is reused between them.
+    unsigned visit[27];
+    int count = 0;
+    Cell last = {0, 0, 0};
+    for (int k = 0; k != cellItems.size(); ++k) {
+        int i = cellItems[k];
+        QVector3D center = cellCenters[k];
+        float radius = cellRadii[k];
+        Cell c = cellOf(center);
+
+        if (k == 0 || c.x != last.x || c.y != last.y || c.z != last.z) {
+            count = 0;
+            for (int dx = -1; dx <= 1; ++dx) {
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dz = -1; dz <= 1; ++dz) {
+                        Cell n = {c.x + dx, c.y + dy, c.z + dz};
+                        if (inBounds(n)) visit[count++] = bucketOf(n);
+                    }
+                }
+            }
+            std::sort(visit, visit + count);
+            count = static_cast<int>(std::unique(visit, visit + count) - visit);
+            last = c;
+        }
+
+        for (int v = 0; v != count; ++v) {
+            for (int n = bucketStart[visit[v]]; n != bucketStart[visit[v] + 1]; ++n) {
+                int j = cellItems[n];
+                float reach = radius + cellRadii[n];
+                if (j > i && (center - cellCenters[n]).lengthSquared() <= reach * reach) {
+                    pairs.append(qMakePair(i, j));
+                }
+            }
+        }
+    }
+
+    // Large spheres pair with everything they touch; between two large ones only once.
+    for (int i : large) {
+        for (int j : queryRadius(centers[i], radii[i])) {
+            if (j == i || (itemBucket[j] == noBucket && j < i)) continue;
+            pairs.append(qMakePair(std::min(i, j), std::max(i, j)));
+        }
+    }
+    return pairs;
+}
+
+qint64 SpatialGrid::getMemoryUsage() {
+    return MemoryReport::bytes(centers) + MemoryReport::bytes(radii) + MemoryReport::bytes(large) +
+           MemoryReport::bytes(itemBucket) + MemoryReport::bytes(bucketStart) + MemoryReport::bytes(cellItems) +
+           MemoryReport::bytes(cellCenters) + MemoryReport::bytes(cellRadii);
+}
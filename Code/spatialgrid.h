@@ -0,0 +1,76 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <QPair>
+#include <QVector>
+#include <QVector3D>
+
+/**
+ * @brief The SpatialGrid class
+ *
+ * Uniform grid over bounding spheres for proximity queries.
+ * Spheres are binned by their center into cells of cellSize. When the occupied
+ * cells fit in a few times the number of spheres the cells are stored densely, so
+ * neighbouring cells are neighbours in memory, otherwise they are hashed. Spheres with a
+ * radius above half a cell are kept in a separate list that every query checks
+ * (the sun and the gas giants), so cell lookups never need to look further
+ * than the neighbouring cells.
+ *
+ * Items are identified by the index they were given in build().
+ */
+class SpatialGrid {
+public:
+    SpatialGrid(float cellSize = 500.0f) : cellSize(cellSize) {}
+
+    void setCellSize(float size) {cellSize = size;}
+    float getCellSize() {return cellSize;}
+    int size() {return centers.size();}
+
+    // Full rebuild from the given spheres.
+    void build(const QVector<QVector3D> &c, const QVector<float> &r);
+    // Moves the spheres, only rebuilds the cell layout when one changed cell.
+    void refit(const QVector<QVector3D> &c, const QVector<float> &r);
+
+    // All spheres intersecting the query sphere.
+    QVector<int> queryRadius(QVector3D p, float radius);
+    // The k spheres with the nearest centers, closest first.
+    QVector<int> queryNearest(QVector3D p, int k);
+    // Every pair of intersecting spheres, with first < second.
+    QVector<QPair<int, int>> overlappingPairs();
+
+    qint64 getMemoryUsage();
+
+private:
+    struct Cell {
+        int x, y, z;
+    };
+
+    float cellSize;
+
+    QVector<QVector3D> centers;
+    QVector<float> radii;
+    QVector<int> large;
+
+    // Counting sort layout: items of bucket b are cellItems[bucketStart[b] .. bucketStart[b+1]).
+    QVector<unsigned> itemBucket;
+    QVector<int> bucketStart;
+    QVector<int> cellItems;
+    // Copies of the grid spheres in cellItems order, so scans stay in cache.
+    QVector<QVector3D> cellCenters;
+    QVector<float> cellRadii;
+    unsigned bucketMask = 0;
+    bool dense = false;
+    Cell minCell = {0, 0, 0}, maxCell = {0, 0, 0};
+
+    Cell cellOf(QVector3D p);
+    unsigned bucketOf(Cell c);
+    bool isLarge(int i) {return radii[i] > cellSize * 0.5f;}
+    bool inBounds(Cell c) {
+        return c.x >= minCell.x && c.y >= minCell.y && c.z >= minCell.z &&
+               c.x <= maxCell.x && c.y <= maxCell.y && c.z <= maxCell.z;
+    }
+    void layout();
+    void gather();
+};
+
+#endif // SPATIALGRID_H
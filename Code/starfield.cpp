@@ -0,0 +1,252 @@
+#include "starfield.h"
+#include "log.h"
+
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextStream>
+#include <QtEndian>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+Q_STATIC_ASSERT(sizeof(StarCatalog::Star) == 8);
+
+static const quint32 catalogMagic = 0x42525453;  // "STRB"
+static const quint32 catalogVersion = 1;
+static const int headerSize = 16;
+
+// Stars of the generated sky.
+static const int generatedStars = 100000;
+
+QString StarField::defaultCatalog;
+
+// Obliquity of the ecliptic, the tilt between the equator and the planets' orbits.
+static const float obliquity = 23.439f;
+
+StarCatalog::~StarCatalog() {
+    close();
+}
+
+void StarCatalog::close() {
+    if (mapped) file.unmap(mapped);
+    if (file.isOpen()) file.close();
+    mapped = nullptr;
+    data = nullptr;
+    count = 0;
+    parsed.clear();
+    error.clear();
+}
+
+bool StarCatalog::open(QString name) {
+    close();
+    file.setFileName(name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("Cannot open %1: %2").arg(name, file.errorString());
+        return false;
+    }
+
+    char header[headerSize];
+    if (file.peek(header, headerSize) != headerSize || qFromLittleEndian<quint32>(header) != catalogMagic) {
+        return readCsv();
+    }
+    if (qFromLittleEndian<quint32>(header + 4) != catalogVersion) {
+        error = QString("%1 is not a version %2 star catalog").arg(name).arg(catalogVersion);
+        return false;
+    }
+    qint32 stars = qFromLittleEndian<qint32>(header + 8);
+    if (stars < 0 || headerSize + qint64(stars) * qint64(sizeof(Star)) > file.size()) {
+        error = QString("%1 is truncated").arg(name);
+        return false;
+    }
+
+    mapped = file.map(0, headerSize + qint64(stars) * sizeof(Star));
+    if (mapped) {
+        data = reinterpret_cast<const Star*>(mapped + headerSize);
+    } else {
+        // Files in resources or on some file systems cannot be mapped.
+        file.seek(headerSize);
+        parsed.resize(stars);
+        file.read(reinterpret_cast<char*>(parsed.data()), qint64(stars) * sizeof(Star));
+        data = parsed.constData();
+    }
+    count = stars;
+    return true;
+}
+
+bool StarCatalog::readCsv() {
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QStringList fields = in.readLine().split(',');
+        if (fields.size() < 4) continue;
+        bool ok[4];
+        float values[4];
+        for (int i = 0; i != 4; ++i) {
+            values[i] = fields[i].trimmed().toFloat(&ok[i]);
+        }
+        if (!ok[0] || !ok[1] || !ok[2]) continue;
+        parsed.push_back(makeStar(values[0], values[1], values[2], ok[3] ? values[3] : 0.65f));
+    }
+    if (parsed.isEmpty()) {
+        error = QString("%1 has no stars").arg(file.fileName());
+        return false;
+    }
+    data = parsed.constData();
+    count = parsed.size();
+    return true;
+}
+
+/**
+ * @brief StarCatalog::generate
+ *
+ * About a third of the stars lie in a band like the Milky Way. The number of
+ * stars brighter than m grows by about 10^0.5 per magnitude, with some 5000
+ * brighter than magnitude 6 as in the real sky.
+ */
+void StarCatalog::generate(int n, quint32 seed) {
+    close();
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> color(0.65f, 0.35f);
+
+    float faintest = 6.0f + 2.0f * std::log10(std::max(n, 1) / 5000.0f);
+    QVector3D bandNormal(0.0f, 0.5f, 0.8660254f);
+
+    parsed.resize(n);
+    for (int i = 0; i != n; ++i) {
+        float z = 2.0f * uniform(random) - 1.0f;
+        float phi = 2.0f * float(M_PI) * uniform(random);
+        float r = std::sqrt(1.0f - z * z);
+        QVector3D d(r * std::cos(phi), r * std::sin(phi), z);
+        if (uniform(random) < 0.35f) {
+            d = (d - bandNormal * QVector3D::dotProduct(d, bandNormal) * 0.9f).normalized();
+        }
+
+        float magnitude = std::max(-1.5f, faintest + 2.0f * std::log10(std::max(uniform(random), 1.0e-6f)));
+        Star &s = parsed[i];
+        s.direction[0] = static_cast<qint16>(std::lround(d.x() * 32767.0f));
+        s.direction[1] = static_cast<qint16>(std::lround(d.y() * 32767.0f));
+        s.direction[2] = static_cast<qint16>(std::lround(d.z() * 32767.0f));
+        s.magnitude = static_cast<qint8>(std::lround(qBound(-12.8f, magnitude, 12.7f) * 10.0f));
+        s.colorIndex = static_cast<qint8>(std::lround(qBound(-0.5f, color(random), 2.5f) * 50.0f));
+    }
+    data = parsed.constData();
+    count = n;
+}
+
+StarCatalog::Star StarCatalog::makeStar(float ra, float dec, float magnitude, float colorIndex) {
+    float a = qDegreesToRadians(ra), b = qDegreesToRadians(dec), e = qDegreesToRadians(obliquity);
+    QVector3D equatorial(std::cos(b) * std::cos(a), std::cos(b) * std::sin(a), std::sin(b));
+    float x = equatorial.x();
+    float y = equatorial.y() * std::cos(e) + equatorial.z() * std::sin(e);
+    float z = -equatorial.y() * std::sin(e) + equatorial.z() * std::cos(e);
+
+    // Ecliptic north is up in the world.
+    Star s;
+    s.direction[0] = static_cast<qint16>(std::lround(x * 32767.0f));
+    s.direction[1] = static_cast<qint16>(std::lround(z * 32767.0f));
+    s.direction[2] = static_cast<qint16>(std::lround(-y * 32767.0f));
+    s.magnitude = static_cast<qint8>(std::lround(qBound(-12.8f, magnitude, 12.7f) * 10.0f));
+    s.colorIndex = static_cast<qint8>(std::lround(qBound(-2.56f, colorIndex, 2.54f) * 50.0f));
+    return s;
+}
+
+// Records are written as they are in memory, little endian like every platform we run on.
+bool StarCatalog::writeBinary(QString name, const Star *stars, int n, QString *error) {
+    uchar header[headerSize] = {};
+    qToLittleEndian<quint32>(catalogMagic, header);
+    qToLittleEndian<quint32>(catalogVersion, header + 4);
+    qToLittleEndian<qint32>(n, header + 8);
+
+    QSaveFile out(name);
+    if (!out.open(QIODevice::WriteOnly)) {
+        if (error) *error = out.errorString();
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(header), headerSize);
+    out.write(reinterpret_cast<const char*>(stars), qint64(n) * sizeof(Star));
+    if (!out.commit()) {
+        if (error) *error = out.errorString();
+        return false;
+    }
+    return true;
+}
+
+StarField::~StarField() {
+    if (starVAO == 0) return;
+    glDeleteBuffers(1, &starVBO);
+    glDeleteVertexArrays(1, &starVAO);
+}
+
+void StarField::initialize(ShaderCache *cache) {
+    initializeOpenGLFunctions();
+
+    glGenVertexArrays(1, &starVAO);
+    glGenBuffers(1, &starVBO);
+
+    glBindVertexArray(starVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, starVBO);
+    // Direction as normalized shorts at location 0, magnitude and color index at location 1.
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(StarCatalog::Star), reinterpret_cast<void*>(0));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_BYTE, GL_FALSE, sizeof(StarCatalog::Star), reinterpret_cast<void*>(6));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    cache->build(&program, ":/shaders/vertshader_stars.glsl", ":/shaders/fragshader_stars.glsl");
+    uniformSkyTransform = program.uniformLocation("skyTransform");
+    uniformPointScale = program.uniformLocation("pointScale");
+}
+
+void StarField::upload(StarCatalog &catalog) {
+    count = catalog.size();
+    glBindBuffer(GL_ARRAY_BUFFER, starVBO);
+    glBufferData(GL_ARRAY_BUFFER, qint64(count) * sizeof(StarCatalog::Star), catalog.stars(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    LOG(Log::ASSETS, Log::INFO) << "Uploaded" << count << "stars";
+}
+
+void StarField::loadDefaultCatalog() {
+    StarCatalog catalog;
+    if (defaultCatalog.isEmpty() || !catalog.open(defaultCatalog)) {
+        if (!defaultCatalog.isEmpty()) {
+            LOG(Log::ASSETS, Log::WARNING) << "Generating the sky:" << catalog.errorString();
+        }
+        catalog.generate(generatedStars, 1);
+    }
+    // The mapping is released when the catalog goes out of scope.
+    upload(catalog);
+}
+
+/**
+ * @brief StarField::draw
+ *
+ * Expects the opaque geometry in the depth buffer and GL_LEQUAL depth testing,
+ * the stars are at depth 1 like the cleared buffer.
+ */
+void StarField::draw(const QMatrix4x4 &view, const QMatrix4x4 &projection, float pointScale) {
+    if (count == 0) return;
+
+    QMatrix4x4 rotation = view;
+    rotation.setColumn(3, QVector4D(0.0f, 0.0f, 0.0f, 1.0f));
+    QMatrix4x4 skyTransform = projection * rotation;
+
+    program.bind();
+    glUniformMatrix4fv(uniformSkyTransform, 1, GL_FALSE, skyTransform.constData());
+    glUniform1f(uniformPointScale, pointScale);
+
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    glBindVertexArray(starVAO);
+    glDrawArrays(GL_POINTS, 0, count);
+    glBindVertexArray(0);
+
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+    program.release();
+}
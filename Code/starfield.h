@@ -0,0 +1,99 @@
+#ifndef STARFIELD_H
+#define STARFIELD_H
+
+#include <QFile>
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QString>
+#include <QVector>
+
+#include "shadercache.h"
+
+/**
+ * @brief The StarCatalog class
+ *
+ * Star positions and magnitudes, read from a binary catalog or from CSV.
+ *
+ * A binary catalog is a 16 byte header (magic, version, star count, reserved)
+ * followed by the Star records, little endian. It is memory mapped and the
+ * records are the vertex format of StarField, so loading is a single copy into
+ * the vertex buffer.
+ *
+ * CSV lines are "ra,dec,magnitude,b-v" in degrees, as exported from Hipparcos
+ * or Gaia; other lines, like a header, are skipped.
+ */
+class StarCatalog {
+public:
+    struct Star {
+        qint16 direction[3];    // Unit vector in world space, scaled by 32767.
+        qint8 magnitude;        // Apparent visual magnitude, in tenths.
+        qint8 colorIndex;       // B-V color index, in fiftieths.
+    };
+
+    StarCatalog() {}
+    ~StarCatalog();
+
+    bool open(QString file);
+    // Replaces the stars with count random ones, with the magnitudes of a real sky.
+    void generate(int count, quint32 seed);
+
+    const Star *stars() {return data;}
+    int size() {return count;}
+    QString errorString() {return error;}
+
+    // Converts equatorial coordinates to a star in the world, whose xz plane is the ecliptic.
+    static Star makeStar(float ra, float dec, float magnitude, float colorIndex);
+    static bool writeBinary(QString file, const Star *stars, int count, QString *error = nullptr);
+
+private:
+    QFile file;
+    QString error;
+    const Star *data = nullptr;
+    int count = 0;
+    uchar *mapped = nullptr;
+    QVector<Star> parsed;
+
+    void close();
+    bool readCsv();
+};
+
+/**
+ * @brief The StarField class
+ *
+ * Draws a StarCatalog as the sky, in one glDrawArrays(GL_POINTS) call. Stars
+ * are directions, so only the rotation of the view applies and they land on
+ * the far plane. They are drawn after the opaque geometry without writing
+ * depth, so the depth test rejects every star behind a planet before it is
+ * shaded. Point size and brightness follow the magnitude, the tint follows
+ * the color index.
+ */
+class StarField : protected QOpenGLFunctions_3_3_Core {
+public:
+    StarField() {}
+    ~StarField();
+
+    // Requires a current context.
+    void initialize(ShaderCache *cache);
+    void upload(StarCatalog &catalog);
+    // Uploads the default catalog, or a generated sky without one.
+    void loadDefaultCatalog();
+    static void setDefaultCatalog(QString file) {defaultCatalog = file;}
+
+    // pointScale is the device pixel ratio.
+    void draw(const QMatrix4x4 &view, const QMatrix4x4 &projection, float pointScale);
+
+    int getCount() {return count;}
+
+private:
+    static QString defaultCatalog;
+    int count = 0;
+
+    GLuint starVAO = 0;
+    GLuint starVBO;
+    QOpenGLShaderProgram program;
+    GLint uniformSkyTransform;
+    GLint uniformPointScale;
+};
+
+#endif // STARFIELD_H
@@ -0,0 +1,126 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) : remaining(0) {
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (int i = 0; i != threads; ++i) {
+        queues.push_back(new Queue);
+    }
+    for (int i = 1; i != threads; ++i) {
+        this->threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    for (Queue *q : queues) {
+        delete q;
+    }
+}
+
+ThreadPool *ThreadPool::instance() {
+    static ThreadPool pool;
+    return &pool;
+}
+
+void ThreadPool::parallelFor(int count, int grain, Task task) {
+    if (count <= 0) return;
+    grain = std::max(1, grain);
+
+    int chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || size() == 1) {
+        task(0, count, 0);
+        return;
+    }
+
+    // The task is published before any chunk, a worker still draining the
+    // previous loop may already pick up chunks of this one.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = task;
+        remaining = chunks;
+    }
+
+    // Deal contiguous runs of chunks to the workers, so without stealing
+    // every worker walks through neighbouring memory.
+    int workers = size();
+    for (int w = 0; w != workers; ++w) {
+        int first = chunks * w / workers, last = chunks * (w + 1) / workers;
+        std::lock_guard<std::mutex> lock(queues[w]->mutex);
+        for (int c = first; c != last; ++c) {
+            queues[w]->chunks.push_back({c * grain, std::min(count, (c + 1) * grain)});
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] {return remaining == 0;});
+    current = nullptr;
+}
+
+void ThreadPool::workerLoop(int worker) {
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] {return stopping || generation != seen;});
+            if (stopping) return;
+            seen = generation;
+        }
+        work(worker);
+    }
+}
+
+void ThreadPool::work(int worker) {
+    Chunk chunk;
+    while (pop(worker, chunk)) {
+        current(chunk.begin, chunk.end, worker);
+        if (--remaining == 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_all();
+        }
+    }
+}
+
+// Own chunks come from the front, stolen ones from the back of a victim.
+bool ThreadPool::pop(int worker, Chunk &chunk) {
+    {
+        Queue *own = queues[worker];
+        std::lock_guard<std::mutex> lock(own->mutex);
+        if (!own->chunks.empty()) {
+            chunk = own->chunks.front();
+            own->chunks.pop_front();
+            return true;
+        }
+    }
+
+    int workers = size();
+    for (int i = 1; i != workers; ++i) {
+        Queue *victim = queues[(worker + i) % workers];
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (!victim->chunks.empty()) {
+            chunk = victim->chunks.back();
+            victim->chunks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,63 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The ThreadPool class
+ *
+ * Small work-stealing pool for data parallel loops over the simulation.
+ * parallelFor splits a range into chunks that are dealt out to per-worker
+ * queues; a worker that runs out of chunks steals from the back of another
+ * queue, so uneven chunks still keep every core busy. The calling thread
+ * takes part as worker 0.
+ */
+class ThreadPool {
+public:
+    // Range [begin, end) processed by the worker with the given index.
+    typedef std::function<void(int begin, int end, int worker)> Task;
+
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    // Number of workers, including the calling thread.
+    int size() {return static_cast<int>(queues.size());}
+
+    // Runs task over [0, count) in chunks of at most grain items, returns when all are done.
+    // Not reentrant: task must not call parallelFor on the same pool.
+    void parallelFor(int count, int grain, Task task);
+
+    static ThreadPool *instance();
+
+private:
+    struct Chunk {
+        int begin, end;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<Queue*> queues;
+
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    unsigned generation = 0;
+    bool stopping = false;
+
+    Task current;
+    std::atomic<int> remaining;
+
+    void workerLoop(int worker);
+    void work(int worker);
+    bool pop(int worker, Chunk &chunk);
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,92 @@
+#include "transformhierarchy.h"
+#include "memoryreport.h"
+
+#include <QtMath>
+#include <cmath>
+
+void TransformHierarchy::clear() {
+    parent.clear();
+    translation.clear();
+    scale.clear();
+    angle.clear();
+    dirty.clear();
+    position.clear();
+    moved.clear();
+    stale.clear();
+    world.clear();
+    normal.clear();
+}
+
+int TransformHierarchy::addNode(int p) {
+    Q_ASSERT(p < size());
+    parent.push_back(p);
+    translation.push_back(QVector3D());
+    scale.push_back(1.0f);
+    angle.push_back(0.0f);
+    dirty.push_back(true);
+    position.push_back(QVector3D());
+    moved.push_back(false);
+    stale.push_back(true);
+    world.push_back(QMatrix4x4());
+    normal.push_back(QMatrix3x3());
+    return size() - 1;
+}
+
+void TransformHierarchy::setLocal(int node, QVector3D t, float s, float a) {
+    if (translation[node] == t && scale[node] == s && angle[node] == a) return;
+    translation[node] = t;
+    scale[node] = s;
+    angle[node] = a;
+    dirty[node] = true;
+}
+
+int TransformHierarchy::update() {
+    int updated = 0;
+    for (int n = 0; n != size(); ++n) {
+        int p = parent[n];
+        bool parentMoved = p >= 0 && moved[p];
+        moved[n] = false;
+        if (!dirty[n] && !parentMoved) continue;
+
+        QVector3D worldPosition = translation[n] + (p >= 0 ? position[p] : QVector3D());
+        moved[n] = worldPosition != position[n];
+        position[n] = worldPosition;
+        stale[n] = true;
+        dirty[n] = false;
+        updated++;
+    }
+    return updated;
+}
+
+/**
+ * @brief TransformHierarchy::build
+ *
+ * The model matrix is translate * scale * rotate(angle, y), written out
+ * directly. Its normal matrix, the inverse transpose, is the rotation divided
+ * by the scale.
+ */
+void TransformHierarchy::build(int n) {
+    QVector3D worldPosition = position[n];
+    float radians = qDegreesToRadians(angle[n]);
+    float c = std::cos(radians), s = std::sin(radians), k = scale[n];
+    world[n] = QMatrix4x4(c * k, 0.0f, s * k, worldPosition.x(),
+                          0.0f,  k,    0.0f,  worldPosition.y(),
+                          -s * k, 0.0f, c * k, worldPosition.z(),
+                          0.0f,  0.0f, 0.0f,  1.0f);
+
+    // A zero scale (the eye viewpoints) has no inverse, keep the identity then.
+    float inverse = k != 0.0f ? 1.0f / k : 1.0f;
+    float *m = normal[n].data();
+    // QGenericMatrix data is column major.
+    m[0] = c * inverse;  m[3] = 0.0f;     m[6] = s * inverse;
+    m[1] = 0.0f;         m[4] = inverse;  m[7] = 0.0f;
+    m[2] = -s * inverse; m[5] = 0.0f;     m[8] = c * inverse;
+
+    stale[n] = false;
+}
+
+qint64 TransformHierarchy::getMemoryUsage() {
+    return MemoryReport::bytes(parent) + MemoryReport::bytes(translation) + MemoryReport::bytes(scale) +
+           MemoryReport::bytes(angle) + MemoryReport::bytes(dirty) + MemoryReport::bytes(position) +
+           MemoryReport::bytes(moved) + MemoryReport::bytes(stale) + MemoryReport::bytes(world) + MemoryReport::bytes(normal);
+}
@@ -0,0 +1,61 @@
+#ifndef TRANSFORMHIERARCHY_H
+#define TRANSFORMHIERARCHY_H
+
+#include <QGenericMatrix>
+#include <QMatrix4x4>
+#include <QVector>
+#include <QVector3D>
+
+/**
+ * @brief The TransformHierarchy class
+ *
+ * Model and normal matrices of a tree of nodes, kept in flat arrays in
+ * topological order: a node can only be added after its parent, so one pass
+ * front to back sees every parent before its children.
+ *
+ * A node is placed relative to the position of its parent and has its own
+ * scale and spin around the y axis, which children do not inherit (the Moon
+ * follows the Earth, not its size or rotation). Positions are only updated for
+ * nodes whose local values changed and for the children of nodes that moved,
+ * and their matrices are only built when asked for, so nodes that are not
+ * drawn, or placed by the shader as with OrbitBuffer, never build them.
+ */
+class TransformHierarchy {
+public:
+    TransformHierarchy() {}
+
+    void clear();
+    // Parent is -1 for a root, otherwise an existing node.
+    int addNode(int parent);
+    int size() {return parent.size();}
+    int getParent(int node) {return parent[node];}
+
+    // Marks the node dirty when any value differs from the last call.
+    void setLocal(int node, QVector3D translation, float scale, float angle);
+
+    // Updates the positions of the dirty nodes, returns how many changed.
+    int update();
+
+    const QMatrix4x4 &getWorld(int node) {if (stale[node]) build(node); return world[node];}
+    const QMatrix3x3 &getNormal(int node) {if (stale[node]) build(node); return normal[node];}
+    QVector3D getWorldPosition(int node) {return position[node];}
+
+    qint64 getMemoryUsage();
+
+private:
+    QVector<int> parent;
+    QVector<QVector3D> translation;
+    QVector<float> scale, angle;
+    QVector<bool> dirty;
+
+    QVector<QVector3D> position;
+    QVector<bool> moved;
+    // Whether the matrices are older than the position.
+    QVector<bool> stale;
+    QVector<QMatrix4x4> world;
+    QVector<QMatrix3x3> normal;
+
+    void build(int node);
+};
+
+#endif // TRANSFORMHIERARCHY_H
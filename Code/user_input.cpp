@@ -1,70 +1,180 @@
 #include "mainview.h"
 
-#include <QDebug>
+#include "log.h"
+
+// Simulation time skipped by [ and ].
+static const double seekStep = 1000.0;
 
 // Triggered by pressing a key
 void MainView::keyPressEvent(QKeyEvent *ev) {
-    switch(ev->key()) {
+    // A replay only plays the recorded keys.
+    if (!replay.isPlaying()) {
+        replay.add(ReplayEvent::KEY, static_cast<qint32>(ev->key()));
+        // Keys can start or stop a capture, which needs the context.
+        makeCurrent();
+        handleKey(ev->key());
+        doneCurrent();
+    }
+
+    // Used to update the screen after changes
+    update();
+}
+
+// Keys pressed now or in a replay, the context is current.
+void MainView::handleKey(int key) {
+    switch(key) {
+    case 'G':
+        // Toggle between analytic orbits and simulated gravity.
+        solarSystem.setSimulationMode(solarSystem.getSimulationMode() == SolarSystem::GRAVITY ?
+                                          SolarSystem::ANALYTIC : SolarSystem::GRAVITY);
+        break;
+    case 'K':
+        // Toggle placing the planets in the vertex shader, for analytic orbits.
+        orbits.setEnabled(!orbits.isEnabled());
+        LOG(Log::RENDER, Log::INFO) << "Orbits on the" << (orbits.isEnabled() ? "GPU" : "CPU");
+        break;
+    case 'F':
+        // Cycle through continuous, capped and on-demand frame scheduling.
+        scheduler.setMode(static_cast<FrameScheduler::Mode>((scheduler.getMode() + 1) % 3));
+        break;
+    case 'O': {
+        bool enabled = !views[0].getOcclusionCuller().isEnabled();
+        for (RenderView &view : views) {
+            view.getOcclusionCuller().setEnabled(enabled);
+        }
+        LOG(Log::RENDER, Log::INFO) << "Occlusion culling" << (enabled ? "on" : "off");
+        break;
+    }
+    case 'R':
+        // Toggle between automatic and full resolution.
+        if (resolution.isAutomatic()) {
+            resolution.setScale(1.0f);
+        } else {
+            resolution.setAutomatic(true);
+        }
+        break;
+    case Qt::Key_Plus:
+    case Qt::Key_Minus:
+        // Fix the resolution a step higher or lower.
+        resolution.setScale(resolution.getScale() + (key == Qt::Key_Plus ? 0.125f : -0.125f));
+        break;
+    case Qt::Key_BracketLeft:
+    case Qt::Key_BracketRight:
+        // Jump through time, the orbits need no steps in between.
+        setTime(time + (key == Qt::Key_BracketRight ? seekStep : -seekStep));
+        break;
+    case 'V':
+        // Cycle through one view, picture in picture and four views.
+        setLayout(static_cast<Layout>((layout + 1) % 3));
+        break;
+    case 'C':
+        // Start or stop recording, stopping reads back the frames in flight.
+        if (capture.isActive()) {
+            capture.stop();
+        } else if (!capture.startDefault()) {
+            capture.start("capture", FrameCapture::PNG, 60.0);
+        }
+        break;
 
     default:
-        // ev->key() is an integer. For alpha numeric characters keys it equivalent with the char value ('A' == 65, '1' == 49)
+        // key is an integer. For alpha numeric characters keys it equivalent with the char value ('A' == 65, '1' == 49)
         // Alternatively, you could use Qt Key enums, see http://doc.qt.io/qt-5/qt.html#Key-enum
-        qDebug() << ev->key() << "pressed";
+        LOG(Log::INPUT, Log::DEBUG) << key << "pressed";
         break;
     }
-
-    // Used to update the screen after changes
-    updateViewTransform();
-    update();
 }
 
 // Triggered by releasing a key
 void MainView::keyReleaseEvent(QKeyEvent *ev) {
     switch(ev->key()) {
-    case 'A': qDebug() << "A released"; break;
+    case 'A': LOG(Log::INPUT, Log::DEBUG) << "A released"; break;
     default:
-        qDebug() << ev->key() << "released";
+        LOG(Log::INPUT, Log::DEBUG) << ev->key() << "released";
         break;
     }
 
-    updateViewTransform();
     update();
 }
 
 // Triggered by clicking two subsequent times on any mouse button
 // It also fires two mousePress and mouseRelease events!
 void MainView::mouseDoubleClickEvent(QMouseEvent *ev) {
-    qDebug() << "Mouse double clicked:" << ev->button();
+    LOG(Log::INPUT, Log::DEBUG) << "Mouse double clicked:" << ev->button();
+
+    // The first click selected, the active view looks at the selection if it can.
+    if (ev->button() == Qt::LeftButton && selected >= 0 && !replay.isPlaying()) {
+        int index = comboBox_lookingAt->findData(selected);
+        if (index >= 0) {
+            comboBox_lookingAt->setCurrentIndex(index);
+        } else {
+            LOG(Log::INPUT, Log::INFO) << solarSystem.objects[selected]->getName() << "is not a viewpoint";
+        }
+    }
 
     update();
 }
 
 // Triggered when moving the mouse inside the window (only when the mouse is clicked!)
 void MainView::mouseMoveEvent(QMouseEvent *ev) {
-    qDebug() << "x" << ev->x() << "y" << ev->y();
+    LOG(Log::INPUT, Log::DEBUG) << "x" << ev->x() << "y" << ev->y();
 
     update();
 }
 
 // Triggered when pressing any mouse button
 void MainView::mousePressEvent(QMouseEvent *ev) {
-    qDebug() << "Mouse button pressed:" << ev->button();
+    LOG(Log::INPUT, Log::DEBUG) << "Mouse button pressed:" << ev->button();
+
+    // The topmost view under the cursor becomes the one the controls change.
+    QPointF p(ev->x() / qreal(width()), 1.0 - ev->y() / qreal(height()));
+    for (int v = getViewCount() - 1; v >= 0; --v) {
+        if (views[v].getArea().contains(p)) {
+            if (v != activeView && !replay.isPlaying()) {
+                replay.add(ReplayEvent::ACTIVE_VIEW, v);
+                setActiveView(v);
+            }
+            if (ev->button() == Qt::LeftButton) selectObjectAt(v, p);
+            break;
+        }
+    }
 
     update();
     // Do not remove the line below, clicking must focus on this widget!
     this->setFocus();
 }
 
+/**
+ * @brief MainView::selectObjectAt
+ *
+ * Casts a ray through p with the transforms the view was last drawn with, so
+ * the selection is what was on screen.
+ */
+void MainView::selectObjectAt(int view, QPointF p) {
+    QRectF area = views[view].getArea();
+    QPointF ndc(2.0 * (p.x() - area.x()) / area.width() - 1.0, 2.0 * (p.y() - area.y()) / area.height() - 1.0);
+    QVector3D origin, direction;
+    Picker::viewRay(views[view].getProjectionTransform(), views[view].getViewTransform(), ndc, origin, direction);
+
+    Picker::Hit hit = picker.pick(&solarSystem, origin, direction);
+    selected = hit.object;
+    if (hit.object < 0) {
+        LOG(Log::INPUT, Log::DEBUG) << "Nothing picked in" << picker.getQueryTime() << "ms";
+        return;
+    }
+    LOG(Log::INPUT, Log::INFO) << "Picked" << solarSystem.objects[hit.object]->getName() << "at distance"
+                               << hit.distance << "in" << picker.getQueryTime() << "ms";
+}
+
 // Triggered when releasing any mouse button
 void MainView::mouseReleaseEvent(QMouseEvent *ev) {
-    qDebug() << "Mouse button released" << ev->button();
+    LOG(Log::INPUT, Log::DEBUG) << "Mouse button released" << ev->button();
 
     update();
 }
 
 // Triggered when clicking scrolling with the scroll wheel on the mouse
 void MainView::wheelEvent(QWheelEvent *ev) {
-    qDebug() << "Mouse wheel:" << ev->delta();
+    LOG(Log::INPUT, Log::DEBUG) << "Mouse wheel:" << ev->delta();
 
     update();
 }
@@ -0,0 +1,208 @@
+#include "virtualtexture.h"
+
+#include <QBuffer>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QtEndian>
+
+static const quint32 textureMagic = 0x58455456;  // "VTEX"
+static const quint32 textureVersion = 1;
+static const int headerSize = 32;
+static const int entrySize = 12;
+
+// Texels copied from the neighbours around each page, enough for bilinear
+// filtering at the page's own level.
+static const int pageBorder = 4;
+static const int jpegQuality = 90;
+// Source rows decoded at once while building.
+static const qint64 stripBytes = 256 << 20;
+static const int maxLevels = 16;
+
+static int nextPowerOfTwo(int n) {
+    int p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+qint64 VirtualTextureFile::getStoredBytes() {
+    qint64 total = 0;
+    for (quint32 s : sizes) {
+        total += s;
+    }
+    return total;
+}
+
+bool VirtualTextureFile::open(QString fileName) {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.close();
+    file.setFileName(fileName);
+    name = fileName;
+    offsets.clear();
+    sizes.clear();
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("Cannot open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    uchar header[headerSize];
+    if (file.read(reinterpret_cast<char*>(header), headerSize) != headerSize ||
+            qFromLittleEndian<quint32>(header) != textureMagic ||
+            qFromLittleEndian<quint32>(header + 4) != textureVersion) {
+        error = QString("%1 is not a version %2 virtual texture").arg(fileName).arg(textureVersion);
+        return false;
+    }
+    pagesX = qFromLittleEndian<qint32>(header + 8);
+    pagesY = qFromLittleEndian<qint32>(header + 12);
+    pageSize = qFromLittleEndian<qint32>(header + 16);
+    border = qFromLittleEndian<qint32>(header + 20);
+    levels = qFromLittleEndian<qint32>(header + 24);
+    if (pagesX <= 0 || pagesY <= 0 || pageSize <= 0 || border < 0 || border >= pageSize ||
+            (pagesX & (pagesX - 1)) || (pagesY & (pagesY - 1)) || levels <= 0 || levels > maxLevels ||
+            (pagesX >> (levels - 1)) == 0 || (pagesY >> (levels - 1)) == 0) {
+        error = QString("%1 has an invalid page layout").arg(fileName);
+        return false;
+    }
+
+    levelStart.clear();
+    int count = 0;
+    for (int level = 0; level != levels; ++level) {
+        levelStart.push_back(count);
+        count += getPagesX(level) * getPagesY(level);
+    }
+    QByteArray table = file.read(qint64(count) * entrySize);
+    if (table.size() != count * entrySize) {
+        error = QString("%1 is truncated").arg(fileName);
+        return false;
+    }
+    const uchar *t = reinterpret_cast<const uchar*>(table.constData());
+    offsets.resize(count);
+    sizes.resize(count);
+    for (int i = 0; i != count; ++i) {
+        offsets[i] = qFromLittleEndian<quint64>(t + i * entrySize);
+        sizes[i] = qFromLittleEndian<quint32>(t + i * entrySize + 8);
+        if (offsets[i] + sizes[i] > quint64(file.size())) {
+            error = QString("%1 is truncated").arg(fileName);
+            offsets.clear();
+            sizes.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool VirtualTextureFile::readPage(int level, int x, int y, QImage &page) {
+    int index = pageIndex(level, x, y);
+    QByteArray bytes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index < 0 || index >= offsets.size() || !file.seek(static_cast<qint64>(offsets[index]))) return false;
+        bytes = file.read(sizes[index]);
+    }
+    // Decoding takes far longer than reading, it runs outside the lock.
+    page = QImage::fromData(bytes, "JPG").convertToFormat(QImage::Format_RGBA8888);
+    return page.width() == getSlotSize() && page.height() == getSlotSize();
+}
+
+/**
+ * @brief VirtualTextureFile::build
+ *
+ * Every level is decoded from the source scaled to its size, in strips of
+ * page rows with their borders, and cut into pages. Columns wrap around like
+ * the longitude of a planet map, rows are clamped at the poles. The page
+ * table is written last, over the space left for it after the header.
+ */
+bool VirtualTextureFile::build(QString image, QString name, int size, QString *error) {
+    QImageReader probe(image);
+    QSize source = probe.size();
+    if (!source.isValid()) {
+        if (error) *error = QString("Cannot read %1: %2").arg(image, probe.errorString());
+        return false;
+    }
+    if (size < 16 || (size & (size - 1))) {
+        if (error) *error = QString("Page size %1 is not a power of two of at least 16").arg(size);
+        return false;
+    }
+
+    int pagesX = nextPowerOfTwo((source.width() + size - 1) / size);
+    int pagesY = nextPowerOfTwo((source.height() + size - 1) / size);
+    int levels = 1;
+    while (levels < maxLevels && (pagesX >> levels) > 0 && (pagesY >> levels) > 0) levels++;
+    int slot = size + 2 * pageBorder;
+
+    int count = 0;
+    for (int level = 0; level != levels; ++level) {
+        count += std::max(1, pagesX >> level) * std::max(1, pagesY >> level);
+    }
+
+    QSaveFile out(name);
+    if (!out.open(QIODevice::WriteOnly)) {
+        if (error) *error = out.errorString();
+        return false;
+    }
+    uchar header[headerSize] = {};
+    qToLittleEndian<quint32>(textureMagic, header);
+    qToLittleEndian<quint32>(textureVersion, header + 4);
+    qToLittleEndian<qint32>(pagesX, header + 8);
+    qToLittleEndian<qint32>(pagesY, header + 12);
+    qToLittleEndian<qint32>(size, header + 16);
+    qToLittleEndian<qint32>(pageBorder, header + 20);
+    qToLittleEndian<qint32>(levels, header + 24);
+    out.write(reinterpret_cast<const char*>(header), headerSize);
+    QByteArray table(count * entrySize, '\0');
+    out.write(table);
+
+    uchar *t = reinterpret_cast<uchar*>(table.data());
+    int index = 0;
+    for (int level = 0; level != levels; ++level) {
+        int across = std::max(1, pagesX >> level), down = std::max(1, pagesY >> level);
+        QSize levelSize(across * size, down * size);
+        int rowsPerStrip = std::max(1, static_cast<int>(stripBytes / (qint64(levelSize.width()) * 4 * size)));
+
+        for (int row = 0; row < down; row += rowsPerStrip) {
+            int rows = std::min(rowsPerStrip, down - row);
+            QRect clip = QRect(0, row * size - pageBorder, levelSize.width(), rows * size + 2 * pageBorder) &
+                         QRect(QPoint(0, 0), levelSize);
+            QImageReader reader(image);
+            reader.setScaledSize(levelSize);
+            reader.setScaledClipRect(clip);
+            QImage strip = reader.read().convertToFormat(QImage::Format_RGBA8888);
+            if (strip.size() != clip.size()) {
+                if (error) *error = QString("Cannot read %1: %2").arg(image, reader.errorString());
+                out.cancelWriting();
+                return false;
+            }
+
+            for (int y = row; y != row + rows; ++y) {
+                for (int x = 0; x != across; ++x) {
+                    QImage page(slot, slot, QImage::Format_RGBA8888);
+                    for (int j = 0; j != slot; ++j) {
+                        int sy = qBound(0, y * size - pageBorder + j, levelSize.height() - 1) - clip.top();
+                        const quint32 *from = reinterpret_cast<const quint32*>(strip.constScanLine(sy));
+                        quint32 *to = reinterpret_cast<quint32*>(page.scanLine(j));
+                        for (int i = 0; i != slot; ++i) {
+                            int sx = x * size - pageBorder + i;
+                            to[i] = from[(sx + levelSize.width()) % levelSize.width()];
+                        }
+                    }
+
+                    QByteArray bytes;
+                    QBuffer buffer(&bytes);
+                    buffer.open(QIODevice::WriteOnly);
+                    page.save(&buffer, "JPG", jpegQuality);
+                    qToLittleEndian<quint64>(static_cast<quint64>(out.pos()), t + index * entrySize);
+                    qToLittleEndian<quint32>(static_cast<quint32>(bytes.size()), t + index * entrySize + 8);
+                    out.write(bytes);
+                    index++;
+                }
+            }
+        }
+    }
+
+    out.seek(headerSize);
+    out.write(table);
+    if (!out.commit()) {
+        if (error) *error = out.errorString();
+        return false;
+    }
+    return true;
+}
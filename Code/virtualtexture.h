@@ -0,0 +1,70 @@
+#ifndef VIRTUALTEXTURE_H
+#define VIRTUALTEXTURE_H
+
+#include <QFile>
+#include <QImage>
+#include <QString>
+#include <QVector>
+
+#include <algorithm>
+#include <mutex>
+
+/**
+ * @brief The VirtualTextureFile class
+ *
+ * A texture too large to upload, split into square pages at every mip level.
+ * Level 0 has pagesX by pagesY pages of pageSize texels, both powers of two;
+ * every level halves them, down to the level where one of them is a single
+ * page. Each page carries a border of its neighbours' texels, so it can be
+ * filtered on its own wherever it is placed.
+ *
+ * The file is a 32 byte header (magic "VTEX", version, pages across and down
+ * at level 0, page size, border, levels, reserved) and a table of 12 byte
+ * entries (offset, size), level by level and row by row, followed by the
+ * pages as JPEG. Values are little endian.
+ *
+ * readPage may be called from any thread.
+ */
+class VirtualTextureFile {
+public:
+    VirtualTextureFile() {}
+
+    bool open(QString file);
+    QString errorString() {return error;}
+    QString getName() {return name;}
+
+    int getPagesX(int level = 0) {return std::max(1, pagesX >> level);}
+    int getPagesY(int level = 0) {return std::max(1, pagesY >> level);}
+    int getLevels() {return levels;}
+    int getPageSize() {return pageSize;}
+    int getBorder() {return border;}
+    // Page and border on both sides.
+    int getSlotSize() {return pageSize + 2 * border;}
+    int getPageCount() {return offsets.size();}
+    int pageIndex(int level, int x, int y) {return levelStart[level] + y * getPagesX(level) + x;}
+    // Bytes of all pages as stored, compressed.
+    qint64 getStoredBytes();
+
+    // Decodes a page into a getSlotSize() square RGBA8888 image.
+    bool readPage(int level, int x, int y, QImage &page);
+
+    // Splits an image of any size into a page file. The image is resampled to
+    // a power of two number of pages and read in strips, so it never has to
+    // fit in memory at once.
+    static bool build(QString image, QString file, int pageSize = 128, QString *error = nullptr);
+
+private:
+    QString name;
+    QString error;
+    int pagesX = 0, pagesY = 0;
+    int pageSize = 0, border = 0;
+    int levels = 0;
+    QVector<int> levelStart;
+    QVector<quint64> offsets;
+    QVector<quint32> sizes;
+
+    std::mutex mutex;
+    QFile file;
+};
+
+#endif // VIRTUALTEXTURE_H
@@ -0,0 +1,505 @@
+#include "virtualtexturecache.h"
+
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+
+int VirtualTextureCache::defaultCacheSize = 64;
+
+VirtualTextureCache::~VirtualTextureCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_all();
+    if (loader.joinable()) loader.join();
+    if (!initialized) return;
+    for (Readback &readback : readbacks) {
+        if (readback.fence) glDeleteSync(readback.fence);
+        glDeleteBuffers(1, &readback.buffer);
+    }
+    for (std::unique_ptr<Texture> &texture : textures) {
+        glDeleteTextures(1, &texture->indirection);
+    }
+    if (cacheTexture) glDeleteTextures(1, &cacheTexture);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &feedbackTexture);
+    glDeleteRenderbuffers(1, &depthBuffer);
+}
+
+void VirtualTextureCache::initialize(ShaderCache *cache) {
+    initializeOpenGLFunctions();
+
+    // The Phong vertex shader gives the feedback the same texture coordinates.
+    cache->build(&program, ":/shaders/vertshader_phong.glsl", ":/shaders/fragshader_feedback.glsl");
+    uniformModelTransform      = program.uniformLocation("modelTransform");
+    uniformViewTransform       = program.uniformLocation("viewTransform");
+    uniformProjectionTransform = program.uniformLocation("projectionTransform");
+    uniformVirtualPages        = program.uniformLocation("virtualPages");
+    uniformTextureId           = program.uniformLocation("textureId");
+    uniformPageTexels          = program.uniformLocation("pageTexels");
+    uniformLodBias             = program.uniformLocation("lodBias");
+
+    glGenFramebuffers(1, &framebuffer);
+    glGenTextures(1, &feedbackTexture);
+    glGenRenderbuffers(1, &depthBuffer);
+    for (Readback &readback : readbacks) {
+        glGenBuffers(1, &readback.buffer);
+    }
+    loader = std::thread(&VirtualTextureCache::loaderLoop, this);
+    initialized = true;
+}
+
+/**
+ * @brief VirtualTextureCache::createCache
+ *
+ * As many slots as fit in the configured size, in a square texture.
+ */
+bool VirtualTextureCache::createCache(int slot) {
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    qint64 bytes = qint64(defaultCacheSize) << 20;
+    slotSize = slot;
+    slotsPerSide = static_cast<int>(std::sqrt(static_cast<double>(bytes / (qint64(slot) * slot * 4))));
+    slotsPerSide = std::min(std::min(slotsPerSide, maxSlotsPerSide), maxSize / slot);
+    if (slotsPerSide < 2) {
+        LOG(Log::RENDER, Log::WARNING) << "Virtual texture cache of" << defaultCacheSize << "MB holds too few pages";
+        slotsPerSide = 0;
+        return false;
+    }
+    slots.fill(Slot(), slotsPerSide * slotsPerSide);
+
+    int size = slotsPerSide * slotSize;
+    glGenTextures(1, &cacheTexture);
+    glBindTexture(GL_TEXTURE_2D, cacheTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    // The borders of the pages make linear filtering safe inside a slot.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    LOG(Log::RENDER, Log::INFO) << "Virtual texture cache of" << slots.size() << "pages," << size << "x" << size;
+    return true;
+}
+
+/**
+ * @brief VirtualTextureCache::open
+ *
+ * All textures share the cache, so they need the page and border size of the
+ * first one. The coarsest level is read here and pinned.
+ */
+int VirtualTextureCache::open(QString name) {
+    std::unique_ptr<Texture> texture(new Texture);
+    VirtualTextureFile &file = texture->file;
+    if (!file.open(name)) {
+        LOG(Log::ASSETS, Log::WARNING) << file.errorString();
+        return -1;
+    }
+    if (cacheTexture == 0) {
+        pageSize = file.getPageSize();
+        border = file.getBorder();
+        if (!createCache(file.getSlotSize())) return -1;
+    } else if (file.getPageSize() != pageSize || file.getBorder() != border) {
+        LOG(Log::ASSETS, Log::WARNING) << name << "has pages of" << file.getPageSize() << "texels, the cache holds"
+                                       << pageSize;
+        return -1;
+    }
+
+    int coarsest = file.getLevels() - 1;
+    int pinned = file.getPagesX(coarsest) * file.getPagesY(coarsest);
+    int unpinned = static_cast<int>(std::count_if(slots.begin(), slots.end(), [](const Slot &s) {return !s.pinned;}));
+    // Leave room to stream at least as many pages as are pinned.
+    if (2 * pinned > unpinned) {
+        LOG(Log::ASSETS, Log::WARNING) << "No room in the virtual texture cache for" << name;
+        return -1;
+    }
+
+    texture->slotOf.fill(NOT_RESIDENT, file.getPageCount());
+    texture->entries.fill(0, 4 * file.getPageCount());
+    glGenTextures(1, &texture->indirection);
+    glBindTexture(GL_TEXTURE_2D, texture->indirection);
+    for (int level = 0; level != file.getLevels(); ++level) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, file.getPagesX(level), file.getPagesY(level),
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, coarsest);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    int id = static_cast<int>(textures.size());
+    textures.push_back(std::move(texture));
+    for (int y = 0; y != file.getPagesY(coarsest); ++y) {
+        for (int x = 0; x != file.getPagesX(coarsest); ++x) {
+            Request request = {&file, id, coarsest, x, y, QImage()};
+            if (!file.readPage(coarsest, x, y, request.image)) request.image = QImage();
+            upload(request);
+            int slot = textures[id]->slotOf[file.pageIndex(coarsest, x, y)];
+            if (slot >= 0) slots[slot].pinned = true;
+        }
+    }
+    rebuildIndirection(id);
+    invalidateFeedback();
+
+    LOG(Log::ASSETS, Log::INFO) << "Virtual texture" << name << ":" << file.getPagesX() * pageSize << "x"
+                                << file.getPagesY() * pageSize << "in" << file.getPageCount() << "pages,"
+                                << file.getStoredBytes() / 1048576.0 << "MB stored";
+    return id;
+}
+
+QVector3D VirtualTextureCache::getPages(int texture) {
+    VirtualTextureFile &file = textures[texture]->file;
+    return QVector3D(file.getPagesX(), file.getPagesY(), file.getLevels());
+}
+
+QVector4D VirtualTextureCache::getSlotLayout() {
+    float size = static_cast<float>(std::max(1, slotsPerSide * slotSize));
+    return QVector4D(slotSize / size, border / size, pageSize / size, pageSize);
+}
+
+/**
+ * @brief VirtualTextureCache::update
+ *
+ * Never waits: feedback whose copy has not finished is read on a later frame,
+ * pages still being decoded are uploaded when they are done.
+ */
+void VirtualTextureCache::update() {
+    if (textures.empty()) return;
+
+    // Readbacks finish in the order they were issued.
+    while (pending > 0) {
+        Readback &readback = readbacks[(next - pending + ringSize) % ringSize];
+        GLenum status = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+        readFeedback(readback);
+        pending--;
+    }
+
+    std::vector<Request> loaded;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!results.empty() && static_cast<int>(loaded.size()) < maxUploads) {
+            loaded.push_back(std::move(results.front()));
+            results.pop_front();
+        }
+    }
+    statistics.uploaded = 0;
+    for (const Request &request : loaded) {
+        outstanding--;
+        if (upload(request)) statistics.uploaded++;
+    }
+
+    for (int t = 0; t != static_cast<int>(textures.size()); ++t) {
+        if (textures[t]->dirty) rebuildIndirection(t);
+    }
+    statistics.resident = static_cast<int>(std::count_if(slots.begin(), slots.end(), [](const Slot &s) {
+        return s.texture >= 0;
+    }));
+    statistics.queued = outstanding;
+}
+
+// --- Feedback
+
+void VirtualTextureCache::resizeFeedback(int w, int h) {
+    feedbackWidth = w;
+    feedbackHeight = h;
+
+    glBindTexture(GL_TEXTURE_2D, feedbackTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16UI, w, h, 0, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG(Log::GL, Log::WARNING) << ":: Feedback framebuffer incomplete";
+    }
+}
+
+// Pages without room may fit once other pages are no longer in view.
+void VirtualTextureCache::invalidateFeedback() {
+    feedbackStale = true;
+    if (noRoom == 0) return;
+    for (std::unique_ptr<Texture> &texture : textures) {
+        std::replace(texture->slotOf.begin(), texture->slotOf.end(), int(NO_ROOM), int(NOT_RESIDENT));
+    }
+    noRoom = 0;
+}
+
+// Truncated feedback is drawn again once the loader has caught up.
+bool VirtualTextureCache::needsFeedback() {
+    return !textures.empty() && (feedbackStale || (truncated && outstanding == 0));
+}
+
+bool VirtualTextureCache::beginFeedback(int w, int h) {
+    if (!needsFeedback() || pending == ringSize) return false;
+    w = std::max(1, w);
+    h = std::max(1, h);
+    if (w != feedbackWidth || h != feedbackHeight) resizeFeedback(w, h);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, w, h);
+    // Texture id 0 marks pixels without a virtual texture.
+    static const GLuint empty[4] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, empty);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    program.bind();
+    glUniform1f(uniformPageTexels, static_cast<float>(pageSize));
+    // Pixels are feedbackDivisor times larger than on screen.
+    glUniform1f(uniformLodBias, std::log2(static_cast<float>(feedbackDivisor)));
+    return true;
+}
+
+void VirtualTextureCache::setFeedbackView(QRect viewport, const QMatrix4x4 &view, const QMatrix4x4 &projection) {
+    glViewport(viewport.x(), viewport.y(), viewport.width(), viewport.height());
+    glUniformMatrix4fv(uniformViewTransform, 1, GL_FALSE, view.constData());
+    glUniformMatrix4fv(uniformProjectionTransform, 1, GL_FALSE, projection.constData());
+}
+
+void VirtualTextureCache::drawFeedback(int texture, const QMatrix4x4 &model, Object *object) {
+    VirtualTextureFile &file = textures[texture]->file;
+    glUniformMatrix4fv(uniformModelTransform, 1, GL_FALSE, model.constData());
+    glUniform3f(uniformVirtualPages, file.getPagesX(), file.getPagesY(), file.getLevels());
+    glUniform1ui(uniformTextureId, static_cast<GLuint>(texture + 1));
+    object->draw();
+}
+
+void VirtualTextureCache::endFeedback(GLuint fbo) {
+    program.release();
+
+    Readback &readback = readbacks[next];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    if (readback.width != feedbackWidth || readback.height != feedbackHeight) {
+        readback.width = feedbackWidth;
+        readback.height = feedbackHeight;
+        glBufferData(GL_PIXEL_PACK_BUFFER, qint64(feedbackWidth) * feedbackHeight * 8, nullptr, GL_STREAM_READ);
+    }
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next = (next + 1) % ringSize;
+    pending++;
+    feedbackStale = false;
+    truncated = false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+/**
+ * @brief VirtualTextureCache::readFeedback
+ *
+ * A pixel holds page x, page y, level and texture id + 1. Neighbouring pixels
+ * mostly want the same page, so repeats are skipped before the lookup. The
+ * missing pages are queued coarse levels first, as far as the loader has
+ * room; the rest are requested by the feedback drawn after the loader is done.
+ */
+void VirtualTextureCache::readFeedback(Readback &readback) {
+    frame++;
+    std::vector<Request> missing;
+
+    qint64 count = qint64(readback.width) * readback.height;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const quint16 *data = static_cast<const quint16*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * 8,
+                                                                        GL_MAP_READ_BIT));
+    if (data) {
+        quint64 last = 0;
+        for (qint64 i = 0; i != count; ++i) {
+            const quint16 *p = data + 4 * i;
+            quint64 key = quint64(p[0]) | quint64(p[1]) << 16 | quint64(p[2]) << 32 | quint64(p[3]) << 48;
+            if (p[3] == 0 || key == last) continue;
+            last = key;
+            if (p[3] <= static_cast<int>(textures.size())) want(p[3] - 1, p[2], p[0], p[1], missing);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+
+    std::sort(missing.begin(), missing.end(), [](const Request &a, const Request &b) {
+        if (a.level != b.level) return a.level > b.level;
+        if (a.texture != b.texture) return a.texture < b.texture;
+        return a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
+    missing.erase(std::unique(missing.begin(), missing.end(), [](const Request &a, const Request &b) {
+        return a.level == b.level && a.texture == b.texture && a.y == b.y && a.x == b.x;
+    }), missing.end());
+    statistics.missing = static_cast<int>(missing.size());
+
+    int queuedNow = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Request &request : missing) {
+            if (outstanding == maxRequests) break;
+            Texture &texture = *textures[request.texture];
+            texture.slotOf[texture.file.pageIndex(request.level, request.x, request.y)] = REQUESTED;
+            requests.push_back(std::move(request));
+            outstanding++;
+            queuedNow++;
+        }
+    }
+    truncated = queuedNow < static_cast<int>(missing.size());
+    if (queuedNow > 0) queued.notify_one();
+}
+
+// Marks the page and the coarser pages that stand in for it as used, and
+// collects the ones that are not resident.
+void VirtualTextureCache::want(int t, int level, int x, int y, std::vector<Request> &missing) {
+    VirtualTextureFile &file = textures[t]->file;
+    QVector<int> &slotOf = textures[t]->slotOf;
+    for (; level < file.getLevels(); ++level, x /= 2, y /= 2) {
+        if (x >= file.getPagesX(level) || y >= file.getPagesY(level)) return;
+        int slot = slotOf[file.pageIndex(level, x, y)];
+        if (slot >= 0) {
+            slots[slot].lastUsed = frame;
+        } else if (slot == NOT_RESIDENT) {
+            missing.push_back({&file, t, level, x, y, QImage()});
+        }
+    }
+}
+
+// --- Cache
+
+bool VirtualTextureCache::upload(const Request &request) {
+    Texture &texture = *textures[request.texture];
+    int page = texture.file.pageIndex(request.level, request.x, request.y);
+    if (request.image.isNull()) {
+        LOG(Log::ASSETS, Log::WARNING) << "Cannot read page" << request.x << request.y << "of level" << request.level
+                                       << "of" << texture.file.getName();
+        texture.slotOf[page] = FAILED;
+        return false;
+    }
+    int slot = evict();
+    if (slot < 0) {
+        texture.slotOf[page] = NO_ROOM;
+        noRoom++;
+        statistics.full++;
+        return false;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, cacheTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % slotsPerSide) * slotSize, (slot / slotsPerSide) * slotSize,
+                    slotSize, slotSize, GL_RGBA, GL_UNSIGNED_BYTE, request.image.constBits());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    slots[slot].texture = request.texture;
+    slots[slot].page = page;
+    slots[slot].lastUsed = frame;
+    slots[slot].pinned = false;
+    texture.slotOf[page] = slot;
+    texture.dirty = true;
+    return true;
+}
+
+/**
+ * @brief VirtualTextureCache::evict
+ *
+ * Returns a free slot, or frees the one used longest ago. Pages the last
+ * feedback wanted are in view, evicting them would only bring them back;
+ * -1 when every slot holds one.
+ */
+int VirtualTextureCache::evict() {
+    int oldest = -1;
+    for (int s = 0; s != slots.size(); ++s) {
+        const Slot &slot = slots[s];
+        if (slot.texture < 0) return s;
+        if (slot.pinned || slot.lastUsed >= frame) continue;
+        if (oldest < 0 || slot.lastUsed < slots[oldest].lastUsed) oldest = s;
+    }
+    if (oldest < 0) return -1;
+
+    Texture &texture = *textures[slots[oldest].texture];
+    texture.slotOf[slots[oldest].page] = NOT_RESIDENT;
+    texture.dirty = true;
+    slots[oldest].texture = -1;
+    statistics.evicted++;
+    return oldest;
+}
+
+/**
+ * @brief VirtualTextureCache::rebuildIndirection
+ *
+ * From the coarsest level down, a page that is not resident takes the entry
+ * of its parent, so every texel points at the finest resident page covering
+ * it. The coarsest level is pinned and always resident.
+ */
+void VirtualTextureCache::rebuildIndirection(int t) {
+    Texture &texture = *textures[t];
+    VirtualTextureFile &file = texture.file;
+    uchar *entries = texture.entries.data();
+
+    glBindTexture(GL_TEXTURE_2D, texture.indirection);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = file.getLevels() - 1; level >= 0; --level) {
+        for (int y = 0; y != file.getPagesY(level); ++y) {
+            for (int x = 0; x != file.getPagesX(level); ++x) {
+                int page = file.pageIndex(level, x, y);
+                uchar *entry = entries + 4 * page;
+                int slot = texture.slotOf[page];
+                if (slot >= 0) {
+                    entry[0] = static_cast<uchar>(slot % slotsPerSide);
+                    entry[1] = static_cast<uchar>(slot / slotsPerSide);
+                    entry[2] = static_cast<uchar>(level);
+                    entry[3] = 255;
+                } else if (level + 1 < file.getLevels()) {
+                    std::copy(entries + 4 * file.pageIndex(level + 1, x / 2, y / 2),
+                              entries + 4 * file.pageIndex(level + 1, x / 2, y / 2) + 4, entry);
+                }
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, file.getPagesX(level), file.getPagesY(level),
+                        GL_RGBA, GL_UNSIGNED_BYTE, entries + 4 * file.pageIndex(level, 0, 0));
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    texture.dirty = false;
+}
+
+void VirtualTextureCache::loaderLoop() {
+    for (;;) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queued.wait(lock, [this] {return stopping || !requests.empty();});
+            if (stopping) return;
+            request = std::move(requests.front());
+            requests.pop_front();
+        }
+        if (!request.file->readPage(request.level, request.x, request.y, request.image)) request.image = QImage();
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(request));
+    }
+}
+
+void VirtualTextureCache::reportMemory(MemoryReport &report) {
+    qint64 cacheSize = qint64(slotsPerSide) * slotSize;
+    report.add(MemoryReport::GPU_TEXTURE, "virtual textures", "page cache", cacheSize * cacheSize * 4);
+    report.add(MemoryReport::GPU_TEXTURE, "virtual textures", "feedback", qint64(feedbackWidth) * feedbackHeight * 12);
+    qint64 readbackBytes = 0;
+    for (Readback &readback : readbacks) {
+        readbackBytes += qint64(readback.width) * readback.height * 8;
+    }
+    report.add(MemoryReport::GPU_BUFFER, "virtual textures", "feedback readback", readbackBytes);
+    report.add(MemoryReport::CPU, "virtual textures", "slots", MemoryReport::bytes(slots));
+    for (std::unique_ptr<Texture> &texture : textures) {
+        QString name = texture->file.getName();
+        // Offset and size of every page.
+        report.add(MemoryReport::CPU, "virtual textures", name + " pages",
+                   MemoryReport::bytes(texture->slotOf) + qint64(texture->file.getPageCount()) * 12);
+        report.add(MemoryReport::CPU, "virtual textures", name + " indirection", MemoryReport::bytes(texture->entries));
+        report.add(MemoryReport::GPU_TEXTURE, "virtual textures", name + " indirection", texture->entries.size());
+    }
+}
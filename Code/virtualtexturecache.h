@@ -0,0 +1,202 @@
+#ifndef VIRTUALTEXTURECACHE_H
+#define VIRTUALTEXTURECACHE_H
+
+#include <QImage>
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include <QVector4D>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "memoryreport.h"
+#include "object.h"
+#include "shadercache.h"
+#include "virtualtexture.h"
+
+/**
+ * @brief The VirtualTextureCache class
+ *
+ * Streams the pages of VirtualTextureFiles into one fixed size texture of
+ * page slots, so the video memory used stays the same however many and however
+ * large the textures are.
+ *
+ * A feedback pass draws the virtually textured objects at 1/8 of the render
+ * size, writing the page and level each pixel would sample. Its pixels are
+ * read back through a ring of pixel buffers and looked at a frame or two
+ * later, when the copy has finished, so the pass never stalls the pipeline.
+ * Missing pages are read and decoded by a loader thread, coarser levels first,
+ * and uploaded a few per frame. When the slots run out the page used longest
+ * ago is evicted; pages seen in the last feedback are never evicted, and the
+ * coarsest level of every texture is loaded on open() and stays, so there is
+ * always something to sample. A page that found no free slot is not asked for
+ * again until the views or the scene change.
+ *
+ * A new feedback pass is only drawn after invalidateFeedback(), or when the
+ * last one wanted more pages than the loader had room for.
+ *
+ * Every texture has an indirection texture with a texel per page and a mip
+ * level per page level. A texel holds the slot of the page, or of the nearest
+ * coarser page that is resident, and the level of that page; the Phong shader
+ * looks it up and samples the slot.
+ */
+class VirtualTextureCache : protected QOpenGLFunctions_3_3_Core {
+public:
+    struct Statistics {
+        int resident = 0;       // Pages in the cache.
+        int uploaded = 0;       // Pages uploaded by the last update.
+        int evicted = 0;        // Pages evicted since open.
+        int queued = 0;         // Pages requested and not uploaded yet.
+        int missing = 0;        // Pages the last feedback wanted that are not resident.
+        int full = 0;           // Uploads dropped since open, every slot was in use.
+    };
+
+    VirtualTextureCache() {}
+    ~VirtualTextureCache();
+
+    // Requires a current context.
+    void initialize(ShaderCache *cache);
+
+    // Returns the id of the texture, or -1 when the file cannot be read.
+    int open(QString file);
+    int getTextureCount() {return static_cast<int>(textures.size());}
+
+    // Reads finished feedback, uploads loaded pages and updates the
+    // indirection textures. Once per frame, before drawing.
+    void update();
+
+    // The views or the scene changed since the last feedback pass.
+    void invalidateFeedback();
+    // The feedback pass, into its own framebuffer of width by height pixels.
+    // Skipped, returning false, when the last pass is still up to date or
+    // while the readbacks of earlier passes are busy.
+    bool beginFeedback(int width, int height);
+    void setFeedbackView(QRect viewport, const QMatrix4x4 &view, const QMatrix4x4 &projection);
+    void drawFeedback(int texture, const QMatrix4x4 &model, Object *object);
+    // Starts the readback and binds framebuffer fbo again.
+    void endFeedback(GLuint fbo);
+    // Feedback is rendered at this fraction of the render size.
+    static int getFeedbackDivisor() {return feedbackDivisor;}
+
+    // For the Phong shader: the indirection texture, pages across and down at
+    // level 0 and levels of a texture, the cache texture and its layout.
+    GLuint getIndirection(int texture) {return textures[texture]->indirection;}
+    QVector3D getPages(int texture);
+    GLuint getCacheTexture() {return cacheTexture;}
+    // Slot size, border and page size in cache texture coordinates, and the
+    // texels per page.
+    QVector4D getSlotLayout();
+
+    // Whether later frames still have feedback to draw or read, or pages to
+    // upload, so an idle scene keeps rendering until the cache has caught up.
+    // Requests count as outstanding until their page is uploaded.
+    bool hasPendingWork() {return pending > 0 || outstanding > 0 || needsFeedback();}
+
+    Statistics getStatistics() {return statistics;}
+    void reportMemory(MemoryReport &report);
+
+    // Size of the page cache in megabytes, --texture-cache.
+    static void setDefaultCacheSize(int megabytes) {defaultCacheSize = megabytes;}
+
+private:
+    struct Texture {
+        VirtualTextureFile file;
+        // Per page: the slot, or one of the states below.
+        QVector<int> slotOf;
+        QVector<uchar> entries;     // RGBA8 indirection texels, every level.
+        GLuint indirection = 0;
+        bool dirty = true;
+    };
+    struct Slot {
+        int texture = -1;           // -1 for a free slot.
+        int page = 0;
+        int lastUsed = -1;          // Frame of the last feedback that wanted it.
+        bool pinned = false;
+    };
+    struct Request {
+        VirtualTextureFile *file;
+        int texture;
+        int level, x, y;
+        QImage image;               // Filled by the loader, null when reading failed.
+    };
+    struct Readback {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        int width = 0, height = 0;
+    };
+
+    enum PageState {
+        NOT_RESIDENT = -1, REQUESTED = -2, FAILED = -3, NO_ROOM = -4
+    };
+
+    static const int feedbackDivisor = 8;
+    static const int ringSize = 2;
+    // Outstanding loader requests, and uploads per update.
+    static const int maxRequests = 32;
+    static const int maxUploads = 8;
+    // Slot positions are stored in 8 bits of the indirection texture.
+    static const int maxSlotsPerSide = 255;
+
+    static int defaultCacheSize;
+
+    bool initialized = false;
+    std::vector<std::unique_ptr<Texture>> textures;
+
+    // The physical page cache.
+    GLuint cacheTexture = 0;
+    int slotSize = 0, pageSize = 0, border = 0;
+    int slotsPerSide = 0;
+    QVector<Slot> slots;
+    int frame = 0;
+    Statistics statistics;
+
+    // Feedback pass.
+    QOpenGLShaderProgram program;
+    GLint uniformModelTransform;
+    GLint uniformViewTransform;
+    GLint uniformProjectionTransform;
+    GLint uniformVirtualPages;
+    GLint uniformTextureId;
+    GLint uniformPageTexels;
+    GLint uniformLodBias;
+    GLuint framebuffer = 0;
+    GLuint feedbackTexture = 0;
+    GLuint depthBuffer = 0;
+    int feedbackWidth = 0, feedbackHeight = 0;
+    Readback readbacks[ringSize];
+    int next = 0;
+    int pending = 0;
+    // The last pass is out of date, or left pages unrequested.
+    bool feedbackStale = true;
+    bool truncated = false;
+    // Pages in the NO_ROOM state.
+    int noRoom = 0;
+
+    // Loader thread.
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::deque<Request> requests, results;
+    bool stopping = false;
+    int outstanding = 0;
+
+    bool needsFeedback();
+    bool createCache(int slot);
+    void resizeFeedback(int width, int height);
+    void readFeedback(Readback &readback);
+    void want(int texture, int level, int x, int y, std::vector<Request> &missing);
+    bool upload(const Request &request);
+    int evict();
+    void rebuildIndirection(int texture);
+    void loaderLoop();
+};
+
+#endif // VIRTUALTEXTURECACHE_H